@@ -0,0 +1,76 @@
+
+#ifndef KALE_ARENA_H
+#define KALE_ARENA_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+namespace kale {
+
+/// ------------------------------------------------------------------------
+/// @brief ASTArena is a bump pointer allocator that own the ast nodes of
+/// one program. Allocation just bump the pointer in the current slab, so the
+/// nodes created one after another lie in continuous memory. The nodes are
+/// never freed one by one, reset() run the destructors of the nodes that
+/// need it and release all slabs in one shot.
+/// ------------------------------------------------------------------------
+class ASTArena {
+private:
+    struct DtorRecord {
+        void *Obj;
+        void (*Dtor)(void *);
+    };
+
+    static constexpr size_t SlabSize = 64 * 1024;
+
+    std::vector<char *>     Slabs;
+    std::vector<DtorRecord> Dtors;
+    char                   *CurPtr = nullptr;
+    char                   *End = nullptr;
+    size_t                  BytesAllocated = 0;
+
+private:
+    void *allocateSlow(size_t size, size_t align);
+
+public:
+    ASTArena() = default;
+    ASTArena(const ASTArena&) = delete;
+    ASTArena &operator=(const ASTArena&) = delete;
+    ~ASTArena() { reset(); }
+
+    void *allocate(size_t size, size_t align) {
+        uintptr_t ptr = ((uintptr_t)CurPtr + align - 1) & ~(uintptr_t)(align - 1);
+        if(CurPtr && ptr + size <= (uintptr_t)End) {
+            CurPtr = (char *)(ptr + size);
+            BytesAllocated += size;
+            return (void *)ptr;
+        }
+        return allocateSlow(size, align);
+    }
+
+    /// @brief construct object T in the arena, T's destructor will be called
+    /// by reset() if it is not trivial.
+    template<class T, class... Args>
+    T *create(Args&&... args) {
+        void *mem = allocate(sizeof(T), alignof(T));
+        T *obj = new (mem) T(std::forward<Args>(args)...);
+        if(!std::is_trivially_destructible<T>::value) {
+            Dtors.push_back({obj, [](void *p) { static_cast<T *>(p)->~T(); }});
+        }
+        return obj;
+    }
+
+    /// @brief destroy all objects and free all memory hold by the arena
+    void reset();
+
+    size_t getBytesAllocated() const { return BytesAllocated; }
+    size_t getSlabCount()      const { return Slabs.size(); }
+};
+
+}
+
+#endif
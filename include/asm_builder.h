@@ -10,6 +10,9 @@
 
 namespace kale {
 
+class CompileScheduler;
+class KaleObjectCache;
+
 class AsmBuilder {
 public:
     enum CPU_TYPE {
@@ -33,13 +36,19 @@ protected:
 class LLVMBuilderChain : public AsmBuilder {
 
 public:
-    LLVMBuilderChain(const std::string& rpath);
+    /// @brief the modules are emitted to object files in process, on the
+    /// workers of scheduler if it is given, then linked by KALE_LINKER. The
+    /// programs found in cache are linked from their cached objects
+    LLVMBuilderChain(const std::string& rpath, CompileScheduler *scheduler = nullptr,
+                     KaleObjectCache *cache = nullptr);
 
     unsigned runAndCompileToExecutable() override;
 
 private:
     std::vector<std::string> ObjFileList;
     std::string Rpath;
+    CompileScheduler *Scheduler;
+    KaleObjectCache *Cache;
 };
 
 
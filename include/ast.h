@@ -6,6 +6,8 @@
 // clang-format off
 
 #include "common.h"
+#include "arena.h"
+#include "symbol.h"
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
 #include "llvm/IR/Function.h"
@@ -46,16 +48,19 @@ class VariableAST;
 class ASTBase {
 protected:
     LineNo      LineMsg;
+    KAstId      Kind;                   // the class id of the node
     ASTBase     *Parent{nullptr};
     ProgramAST  *Program;
 
 public:
     virtual void accept(AstVisitor &v) = 0;
 
-public:
-    ASTBase() = default;
-    ASTBase(const LineNo&, ASTBase *);
+protected:
+    /// the kind is given by the constructor of the final class
+    explicit ASTBase(KAstId kind) : Kind(kind) {}
+    ASTBase(KAstId, const LineNo&, ASTBase *);
 
+public:
    void setParent(ASTBase *parent);
    void setLineNo(const LineNo&);
    void setProgram(ProgramAST *prog);
@@ -67,7 +72,8 @@ public:
    ProgramAST  *getProgram()   { return Program; }
 
 public:
-    virtual KAstId getClassId() = 0;
+    static bool canCastTo(KAstId) { return true; }
+    KAstId getClassId() const { return Kind; }
     virtual const char* getAstName(){
         return "";
     }
@@ -76,9 +82,12 @@ public:
 
 /// ------------------------------------------------------------------------
 /// @brief program ast express the whole source file, and it has it depends
-/// and compile statue.
+/// and compile statue. All ast nodes of the program are allocated in its
+/// arena and released together by releaseAst(). ProgramAST is final, it is
+/// deleted by its own type and ASTBase needs no virtual destructor, so the
+/// trivial nodes in the arena need no destructor call.
 /// ------------------------------------------------------------------------
-class ProgramAST : public ASTBase {
+class ProgramAST final : public ASTBase {
 public:
     /// @brief this enum type express program compiled statue
     enum CompiledFlag {
@@ -91,13 +100,14 @@ private:
     std::vector<ProgramAST*> DependentProg;             // 依赖项
     CompiledFlag             CompFlag{NotCompiled};     // 处理状态
     std::vector<ASTBase*>    ProgramElems;              //
+    ASTArena                 Arena;                     // 语法树节点的内存
 public:
     INSERT_ENUM(ProgramId)
     static bool canCastTo(KAstId id) { return (id == ProgramId); }
 
     INSERT_ENUM_NAME(ProgramId)
 public:
-    ProgramAST() = default;
+    ProgramAST() : ASTBase(ProgramId) {}
     explicit ProgramAST(const LineNo&, ASTBase *parent = nullptr);
 
     /// @brief 添加program的依赖项
@@ -118,6 +128,12 @@ public:
     CompiledFlag getCompiledFlag() const { return CompFlag; }
 
     const std::vector<ASTBase*>& getCompElems() { return ProgramElems; }
+
+    /// @brief 获取语法树节点的内存池
+    /// @return
+    ASTArena &getArena() { return Arena; }
+    /// @brief 释放程序的全部语法树节点
+    void releaseAst() { ProgramElems.clear(); Arena.reset(); }
 public:
     INSERT_ACCEPT
 };
@@ -150,7 +166,7 @@ public:
 /// ------------------------------------------------------------------------
 class DataTypeAST : public ASTBase {
 public:
-    DataTypeAST() = default;
+    DataTypeAST() : ASTBase(DataTypeId) {}
     DataTypeAST(const LineNo&, ASTBase *, KType);
 
 public:
@@ -178,7 +194,7 @@ private:
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
     Function                *LLVMFunc;        //
 #endif
-    std::string              FuncName;        // 函数名
+    Symbol                   FuncName;        // 函数名
     std::vector<ParamAST *>  FuncParams;      // 函数参数列表
     DataTypeAST             *RetType;         // 返回值类型
     BlockStmtAST            *BlockStmt;
@@ -188,12 +204,12 @@ public:
     static bool canCastTo(KAstId id) { return (id == FuncId); }
 
 public:
-    explicit FuncAST(const LineNo&, ASTBase*, const std::string&);
+    explicit FuncAST(const LineNo&, ASTBase*, Symbol);
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
     void setLLVMFunction(Function *func)            { LLVMFunc = func; }
 #endif
-    void setFuncName    (const std::string& name)   { FuncName = name; }
+    void setFuncName    (Symbol name)               { FuncName = name; }
     void setRetType     (DataTypeAST *type)         { RetType = type; }
     void addFuncParam   (ParamAST *param)           { FuncParams.push_back(param); }
     void setBlockStmt   (BlockStmtAST *stmt)        { BlockStmt = stmt; }
@@ -203,7 +219,8 @@ public:
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
     Function                        *getLLVMFunction() { return LLVMFunc; }
 #endif
-    const std::string               &getFuncName    () { return FuncName; }
+    const std::string               &getFuncName    () { return FuncName.str(); }
+    Symbol                           getFuncSymbol  () { return FuncName; }
     const std::vector<ParamAST *>   &getParams      () { return FuncParams; }
     DataTypeAST                     *getRetType     () { return RetType; }
 
@@ -246,12 +263,12 @@ public:
 /// ------------------------------------------------------------------------
 class StatementAST : public ASTBase {
 public:
-    StatementAST() = default;
-    explicit StatementAST(const LineNo&, ASTBase*);
+    explicit StatementAST(KAstId kind) : ASTBase(kind) {}
+    StatementAST(KAstId, const LineNo&, ASTBase*);
 
 public:
     INSERT_ENUM(StmtId)
-    static bool canCastTo(KAstId id) { return (id == StmtId); }
+    static bool canCastTo(KAstId id) { return (id >= FirstStmtId && id <= LastStmtId); }
 };
 
 /// ------------------------------------------------------------------------
@@ -261,7 +278,7 @@ class ExprStmtAST : public StatementAST {
 private:
     ExprAST *Expr;
 public:
-    ExprStmtAST() = default;
+    ExprStmtAST() : StatementAST(ExprStmtId) {}
     explicit ExprStmtAST(const LineNo&, ASTBase*, ExprAST *expr);
 
 public:
@@ -270,7 +287,7 @@ public:
     ExprAST *getExpr() { return Expr; }
 public:
     INSERT_ENUM(ExprStmtId)
-    static bool canCastTo(KAstId id) { return (id == ExprStmtId || StatementAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == ExprStmtId); }
 
 public:
     INSERT_ACCEPT
@@ -283,22 +300,23 @@ public:
 /// ------------------------------------------------------------------------
 class IdDefAST : public ASTBase {
 public:
-    IdDefAST() = default;
-    IdDefAST(const LineNo&, ASTBase *, const std::string&);
+    explicit IdDefAST(KAstId kind) : ASTBase(kind) {}
+    IdDefAST(KAstId, const LineNo&, ASTBase *, Symbol);
 
 public:
     INSERT_ENUM(IdDefId)
-    static bool canCastTo(KAstId id) { return (id == IdDefId); }
+    static bool canCastTo(KAstId id) { return (id >= FirstIdDefId && id <= LastIdDefId); }
 
     virtual bool isVariable()   { return false; }
     virtual bool isTypeRef()    { return false; }
     virtual bool isStructDef()  { return false; }
 
     void setDataType(DataTypeAST *ty)         { DataType = ty; }
-    void setName    (const std::string &name) { Name = name; }
+    void setName    (Symbol name)             { Name = name; }
 
     DataTypeAST *getDataType()  { return DataType; }
     const char  *getName    ()  { return Name.c_str(); }
+    Symbol       getSymbol  ()  { return Name; }
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
     void setLLVMValue(llvm::Value *v) { Value = v; }
@@ -308,7 +326,7 @@ public:
 #endif
 private:
     DataTypeAST *DataType;
-    std::string Name;
+    Symbol       Name;
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
     /// llvm
@@ -323,12 +341,12 @@ private:
 /// ------------------------------------------------------------------------
 class VariableAST : public IdDefAST {
 public:
-    VariableAST() = default;
-    VariableAST(const LineNo&, ASTBase *, const std::string&);
+    VariableAST() : IdDefAST(VariableId) {}
+    VariableAST(const LineNo&, ASTBase *, Symbol);
 
 public:
     INSERT_ENUM(VariableId)
-    static bool canCastTo(KAstId id) { return (id == VariableId || IdDefAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == VariableId); }
 
 
     void setIsStatic    ()      { VarFlag = (VarFlag & 0xFFFFFFFE) | 0x1; }
@@ -371,7 +389,7 @@ private:
     std::vector<VariableAST *> VarDecls;
 public:
     INSERT_ENUM(DataDeclId)
-    static bool canCastTo(KAstId id) { return (id == DataDeclId || StatementAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == DataDeclId); }
 
 public:
     DataDeclAST(const LineNo&, ASTBase*);
@@ -396,10 +414,13 @@ public:
 
 public:
     INSERT_ENUM(BlockStmtId)
-    static bool canCastTo(KAstId id) { return (id == BlockStmtId || StatementAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == BlockStmtId); }
 
 public:
     void addStmt(StatementAST *stmt) { Stmts.push_back(stmt); }
+    void setStmt(unsigned index, StatementAST *stmt) { Stmts[index] = stmt; }
+    /// @brief drop the statements from index to the end
+    void truncateStmts(unsigned index) { Stmts.resize(index); }
 
     const std::vector<StatementAST*>& getStmts() { return Stmts; }
 
@@ -419,7 +440,7 @@ public:
 
 public:
     INSERT_ENUM(ReturnStmtId)
-    static bool canCastTo(KAstId id) { return (id == ReturnStmtId || StatementAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == ReturnStmtId); }
 
 public:
     void    setRetExpr(ExprAST *expr) { RetExpr = expr; }
@@ -435,11 +456,11 @@ public:
 /// ------------------------------------------------------------------------
 class BreakStmtAST : public StatementAST {
 public:
-    BreakStmtAST() = default;
+    BreakStmtAST() : StatementAST(BreakStmtId) {}
     BreakStmtAST(const LineNo&, ASTBase *);
 public:
     INSERT_ENUM(BreakStmtId)
-    static bool canCastTo(KAstId id) { return (id == BreakStmtId || StatementAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == BreakStmtId); }
 
 public:
     INSERT_ACCEPT
@@ -454,7 +475,7 @@ public:
 
 public:
     INSERT_ENUM(ContinueStmtId)
-    static bool canCastTo(KAstId id) { return (id == ContinueStmtId || StatementAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == ContinueStmtId); }
 
 public:
     INSERT_ACCEPT
@@ -473,10 +494,10 @@ private:
 
 public:
     INSERT_ENUM(ForStmtId)
-    static bool canCastTo(KAstId id) { return (id == ForStmtId || StatementAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == ForStmtId); }
 
 public:
-    ForStmtAST() = default;
+    ForStmtAST() : StatementAST(ForStmtId) {}
     ForStmtAST(const LineNo&, ASTBase*, ExprAST*, ExprAST*, ExprAST*);
     ForStmtAST(const LineNo&, ASTBase*);
 
@@ -506,7 +527,7 @@ private:
 
 public:
     INSERT_ENUM(WhileStmtId)
-    static bool canCastTo(KAstId id) { return (id == WhileStmtId || StatementAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == WhileStmtId); }
 
 public: 
     explicit WhileStmtAST(const LineNo&, ASTBase*, ExprAST*);
@@ -534,7 +555,7 @@ private:
 
 public:
     INSERT_ENUM(IfStmtId)
-    static bool canCastTo(KAstId id) { return (id == IfStmtId || StatementAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == IfStmtId); }
 
 public:
     explicit IfStmtAST(const LineNo&, ASTBase*, ExprAST*);
@@ -557,11 +578,11 @@ public:
 /// ------------------------------------------------------------------------
 class ExprAST : public ASTBase {
 public:
-    ExprAST() = default;
-    explicit ExprAST(const LineNo& line, ASTBase*);
+    explicit ExprAST(KAstId kind) : ASTBase(kind) {}
+    ExprAST(KAstId, const LineNo& line, ASTBase*);
 public:
     INSERT_ENUM(ExprId)
-    static bool canCastTo(KAstId id) { return (id == ExprId); }
+    static bool canCastTo(KAstId id) { return (id >= FirstExprId && id <= LastExprId); }
 
 public:
     void setExprType(KType ty) { ExprType = ty; }
@@ -584,7 +605,7 @@ public:
 
 public:
     INSERT_ENUM(InitializeId)
-    static bool canCastTo(KAstId id) { return (id == InitializeId || ExprAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == InitializeId); }
 
     void setInitExpr(InitializedAST *next) { Next = next; }
     void setExpr    (ExprAST *expr)        { InitExpr = expr; }
@@ -612,7 +633,7 @@ private:
     ExprAST  *Rhs;
 public:
     INSERT_ENUM(BinExprId)
-    static bool canCastTo(KAstId id) { return (id == BinExprId || ExprAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == BinExprId); }
 
 public:
     BinaryExprAST(const LineNo&, ASTBase*, Operator, ExprAST*, ExprAST*);
@@ -641,10 +662,10 @@ private:
     ExprAST  *Expr;
 public:
     INSERT_ENUM(UnaryExprId)
-    static bool canCastTo(KAstId id) { return (id == UnaryExprId || ExprAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == UnaryExprId); }
 
 public:
-    UnaryExprAST() = default;
+    UnaryExprAST() : ExprAST(UnaryExprId) {}
     UnaryExprAST(const LineNo&, ASTBase*, Operator, ExprAST*);
 
     void setOperator    (Operator op)   { this->Op = op; }
@@ -668,10 +689,10 @@ private:
 
 public:
     INSERT_ENUM(LiteralId)
-    static bool canCastTo(KAstId id) { return (id == LiteralId || ExprAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == LiteralId); }
 
 public:
-    LiteralExprAST() = default;
+    LiteralExprAST() : ExprAST(LiteralId) {}
     LiteralExprAST(const LineNo&, ASTBase*);
     LiteralExprAST(const LineNo&, ASTBase*, const std::string&);
 
@@ -703,7 +724,7 @@ private:
 
 public:
     INSERT_ENUM(NumberId)
-    static bool canCastTo(KAstId id) { return (id == NumberId || ExprAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == NumberId); }
 
 public: 
     explicit NumberExprAST(const LineNo&, ASTBase*, char);
@@ -734,24 +755,25 @@ public:
 /// ------------------------------------------------------------------------
 class IdRefAST : public ExprAST {
 private:
-    const std::string     IdName;             // var name
+    const Symbol          IdName;             // var name
     IdDefAST             *Id;                 // define id
 
 public:
-    explicit IdRefAST(const LineNo&, ASTBase *, const std::string&);
+    explicit IdRefAST(const LineNo&, ASTBase *, Symbol);
 
 public:
     INSERT_ENUM(IdRefId)
-    static bool canCastTo(KAstId id) { return (id == IdRefId || ExprAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == IdRefId); }
 
 public:
     void setId(IdDefAST *id) { Id = id; }
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
-    Value       *getLLVMValue()       { Id->getLLVMValue(); }
+    Value       *getLLVMValue()       { return Id->getLLVMValue(); }
 #endif
     IdDefAST    *getId()              { return Id; }
-    std::string  getIdName()    const { return IdName; }
+    const std::string &getIdName() const { return IdName.str(); }
+    Symbol       getIdSymbol()  const { return IdName; }
 
 public:
     INSERT_ACCEPT
@@ -764,25 +786,27 @@ public:
 class IdIndexedRefAST : public ExprAST {
 private:
     std::vector<ExprAST*>  Indexes;             // indexes list
-    const std::string      IdName;              // var name
+    const Symbol           IdName;              // var name
     IdDefAST              *Id;                  // define id
 public:
-    explicit IdIndexedRefAST(const LineNo&, ASTBase*, const std::string&);
+    explicit IdIndexedRefAST(const LineNo&, ASTBase*, Symbol);
 
 public:
     INSERT_ENUM(IdIndexedRefId)
-    static bool canCastTo(KAstId id) { return (id == IdIndexedRefId || ExprAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == IdIndexedRefId); }
 
 public:
     void addIndex(ExprAST *expr)     { Indexes.push_back(expr); }
+    void setIndex(unsigned index, ExprAST *expr) { Indexes[index] = expr; }
     void setId(IdDefAST *id) { Id = id; }
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
-    Value                        *getLLVMValue()      { Id->getLLVMValue(); }
+    Value                        *getLLVMValue()      { return Id->getLLVMValue(); }
 #endif
     IdDefAST                     *getId()             { return Id; }
     const std::vector<ExprAST*>  &getIndexes()  const { return Indexes; }
-    std::string                   getIdName()   const { return IdName; }
+    const std::string            &getIdName()   const { return IdName.str(); }
+    Symbol                        getIdSymbol() const { return IdName; }
 public:
     INSERT_ACCEPT
 };
@@ -794,22 +818,24 @@ public:
 class CallExprAST : public ExprAST {
 private:
     FuncAST               *TheCallFunction = nullptr;          // 对应的FuncAST的定义
-    const std::string      FuncName;                           // 函数名
+    const Symbol           FuncName;                           // 函数名
     std::vector<ExprAST *> Args;
     bool                   IsCallStd;                          // flag to call std function
 public:
-    explicit CallExprAST(const LineNo&, ASTBase*, const std::string&);
+    explicit CallExprAST(const LineNo&, ASTBase*, Symbol);
 
 public:
     INSERT_ENUM(CallId)
-    static bool canCastTo(KAstId id) { return (id == CallId || ExprAST::canCastTo(id)); }
+    static bool canCastTo(KAstId id) { return (id == CallId); }
 
     void setFunction    (FuncAST *func)     { this->TheCallFunction = func; }
     void addArg         (ExprAST *arg)      { Args.push_back(arg); }
+    void setArg         (unsigned index, ExprAST *arg) { Args[index] = arg; }
     void setIsCallStd   (bool flag)         { IsCallStd = flag; }
 
     const std::vector<ExprAST*> &getArgs()          const    { return this->Args; }
-    const std::string           &getName()          const    { return this->FuncName; }
+    const std::string           &getName()          const    { return this->FuncName.str(); }
+    Symbol                       getNameSymbol()    const    { return this->FuncName; }
     bool                         isArgEmpty()       const    { return this->Args.empty(); }
     bool                         isCallStd()        const    { return this->IsCallStd; }
 
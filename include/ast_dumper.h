@@ -2,18 +2,20 @@
 #ifndef KALE_AST_DUMPER_H
 #define KALE_AST_DUMPER_H
 
-#include "ast_visitor.h"
+#include "static_visitor.h"
 
 namespace kale {
 
-class DumpVisitor : public AstVisitor {
+/// dump the ast by the default traversal of the static visitor, run it by
+/// dumper.traverse(prog)
+class DumpVisitor : public StaticAstVisitor<DumpVisitor> {
 
 public:
     DumpVisitor() = default;
 
 
-    void preAction(ASTBase *node) override;
-    void postAction(ASTBase *node) override;
+    void preAction(ASTBase *node);
+    void postAction(ASTBase *node);
 };
 
 }
@@ -17,6 +17,7 @@ class FuncAST;
 class InitializedAST;
 class StructDefAST;
 class VariableAST;
+class IdDefAST;
 class DataDeclAST;
 class DataTypeAST;
 class BlockStmtAST;
@@ -49,6 +50,7 @@ class AstVisitor {
 
 public:
     AstVisitor() = default;
+    virtual ~AstVisitor() = default;
 
 public:
     ADD_VISITOR(ASTBase)
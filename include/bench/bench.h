@@ -0,0 +1,46 @@
+
+#ifndef __KALE_BENCH__
+#define __KALE_BENCH__
+
+#ifdef __BENCH_ENABLE__
+
+#include <string>
+#include <chrono>
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// @brief BenchTimer measure the wall time between start
+/// and stop, used by the micro benchmarks.
+/// -----------------------------------------------------
+class BenchTimer {
+private:
+    std::chrono::steady_clock::time_point Start;
+public:
+    BenchTimer() : Start(std::chrono::steady_clock::now()) {}
+
+    void   reset()  { Start = std::chrono::steady_clock::now(); }
+    double getNs()  const {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count();
+    }
+    double getMs()  const { return getNs() / 1e6; }
+};
+
+/// run the benchmark named by name, return 0 if success
+int runBenchmark(const std::string &name);
+
+int keywordBenchmark();
+int nestedScopeBenchmark();
+int importGraphBenchmark();
+int visitorBenchmark();
+int sessionBenchmark();
+int lazyJitBenchmark();
+/// the programs are given by -i
+int vmBenchmark();
+int optLevelBenchmark();
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+
+#ifndef KALE_BYTECODE_H
+#define KALE_BYTECODE_H
+
+#include "common.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+namespace kale {
+
+/// ------------------------------------------------------------------------
+/// @brief The opcodes of the kale bytecode. A is the destination register,
+/// B and C the source registers, Imm the constant, slot or jump target and
+/// Aux the small operand. The integer ops normalize their result by Aux,
+/// see normalizeValue(). The J* compare jumps go to Imm if B op C.
+/// ------------------------------------------------------------------------
+#define KALE_VM_OPCODES(X)                                                      \
+    X(Mov)      /* A = B                                                    */ \
+    X(LoadK)    /* A = Constants[Imm]                                       */ \
+    X(LoadI)    /* A = (int32)Imm                                           */ \
+    X(Add)      /* A = B + C                                                */ \
+    X(AddI)     /* A = B + (int32)Imm                                       */ \
+    X(Sub)      /* A = B - C                                                */ \
+    X(Mul)      /* A = B * C                                                */ \
+    X(MulI)     /* A = B * (int32)Imm                                       */ \
+    X(SDiv)     /* A = B / C, signed                                        */ \
+    X(UDiv)     /* A = B / C, unsigned                                      */ \
+    X(And)      /* A = B & C                                                */ \
+    X(Or)       /* A = B | C                                                */ \
+    X(Xor)      /* A = B ^ C                                                */ \
+    X(Shl)      /* A = B << C                                               */ \
+    X(LShr)     /* A = B >> C, unsigned                                     */ \
+    X(Neg)      /* A = -B                                                   */ \
+    X(Not)      /* A = B == 0                                               */ \
+    X(LAnd)     /* A = B != 0 && C != 0                                     */ \
+    X(LOr)      /* A = B != 0 || C != 0                                     */ \
+    X(Norm)     /* A = normalize B by Aux                                   */ \
+    X(FAdd)     /* A = B + C, double, rounded to float if Aux               */ \
+    X(FSub)     /* A = B - C                                                */ \
+    X(FMul)     /* A = B * C                                                */ \
+    X(FDiv)     /* A = B / C                                                */ \
+    X(FNeg)     /* A = -B                                                   */ \
+    X(FRound)   /* A = (float)B                                             */ \
+    X(U2F)      /* A = (double)(uint64)B, rounded to float if Aux           */ \
+    X(F2I)      /* A = (int64)B, normalized by Aux                          */ \
+    X(Eq)       /* A = B == C                                               */ \
+    X(Ne)       /* A = B != C                                               */ \
+    X(SLt)      /* A = B < C, signed                                        */ \
+    X(SLe)                                                                     \
+    X(SGt)                                                                     \
+    X(SGe)                                                                     \
+    X(ULt)      /* A = B < C, unsigned                                      */ \
+    X(ULe)                                                                     \
+    X(UGt)                                                                     \
+    X(UGe)                                                                     \
+    X(FEq)      /* A = B == C, double                                       */ \
+    X(FNe)                                                                     \
+    X(FLt)                                                                     \
+    X(FLe)                                                                     \
+    X(FGt)                                                                     \
+    X(FGe)                                                                     \
+    X(Jmp)      /* goto Imm                                                 */ \
+    X(Jz)       /* if B == 0 goto Imm                                       */ \
+    X(Jnz)      /* if B != 0 goto Imm                                       */ \
+    X(JEq)      /* if B == C goto Imm                                       */ \
+    X(JNe)                                                                     \
+    X(JSLt)                                                                    \
+    X(JSLe)                                                                    \
+    X(JSGt)                                                                    \
+    X(JSGe)                                                                    \
+    X(JULt)                                                                    \
+    X(JULe)                                                                    \
+    X(JUGt)                                                                    \
+    X(JUGe)                                                                    \
+    X(LdG)      /* A = Globals[Imm]                                         */ \
+    X(StG)      /* Globals[Imm] = A                                         */ \
+    X(LdGX)     /* A = Globals[array Imm][B]                                */ \
+    X(StGX)     /* Globals[array Imm][B] = A                                */ \
+    X(LdLX)     /* A = Frame[local array Imm][B]                            */ \
+    X(StLX)     /* Frame[local array Imm][B] = A                            */ \
+    X(Call)     /* A = Functions[Imm](B, B + 1, ...)                        */ \
+    X(CallStd)  /* A = std function Aux(B, ..., B + C - 1)                  */ \
+    X(Ret)      /* return A                                                 */ \
+    X(RetV)     /* return                                                   */
+
+enum VMOpcode : uint8_t {
+#define KALE_VM_OPCODE_ENUM(op) Op##op,
+    KALE_VM_OPCODES(KALE_VM_OPCODE_ENUM)
+#undef KALE_VM_OPCODE_ENUM
+    OpCount
+};
+
+/// the std functions called by CallStd
+enum VMStdFunction : uint8_t {
+    StdPrint,
+    StdPrintLn,
+    StdGetInt,
+    StdGetDouble,
+};
+
+/// @brief the name of op, used by the disassembler
+const char *getOpcodeName(VMOpcode op);
+
+/// ------------------------------------------------------------------------
+/// @brief VMInst is one instruction of 12 bytes, every instruction has the
+/// same layout so the interpreter decode nothing
+/// ------------------------------------------------------------------------
+struct VMInst {
+    uint8_t     Op;
+    uint8_t     Aux;
+    uint16_t    A;
+    uint16_t    B;
+    uint16_t    C;
+    uint32_t    Imm;
+};
+
+/// ------------------------------------------------------------------------
+/// @brief VMValue is a register, a global or an array element. An integer
+/// is kept normalized to its type, sign extended if the type is signed and
+/// zero extended if not, a float is kept as a double rounded to float.
+/// ------------------------------------------------------------------------
+union VMValue {
+    int64_t      I;
+    uint64_t     U;
+    double       F;
+    const char  *S;
+};
+
+/// @brief the Aux of the ops normalizing an integer of bits wide
+inline uint8_t makeNormalizeAux(unsigned bits, bool isSigned) {
+    return bits >= 64 ? 0 : (uint8_t)(bits | (isSigned ? 0x80 : 0));
+}
+
+/// @brief truncate v to the bits of aux and extend it back to 64 bits
+inline uint64_t normalizeValue(uint64_t v, uint8_t aux) {
+    if(!aux)
+        return v;
+    unsigned shift = 64 - (aux & 0x7F);
+    return aux & 0x80 ? (uint64_t)((int64_t)(v << shift) >> shift) : (v << shift) >> shift;
+}
+
+/// ------------------------------------------------------------------------
+/// @brief VMArray is an array in the globals or in a frame, Base is the
+/// first element, counted from the globals or from the frame registers
+/// ------------------------------------------------------------------------
+struct VMArray {
+    uint32_t Base;
+    uint32_t Size;
+};
+
+/// ------------------------------------------------------------------------
+/// @brief VMFunction is a function lowered to bytecode. Its frame is the
+/// registers, params first, then the local arrays.
+/// ------------------------------------------------------------------------
+struct VMFunction {
+    std::string             Name;
+    bool                    Defined = false;
+    unsigned                ParamCount = 0;
+    unsigned                RegisterCount = 0;
+    unsigned                FrameSize = 0;         // registers and local arrays
+    std::vector<VMInst>     Code;
+    std::vector<VMArray>    Arrays;
+};
+
+/// ------------------------------------------------------------------------
+/// @brief VMModule is the bytecode of all the programs run together, the
+/// functions and globals are shared by name like the symbols of a linker.
+/// The initializers of the globals are run before main.
+/// ------------------------------------------------------------------------
+struct VMModule {
+    std::deque<VMFunction>                      Functions;
+    std::unordered_map<std::string, unsigned>   FunctionSlots;
+    std::vector<VMValue>                        Constants;
+    std::unordered_map<uint64_t, unsigned>      ConstantSlots;
+    std::deque<std::string>                     Strings;
+    unsigned                                    GlobalCount = 0;   // the count of global values
+    std::vector<VMArray>                        GlobalVars;        // a scalar is an array of size 1
+    std::unordered_map<std::string, unsigned>   GlobalSlots;
+    std::vector<unsigned>                       Initializers;      // the functions run before main
+
+    /// @brief the slot of function named name, a new undefined function is
+    /// added if it is not found
+    unsigned getFunctionSlot(const std::string &name);
+    /// @brief the index in GlobalVars of the global named name of size
+    /// values, it is added if it is not found
+    unsigned getGlobalSlot(const std::string &name, unsigned size);
+    /// @brief the index of the constant v in the constant pool
+    unsigned addConstant(VMValue v);
+    /// @brief the string is kept by the module as long as it lives
+    const char *addString(const std::string &str);
+
+    /// @brief print the bytecode of all functions
+    void dump(std::string &out) const;
+};
+
+}
+
+#endif
@@ -1,24 +1,54 @@
 
 #include "ast.h"
 #include <cassert>
+#include <type_traits>
 
 #ifndef KALE_CAST_H
 #define KALE_CAST_H
 
 namespace kale {
 
-template<class Dest, class Source> 
-Dest *kale_cast(Source *node) {
-    if(Dest::canCastTo(node->getClassId())) {
-        return dynamic_cast<Dest*>(node);
-    }
-    return nullptr;
+/// ------------------------------------------------------------------------
+/// the casts of the ast nodes in the way of llvm, they check the class id
+/// stored in ASTBase by Dest::canCastTo, a final class match its own id and
+/// a base class match the id range of its subclasses, then static_cast the
+/// node, so no rtti is needed. They only accept the ast nodes, the llvm
+/// casts are found for the llvm values.
+/// ------------------------------------------------------------------------
+template<class Source>
+using EnableIfAst = typename std::enable_if<std::is_base_of<ASTBase, Source>::value>::type;
+
+/// @brief is the node a Dest, node must not be null
+template<class Dest, class Source, class = EnableIfAst<Source>>
+bool isa(const Source *node) {
+    return Dest::canCastTo(node->getClassId());
 }
 
+/// @brief cast the node to Dest, the node must be a Dest
+template<class Dest, class Source, class = EnableIfAst<Source>>
+Dest *cast(Source *node) {
+    assert(isa<Dest>(node) && "cast to an incompatible ast node");
+    return static_cast<Dest*>(node);
 }
 
-#endif
+/// @brief cast the node to Dest, nullptr if the node is not a Dest
+template<class Dest, class Source, class = EnableIfAst<Source>>
+Dest *dyn_cast(Source *node) {
+    return isa<Dest>(node) ? static_cast<Dest*>(node) : nullptr;
+}
 
+/// @brief as dyn_cast, nullptr if the node is null
+template<class Dest, class Source, class = EnableIfAst<Source>>
+Dest *dyn_cast_or_null(Source *node) {
+    return node ? dyn_cast<Dest>(node) : nullptr;
+}
 
+template<class Dest, class Source, class = EnableIfAst<Source>>
+Dest *kale_cast(Source *node) {
+    return dyn_cast<Dest>(node);
+}
+/// ------------------------------------------------------------------------
 
+}
 
+#endif
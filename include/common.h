@@ -7,29 +7,34 @@ namespace kale {
 /// ------------------------------------------------------------------------
 /// @brief The enum type enum the ast type of kaleidoscope language's
 /// ast node used in ASTBase, Each type of ast node has its own unique id.
+/// The ids of the subclasses of StatementAST, IdDefAST and ExprAST are
+/// contiguous, so a cast to the base class is a check of the id range,
+/// keep a new id in the range of its base class.
 /// ------------------------------------------------------------------------
 enum KAstId {
     ProgramId,          /* This type express program                                        */
-    DataDeclId,         /* This type express var define and var declare                     */
-    VariableId,         /* This type express variable in kaleidoscope                       */
-    IdDefId,            /* This type express id base class in kaleidoscope                  */
-    DataTypeId,         /* This type expression data type in kaleidoscope                   */
-    TypeRefId,          /* This type expression data ref in kaleidoscope                    */
     FuncId,             /* This type express function define and function declare           */
     FuncParamId,        /* This type express function param define                          */
+    DataTypeId,         /* This type expression data type in kaleidoscope                   */
+    TypeRefId,          /* This type expression data ref in kaleidoscope                    */
+
+    IdDefId,            /* This type express id base class in kaleidoscope                  */
+    VariableId,         /* This type express variable in kaleidoscope                       */
+
     StmtId,             /* This type express base statement of statement                    */
     ExprStmtId,         /* This type express expr statement of expr statement               */
+    DataDeclId,         /* This type express var define and var declare                     */
     SwitchId,           /* This type express switch statement                               */
     IfStmtId,           /* This type express if statement                                   */
     ForStmtId,          /* This type express for statement                                  */
     WhileStmtId,        /* This type express while statement                                */
-    InitializeId,       /* This type express var or struct object initialized expression    */
     ReturnStmtId,       /* This type express return statement                               */
     BreakStmtId,        /* This type express break statement                                */
     BlockStmtId,        /* This type express block statement                                */
     ContinueStmtId,     /* This type express continue statement                             */
 
     ExprId,             /* This type express base expr of expression                        */
+    InitializeId,       /* This type express var or struct object initialized expression    */
     BinExprId,          /* This type express bin expr                                       */
     UnaryExprId,        /* This type express unary expr                                     */
     LiteralId,          /* This type express literal                                        */
@@ -41,6 +46,12 @@ enum KAstId {
     /* Low priority */
     LambdaId,           /* This type express lambda expression                              */
     StructId,           /* This type express struct type define                             */
+
+    /* The id ranges of the base classes */
+    FirstIdDefId = IdDefId,     LastIdDefId = VariableId,
+    FirstStmtId  = StmtId,      LastStmtId  = ContinueStmtId,
+    FirstExprId  = ExprId,      LastExprId  = LambdaId,
+    LastAstId    = StructId,
 };
 
 
@@ -106,8 +117,7 @@ enum KaleOptLevel {
 };
 
 #define INSERT_ACCEPT void accept(AstVisitor &v) override; 
-#define INSERT_ENUM(X) KAstId getClassId() override { return X; } \
-                       static KAstId classId() { return X; }
+#define INSERT_ENUM(X) static KAstId classId() { return X; }
 #define INSERT_ENUM_NAME(X) const char* getAstName() override {return #X;}
 
 #define ADD_VISITOR_OVERRIDE(X) void visit(X *node) override;
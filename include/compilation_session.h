@@ -0,0 +1,100 @@
+
+#ifndef KALE_COMPILATION_SESSION_H
+#define KALE_COMPILATION_SESSION_H
+
+#include "common.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace llvm {
+namespace orc {
+class LLJIT;
+class ThreadSafeContext;
+}
+}
+
+namespace kale {
+
+class ProgramAST;
+
+/// ------------------------------------------------------------------------
+/// @brief CompilationSession is the entry to embed kale in a C++ program.
+/// A session own its programs, its LLVMContext and its jit, the sources are
+/// given as strings and the compiled functions are got as function pointers,
+/// nothing is read from or written to the global variables of the driver,
+/// so many sessions can compile concurrently in one process.
+///
+///     CompilationSession session(O2);
+///     session.addSource("poly.k", "def poly(double x) : double { return x * x + 1.0; }");
+///     if(session.compile()) {
+///         auto *poly = session.getFunction<double(double)>("poly");
+///         double y = poly(3.0);
+///     }
+///
+/// A source can import the sources added before it by their names, so the
+/// names should look like "name.k". Sources can be added after a compile,
+/// the next compile only compile the new ones. The functions stay valid as
+/// long as the session lives.
+/// ------------------------------------------------------------------------
+class CompilationSession {
+private:
+    struct Source {
+        std::string  Name;
+        std::string  Text;
+        ProgramAST  *Prog;
+    };
+
+    KaleOptLevel                                    Level;
+    bool                                            Lazy;
+    std::vector<Source>                             Sources;
+    unsigned                                        CompiledCount = 0;    // sources[0, CompiledCount) are in the jit
+    std::unordered_map<std::string, ProgramAST *>   ProgByName;
+    std::unique_ptr<llvm::orc::ThreadSafeContext>   Context;
+    std::unique_ptr<llvm::orc::LLJIT>               JIT;
+    std::string                                     ErrorMsg;
+    std::mutex                                      Lock;
+
+private:
+    bool setError(const std::string &msg);
+    /* Drop the sources failed to compile, so they can be fixed and added again */
+    void dropPendingSources();
+    void releaseSource(Source &src);
+
+public:
+    /// @brief if lazy is true, a function is only optimized and compiled on
+    /// its first call, the pointer got before is a stub
+    explicit CompilationSession(KaleOptLevel level = O0, bool lazy = false);
+    ~CompilationSession();
+    CompilationSession(const CompilationSession&) = delete;
+    CompilationSession &operator=(const CompilationSession&) = delete;
+
+    /// @brief add the source named name, the sources it import must be added
+    /// before. Return false if the name is used or an import is unknown
+    bool addSource(const std::string &name, std::string_view source);
+
+    /// @brief compile the sources added since the last compile and add them
+    /// to the jit. If it fail, those sources are dropped and the message is
+    /// got by getErrorMessage()
+    bool compile();
+
+    /// @brief the address of the compiled function named name, the function
+    /// is compiled to machine code on the first lookup. nullptr if not found
+    void *getFunctionAddress(const std::string &name);
+
+    template<class FuncTy>
+    FuncTy *getFunction(const std::string &name) {
+        return reinterpret_cast<FuncTy *>(getFunctionAddress(name));
+    }
+
+    const std::string &getErrorMessage() const { return ErrorMsg; }
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
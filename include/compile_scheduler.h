@@ -0,0 +1,56 @@
+
+#ifndef KALE_COMPILE_SCHEDULER_H
+#define KALE_COMPILE_SCHEDULER_H
+
+#include "ast.h"
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+#include "llvm/IR/LLVMContext.h"
+#endif
+
+namespace kale {
+
+/// ------------------------------------------------------------------------
+/// @brief CompileScheduler run one compile phase over the programs on a pool
+/// of worker threads. When the phase follow the import DAG, a program is
+/// scheduled only after every program it imports finished the phase, so the
+/// programs which don't depend on each other are compiled concurrently. With
+/// one thread the tasks run on the calling thread in dependency order.
+/// Each worker own a LLVMContext, the ir of a program is generated in the
+/// context of the worker which compile it.
+/// ------------------------------------------------------------------------
+class CompileScheduler {
+public:
+    using Task = std::function<void(ProgramAST *, unsigned worker)>;
+
+private:
+    unsigned ThreadCount;
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+    std::vector<std::unique_ptr<llvm::LLVMContext>> WorkerContexts;
+#endif
+
+public:
+    explicit CompileScheduler(unsigned threadCount);
+
+    /// @brief run task on each program of progs, if followDeps is true the
+    /// dependent programs in progs are finished before the program start
+    void runOnPrograms(const std::vector<ProgramAST *> &progs, const Task &task, bool followDeps);
+
+    unsigned getThreadCount() const { return ThreadCount; }
+
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+    llvm::LLVMContext &getWorkerContext(unsigned worker);
+    /// @brief give up the ownership of the context of worker, used to hand
+    /// the context and its modules to the jit
+    std::unique_ptr<llvm::LLVMContext> takeWorkerContext(unsigned worker);
+#endif
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
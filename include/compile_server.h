@@ -0,0 +1,44 @@
+
+#ifndef KALE_COMPILE_SERVER_H
+#define KALE_COMPILE_SERVER_H
+
+#include <string>
+
+namespace kale {
+
+/// ------------------------------------------------------------------------
+/// @brief The compile server of `kalecc --daemon <socket>`. It listen on a
+/// local unix socket, a kalecc started with $KALE_DAEMON_SOCKET set send
+/// its command line, working directory, environment and standard streams
+/// to it instead of compiling, and exit with the code of the request. The
+/// socket is only open to the user running the server.
+///
+/// Each request is run by a process forked from the server, so the llvm
+/// targets initialized by the server are not initialized again and the
+/// globals of the driver start clean. Before the fork the server parse and
+/// type check the inputs of the request and the files they import, each
+/// program is kept in memory and reused by the next requests reading its
+/// file unchanged, with the same programs for its imports.
+/// ------------------------------------------------------------------------
+
+/// the driver run for each request, main without the client check
+using DriverMain = int (*)(int argc, char *argv[]);
+
+/// @brief serve the requests sent to socketPath until killed, return 1 if
+/// the socket can't be listened
+int runCompileServer(const std::string &socketPath, DriverMain driver);
+
+/// @brief send the command line to the server named by $KALE_DAEMON_SOCKET,
+/// ret is set to the exit code of the request. Return false if no server
+/// answered, the command is then run by this process
+bool forwardToCompileServer(int argc, char *argv[], int &ret);
+
+/// @brief in a request run by the server, set InputFileList and ProgramList
+/// to the programs parsed and type checked by the server for the inputs of
+/// the command line. Return false if there are none, the inputs are then
+/// parsed as usual
+bool usePreparsedPrograms();
+
+}
+
+#endif
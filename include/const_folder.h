@@ -0,0 +1,79 @@
+
+#ifndef KALE_CONST_FOLDER_H
+#define KALE_CONST_FOLDER_H
+
+#include "ast_visitor.h"
+#include "common.h"
+
+#include <cstdint>
+
+namespace kale {
+
+class StatementAST;
+
+/// ------------------------------------------------------------------------
+/// @brief KaleConstFolder is the pass between the type checker and the code
+/// generators. It fold the constant subtrees of the exprs to a number,
+/// replace the reads of a const variable initialized by a constant by its
+/// value, and replace an if statement whose condition is constant by the
+/// branch taken. The values are computed like the bytecode vm run them, an
+/// integer is normalized to the type of the expr and the sign of the expr
+/// choose the signed or unsigned division, compare and shift, so the folded
+/// program print the same as before. What can't be folded safely, as a
+/// division by zero or a shift by the width, is left to the runtime.
+/// The const variables of the imported programs are read, so the pass run
+/// on a program after the programs it import.
+/// ------------------------------------------------------------------------
+class KaleConstFolder : public AstVisitor {
+public:
+    /// @brief a folded value, an integer is kept normalized to Type, sign
+    /// extended if Type is signed, a float is kept as a double rounded to
+    /// float
+    struct Value {
+        KType       Type;
+        uint64_t    Bits;
+        double      FP;
+    };
+
+private:
+    ProgramAST      *Prog{nullptr};
+    ExprAST         *LastExpr{nullptr};         // T ==> the expr replacing the visited expr
+    StatementAST    *LastStmt{nullptr};         // T ==> the stmt replacing the visited stmt
+
+    ExprAST      *foldExpr(ExprAST *expr);
+    StatementAST *foldStmt(StatementAST *stmt);
+    bool          getConstVariable(IdRefAST *ref, Value &value);
+    ExprAST      *createNumber(const Value &value, ExprAST *old);
+
+public:
+    KaleConstFolder() = default;
+
+    /* The value of number converted to ty, false if ty is not a number type */
+    static bool getNumberValue(NumberExprAST *number, KType ty, Value &value);
+    /* Convert value to ty like the store of a variable of ty */
+    static Value convertValue(const Value &value, KType to);
+    static bool foldBinary(Operator op, bool isSigned, const Value &lhs, const Value &rhs, Value &result);
+    static bool foldUnary(Operator op, const Value &operand, Value &result);
+
+public:
+    void visit(ProgramAST       *node) override;
+    void visit(FuncAST          *node) override;
+    void visit(VariableAST      *node) override;
+    void visit(InitializedAST   *node) override;
+    void visit(BlockStmtAST     *node) override;
+    void visit(ExprStmtAST      *node) override;
+    void visit(ReturnStmtAST    *node) override;
+    void visit(ForStmtAST       *node) override;
+    void visit(WhileStmtAST     *node) override;
+    void visit(IfStmtAST        *node) override;
+    void visit(BinaryExprAST    *node) override;
+    void visit(UnaryExprAST     *node) override;
+    void visit(IdRefAST         *node) override;
+    void visit(IdIndexedRefAST  *node) override;
+    void visit(CallExprAST      *node) override;
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
@@ -1,8 +1,15 @@
-
 #ifndef __KALE_ERROR__
 #define __KALE_ERROR__
 
-#define LOG_ERROR(str, lineInfo) printf("error: %d:%d-%d %s\n", InputFileList[lineInfo.FileIndex].c_str(), lineInfo.Row, lineInfo.Col, str); assert(false);
+namespace kale {
+/// thrown after a syntax error is reported, the parse of the program stop
+/// there and GrammarParser::generateSrcToAst catch it
+struct SyntaxError {};
+}
+
+/// the enclosing TokenParser or GrammarParser keep the error with its
+/// file name and count it, so the caller can know the parse failed
+#define LOG_ERROR(str, lineInfo) reportError(str, lineInfo); throw kale::SyntaxError();
 
 #endif // end if KALE_ERROR
 
@@ -26,6 +26,9 @@ extern std::vector<ProgramAST*> ProgramList;
 /// T ==> The output file name
 extern std::string OutputFileName;
 
+/// T ==> The output file name is given by -o
+extern bool ExplicitOutputFile;
+
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
 /// T ==> The print ir flag
 extern bool PrintIR;
@@ -42,6 +45,13 @@ extern bool DumpIRToLL;
 /// T ==> The flag of compile and run executable file
 extern bool CompileAndRun;
 
+/// T ==> Run the programs by the bytecode vm
+extern bool RunInVM;
+extern bool PrintBytecode;
+
+/// T ==> The socket served by the compile server, empty if not a server
+extern std::string DaemonSocket;
+
 /// T ==> Use multi thread compile
 extern bool UseMultThreadCompile;
 extern int ThreadCount;
@@ -49,11 +59,30 @@ extern int ThreadCount;
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
 /// T ==> Use LLVM Tool Chain flag
 extern bool UseLLVMToolChainFlag;
+
+/// T ==> The directory of the object cache, empty if not use cache
+extern std::string CacheDir;
+
+/// T ==> Compile each function on its first call when run by the jit
+extern bool LazyJIT;
+
+/// T ==> Run the functions at O0 first and optimize the hot ones when run by the jit
+extern bool TieredJIT;
+extern unsigned TierUpThreshold;
 #endif
 
 /// T ==> Opt level;
 extern KaleOptLevel OptLevel;
 
+/// T ==> The chrome trace file of the compile time, empty if not traced
+extern std::string TimeTraceFile;
+
+/// T ==> Print the compile time of each phase
+extern bool TimeReport;
+
+/// T ==> Print the statistics as text or json, empty if not printed
+extern std::string StatsFormat;
+
 extern bool UseCheck;
 extern std::string CheckInputFile;
 
@@ -68,6 +97,11 @@ extern bool OnlyPrintIR;
 
 #endif
 
+/// T ==> This global variable define for benchmark
+#ifdef __BENCH_ENABLE__
+extern std::string BenchName;
+#endif
+
 extern std::unordered_set<std::string> StdFunctionSet;
 
 }
@@ -12,12 +12,15 @@
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Verifier.h"
 #include <unordered_map>
+#include <memory>
+#include <mutex>
 
 namespace kale {
 
 class KaleIRBuilder: public AstVisitor {
 
 private:
+    llvm::LLVMContext   &Context;
     llvm::Module        *TheModule;
     llvm::IRBuilder<>   *TheIRBuilder;
     llvm::Function      *CurFunc;
@@ -31,12 +34,17 @@ private:
     std::vector<llvm::BasicBlock *> AfterStack;
     std::vector<llvm::BasicBlock *> CondStack;
 public:
-    KaleIRBuilder(ProgramAST *prog);
+    KaleIRBuilder(ProgramAST *prog, llvm::LLVMContext &ctx);
+    ~KaleIRBuilder();
     void generateProgToIr();    
 
 public:
     llvm::Module *getLLVMModule()  { return TheModule; }
+    /// @brief give up the ownership of the module, the builder can't be
+    /// used to get the module any more
+    std::unique_ptr<llvm::Module> takeLLVMModule();
 protected:
+    ADD_VISITOR_OVERRIDE(ProgramAST)
     ADD_VISITOR_OVERRIDE(FuncAST)
     ADD_VISITOR_OVERRIDE(InitializedAST)
     ADD_VISITOR_OVERRIDE(StructDefAST)
@@ -60,6 +68,12 @@ private:
     llvm::Type         *getLLVMType(DataTypeAST *);
     llvm::Type         *kaleTypeToLLVMType(KType ty);
     llvm::Constant     *createConstantValue(llvm::Type *ty);
+    llvm::Type         *getVariableLLVMType(VariableAST *var);
+
+    bool                isImported(ASTBase *node);
+    llvm::FunctionCallee getCallee(FuncAST *func);
+    llvm::Value        *getIdLLVMValue(IdDefAST *id);
+    llvm::Type         *getIdLLVMType(IdDefAST *id);
 
     long                getConstIntByExpr(ExprAST *expr);
     void                createAndSetCurrentFunc(const llvm::StringRef& name, llvm::FunctionType *ty);
@@ -70,12 +84,19 @@ private:
     void                convertToI1();
     void                generateStdFuncCall(CallExprAST *node);
 private:
+    static std::mutex ProgToIrBuilderMapLock;
     static std::unordered_map<ProgramAST *, KaleIRBuilder *> ProgToIrBuilderMap;
     static std::unordered_map<std::string, std::vector<KType>> StdKaleFuncTypeMap;
-    static std::unordered_map<std::string, llvm::FunctionType*> StdLLVMFuncTypeMap;
+    static thread_local std::unordered_map<std::string, llvm::FunctionType*> StdLLVMFuncTypeMap;
 public:
+    /* Get the builder of prog, a new builder generate ir in GlobalContext */
     static KaleIRBuilder *getOrCreateIrBuilderByProg(ProgramAST *prog);
-    static void initStdFunctionTypeMap();
+    static KaleIRBuilder *getOrCreateIrBuilderByProg(ProgramAST *prog, llvm::LLVMContext &ctx);
+    /* Delete the builder of prog and its module if not taken, must be called before its context is destroyed */
+    static void releaseIrBuilderByProg(ProgramAST *prog);
+    static void initStdFunctionTypeMap(llvm::LLVMContext &ctx);
+    /* Init the types, constants and std function types of ctx for the current thread */
+    static void initContextSupport(llvm::LLVMContext &ctx);
 };
 
 }
@@ -0,0 +1,27 @@
+
+#ifndef KALE_IR_OPTIMIZER_H
+#define KALE_IR_OPTIMIZER_H
+
+#include "common.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+namespace kale {
+
+/// ------------------------------------------------------------------------
+/// @brief KaleIROptimizer run the llvm new pass manager default pipeline of
+/// the opt level on a module, the same pipeline as clang -O1/-O2/-O3, so the
+/// allocas are promoted, the small functions are inlined and the loops are
+/// optimized and vectorized. Nothing is done at O0.
+/// ------------------------------------------------------------------------
+class KaleIROptimizer {
+public:
+    /// @brief optimize module M, TM is used to query the target info used
+    /// by the cost models, it can be nullptr
+    static void optimizeModule(llvm::Module &M, llvm::TargetMachine *TM, KaleOptLevel level);
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
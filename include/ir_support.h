@@ -5,44 +5,50 @@
 
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Constant.h"
+#include "llvm/IR/LLVMContext.h"
 
 namespace kale {
 
+/// ------------------------------------------------------------------------
+/// @brief The llvm types and constants of kaleidoscope belong to a context,
+/// each compile thread generate ir in its own context, so they are thread
+/// local and must be inited by the thread before generating ir.
+/// ------------------------------------------------------------------------
 class KaleIRTypeSupport {
 
 public:
-    static llvm::Type *KaleVoidType;
-    static llvm::Type *KaleBoolType;
-    static llvm::Type *KaleCharType;
-    static llvm::Type *KaleUCharType;
-    static llvm::Type *KaleShortType;
-    static llvm::Type *KaleUShortType;
-    static llvm::Type *KaleIntType;
-    static llvm::Type *KaleUIntType;
-    static llvm::Type *KaleLongType;
-    static llvm::Type *KaleULongType;
-    static llvm::Type *KaleFloatType;
-    static llvm::Type *KaleDoubleType;
-
-    static void initIRTypeSupport();
+    static thread_local llvm::Type *KaleVoidType;
+    static thread_local llvm::Type *KaleBoolType;
+    static thread_local llvm::Type *KaleCharType;
+    static thread_local llvm::Type *KaleUCharType;
+    static thread_local llvm::Type *KaleShortType;
+    static thread_local llvm::Type *KaleUShortType;
+    static thread_local llvm::Type *KaleIntType;
+    static thread_local llvm::Type *KaleUIntType;
+    static thread_local llvm::Type *KaleLongType;
+    static thread_local llvm::Type *KaleULongType;
+    static thread_local llvm::Type *KaleFloatType;
+    static thread_local llvm::Type *KaleDoubleType;
+
+    static void initIRTypeSupport(llvm::LLVMContext &ctx);
 };
 
 
 class KaleIRConstantValueSupport {
 
 public:
-    static llvm::Constant *KaleTrue;
-    static llvm::Constant *KaleFalse;
-    static llvm::Constant *KaleCharZero;
-    static llvm::Constant *KaleUCharZero;
-    static llvm::Constant *KaleShortZero;
-    static llvm::Constant *KaleUShortZero;
-    static llvm::Constant *KaleIntZero;
-    static llvm::Constant *KaleUIntZero;
-    static llvm::Constant *KaleLongZero;
-    static llvm::Constant *KaleULongZero;
-    static llvm::Constant *KaleFloatZero;
-    static llvm::Constant *KaleDoubleZero;
+    static thread_local llvm::Constant *KaleTrue;
+    static thread_local llvm::Constant *KaleFalse;
+    static thread_local llvm::Constant *KaleCharZero;
+    static thread_local llvm::Constant *KaleUCharZero;
+    static thread_local llvm::Constant *KaleShortZero;
+    static thread_local llvm::Constant *KaleUShortZero;
+    static thread_local llvm::Constant *KaleIntZero;
+    static thread_local llvm::Constant *KaleUIntZero;
+    static thread_local llvm::Constant *KaleLongZero;
+    static thread_local llvm::Constant *KaleULongZero;
+    static thread_local llvm::Constant *KaleFloatZero;
+    static thread_local llvm::Constant *KaleDoubleZero;
 
     static void initIRConastantSupport();
 };
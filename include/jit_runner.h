@@ -0,0 +1,63 @@
+
+#ifndef KALE_JIT_RUNNER_H
+#define KALE_JIT_RUNNER_H
+
+#include "common.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/Module.h"
+
+#include <string>
+#include <memory>
+
+namespace kale {
+
+class CompileScheduler;
+class KaleObjectCache;
+
+/// ------------------------------------------------------------------------
+/// @brief KaleJITRunner run the programs in process with the llvm orc LLJIT,
+/// used by `kalecc -r` when no output file is asked. The modules are
+/// optimized at the opt level, compiled to memory and main is called
+/// directly, no object file, linker or child process is involved. The kale
+/// std functions are resolved to the ones linked into kalecc. With
+/// --lazy-jit a function is only compiled when it is first called, with
+/// --tiered-jit the programs are run by KaleTieredJIT.
+/// ------------------------------------------------------------------------
+class KaleJITRunner {
+public:
+    /// @brief jit the modules of all programs and call main. The contexts of
+    /// the workers of scheduler are moved into the jit, so the modules can't
+    /// be used after. If stdoutFile is not empty, the output of the program
+    /// is written to it. Return false if the jit failed, else ret is set to
+    /// the value returned by main. The programs found in cache are loaded
+    /// from their cached objects, the others are stored to it once compiled
+    static bool runMain(CompileScheduler &scheduler, int &ret, const std::string &stdoutFile = "",
+                        KaleObjectCache *cache = nullptr);
+
+    /// @brief the target machine builder of the host generating code at
+    /// level, the native target is initialized on the first call
+    static llvm::Expected<llvm::orc::JITTargetMachineBuilder> detectHost(KaleOptLevel level);
+    /// @brief bind the kale std functions called by the programs to the ones
+    /// linked into kalecc, in the main dylib of J
+    static llvm::Error defineStdSymbols(llvm::orc::LLJIT &J);
+    /// @brief create a jit for the host compiling at level, the kale std
+    /// functions are defined in its main dylib. The objects compiled are
+    /// passed to cache if it is given
+    static llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> createJIT(KaleOptLevel level,
+                                                                        llvm::ObjectCache *cache = nullptr);
+    /// @brief create a lazy jit for the host, a function is optimized at
+    /// level and compiled on its first call, a stub stand for it before
+    static llvm::Expected<std::unique_ptr<llvm::orc::LLLazyJIT>> createLazyJIT(KaleOptLevel level);
+    /// @brief set the data layout and triple of J to M and optimize M at
+    /// level, M is ready to be added to J after
+    static llvm::Error prepareModule(llvm::orc::LLJIT &J, llvm::Module &M, KaleOptLevel level);
+    /// @brief prepare the module of TSM and add it to J, J must be created
+    /// by createLazyJIT if lazy is true
+    static llvm::Error addModule(llvm::orc::LLJIT &J, llvm::orc::ThreadSafeModule TSM, KaleOptLevel level, bool lazy);
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
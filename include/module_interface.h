@@ -0,0 +1,101 @@
+
+#ifndef KALE_MODULE_INTERFACE_H
+#define KALE_MODULE_INTERFACE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace kale {
+
+class GrammarParser;
+
+/// ------------------------------------------------------------------------
+/// @brief ModuleInterface is the compact binary form of the global symbols a
+/// program define, what its importers look up by getFuncASTNode and
+/// getVariableNodeFromGlobalMap: the function signatures, the global
+/// variables with their types, array dimensions and const values. An
+/// importer of a program which need not be compiled read its interface
+/// instead of lexing and parsing its source, the functions and variables
+/// are created as declarations in the arena of the program.
+///
+/// The file is a header followed by fixed size records and a string table,
+/// so it is read in place from the mapped file:
+///     InterfaceHeader | FuncRecord[] | VarRecord[] | int64 dims[] | names
+/// The variable records are the globals followed by the params of the
+/// functions, the names are offsets into the string table.
+/// ------------------------------------------------------------------------
+class ModuleInterface {
+public:
+    static const uint32_t Magic   = 0x494c414b;     // "KALI"
+    static const uint32_t Version = 1;
+
+    struct InterfaceHeader {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t FuncCount;
+        uint32_t GlobalCount;
+        uint32_t ParamCount;
+        uint32_t DimCount;
+        uint32_t StringSize;
+        uint32_t Reserved;
+    };
+
+    enum FuncFlag : uint8_t {
+        FuncDefined = 0x1,          // has a body, a def and not an extern
+    };
+
+    struct FuncRecord {
+        uint32_t Name;
+        uint8_t  RetType;           // KType, NoType if the return type is absent
+        uint8_t  Flags;
+        uint16_t Reserved;
+        uint32_t FirstParam;        // index in the params
+        uint32_t ParamCount;
+    };
+
+    enum VarFlag : uint8_t {
+        VarConst  = 0x1,
+        VarStatic = 0x2,
+        VarExtern = 0x4,
+        ValueSigned = 0x8,          // the const value is a signed integer literal
+    };
+
+    enum ValueKind : uint8_t {
+        NoValue,
+        IntValue,
+        DoubleValue,
+        CharValue,
+        BoolValue,
+    };
+
+    struct VarRecord {
+        uint32_t Name;
+        uint8_t  Type;              // KType
+        uint8_t  Flags;
+        uint8_t  Kind;              // ValueKind of the const value
+        uint8_t  Reserved;
+        uint32_t FirstDim;          // index in the dims
+        uint32_t DimCount;
+        union {
+            int64_t IntVal;
+            double  DoubleVal;
+        } Value;
+    };
+
+    static const uint8_t NoType = 0xff;
+
+public:
+    /// @brief serialize the global symbols of the program parsed by parser
+    /// to out, return false if an array dimension is not a constant
+    static bool write(GrammarParser &parser, std::string &out);
+
+    /// @brief create the global symbols of the program of parser from the
+    /// interface in data, return false if it is malformed
+    static bool read(GrammarParser &parser, const char *data, size_t size);
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+
+#ifndef KALE_OBJECT_CACHE_H
+#define KALE_OBJECT_CACHE_H
+
+#include "ast.h"
+#include "parser.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+namespace kale {
+
+/// ------------------------------------------------------------------------
+/// @brief KaleObjectCache is the on disk cache of the object files emitted
+/// for the programs. The key of a program is the hash of its source, the
+/// keys of the programs it import, the opt level, the target and the
+/// compiler, so a program is found in the cache only if nothing it is built
+/// from changed. A cached program is not parsed, checked or generated, its
+/// object is linked or loaded directly. Kind separate the objects emitted by
+/// the aot path and the jit, which use different code models.
+/// Next to the object a cached program has its module interface, the
+/// importers which are compiled load it instead of parsing the program.
+/// It is also the llvm ObjectCache of the jit, the objects compiled by the
+/// jit for the registered modules are stored by notifyObjectCompiled.
+/// ------------------------------------------------------------------------
+class KaleObjectCache : public llvm::ObjectCache {
+private:
+    std::string CacheDir;
+    std::string Kind;
+    std::unordered_map<ProgramAST *, std::string> Keys;
+    std::unordered_map<ProgramAST *, bool>        Cached;
+    std::mutex                                     ModuleLock;
+    std::unordered_map<const llvm::Module *, ProgramAST *> ModuleProgs;
+
+private:
+    const std::string &computeKey(ProgramAST *prog);
+    bool writeFile(const std::string &path, llvm::StringRef data);
+
+public:
+    KaleObjectCache(const std::string &dir, const std::string &kind);
+
+    /// @brief compute the keys of progs and look them up in the cache
+    void lookupPrograms(const std::vector<ProgramAST *> &progs);
+
+    bool isCached(ProgramAST *prog) const;
+    std::string getObjectPath(ProgramAST *prog) const;
+
+    /// @brief the programs must be parsed, they are the ones not cached and
+    /// the programs imported by them, in the order of progs
+    std::vector<ProgramAST *> getProgramsToParse(const std::vector<ProgramAST *> &progs) const;
+    /// @brief the programs not cached, in the order of progs
+    std::vector<ProgramAST *> getProgramsToCompile(const std::vector<ProgramAST *> &progs) const;
+
+    /// @brief write the object of prog to the cache, thread safe
+    bool store(ProgramAST *prog, llvm::StringRef object);
+
+    std::string getInterfacePath(ProgramAST *prog) const;
+    /// @brief create the exports of the cached prog from its interface,
+    /// return false if it has none and must be parsed
+    bool loadInterface(ProgramAST *prog, GrammarParser *parser) const;
+    /// @brief write the interface of prog parsed by parser if the cache
+    /// has none, thread safe
+    bool storeInterface(ProgramAST *prog, GrammarParser *parser);
+
+    /// @brief the object compiled by the jit for M will be stored as the
+    /// object of prog
+    void registerModule(const llvm::Module *M, ProgramAST *prog);
+
+    void notifyObjectCompiled(const llvm::Module *M, llvm::MemoryBufferRef Obj) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *M) override;
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
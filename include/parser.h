@@ -4,8 +4,13 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <string_view>
 #include "token.h"
+#include "source_buffer.h"
 #include "ast.h"
+#include "statistic.h"
 
 namespace kale {
 
@@ -14,33 +19,188 @@ namespace kale {
 /// sources file stream to Token. One TokenParser can deal
 /// one sources file,  This object-oriented design, with 
 /// fewer definitions of global variables, is designed to 
-/// accommodate multithreaded compilation
+/// accommodate multithreaded compilation. The whole file
+/// is hold by a SourceBuffer and scanned by pointer, the
+/// identifier and literal value are views into the buffer.
 /// -----------------------------------------------------
 class TokenParser {
 private:
     LineNo LineInfo;    
     double DoubleNumVal;
     long long IntNumVal;
-    std::string LiteralVal;
-    std::string IdStr;
+    std::string_view LiteralVal;
+    std::string_view IdStr;
     int LastChar;
     bool IsSigned;
 private:
-    FILE *Handle;
+    std::unique_ptr<SourceBuffer> Buffer;
+    const char *BufPtr;
+    const char *BufEnd;
+    std::string FileName;
+    unsigned ErrorCount = 0;
+    std::vector<std::string> ErrorMessages;
 public:
     Token getToken();
     void getChar();
+private:
+    /* Pointer to the character hold by LastChar */
+    const char *getCurCharPtr() const { return LastChar == EOF ? BufPtr : BufPtr - 1; }
 public:
     explicit TokenParser(unsigned fileIndex);
+    /* Lex the source in buffer, fileName is only used by the error message */
+    TokenParser(unsigned fileIndex, std::unique_ptr<SourceBuffer> buffer, const std::string &fileName);
     bool openSuccess();
 
+    /* Keep the error at line and count it, the driver print them after the parse */
+    void reportError(const char *msg, const LineNo &line);
+    unsigned getErrorCount() const { return ErrorCount; }
+    /* The errors as "file:row-col message" */
+    const std::vector<std::string> &getErrorMessages() const { return ErrorMessages; }
+    const std::string &getFileName() const { return FileName; }
+
+    /* Return the keyword token of id, or tok_id if id is not a keyword */
+    static Token matchKeyword(std::string_view id);
+
     LineNo getCurLineNo() const { return LineInfo; }
     double getDoubleVal() const { return DoubleNumVal; }
     long long getIntVal()    const { return IntNumVal; }
-    const std::string& getIdStr() const { return IdStr; }
-    const std::string& getLiteral() const { return LiteralVal; }
+    std::string_view getIdStr() const { return IdStr; }
+    std::string_view getLiteral() const { return LiteralVal; }
     bool   isSigned() { return IsSigned; }
-    std::vector<Token> lookUp(unsigned i);
+};
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// @brief TokenInfo hold one token lexed by TokenParser
+/// with its value, EndLoc is the location of the lexer
+/// after this token was lexed.
+/// -----------------------------------------------------
+struct TokenInfo {
+    Token            Kind;
+    LineNo           EndLoc;
+    std::string_view Str;           // identifier or literal
+    Symbol           Sym;           // interned identifier
+    long long        IntVal;
+    double           DoubleVal;
+    bool             IsSigned;
+};
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// @brief Token stream class, this class buffer the tokens
+/// lexed by TokenParser in a bounded ring, lookUp(n) and
+/// getNextToken() share the buffered tokens, so each byte
+/// of the sources file is lexed exactly once.
+/// -----------------------------------------------------
+class TokenStream {
+private:
+    static constexpr unsigned RingSize = 4;     // must be power of 2
+    TokenParser *Lexer;
+    TokenInfo    Ring[RingSize];
+    unsigned     Head;                          // index of the next token
+    unsigned     Count;                         // count of buffered tokens
+    TokenInfo    CurTok;                        // the last consumed token
+    unsigned     TokenCount = 0;                // count of lexed tokens
+private:
+    void lexOneToken();
+public:
+    explicit TokenStream(TokenParser *lexer);
+
+    /* Consume next token */
+    Token getNextToken();
+    /* Get the n-th token after current token without consume it, n >= 1 */
+    Token lookUp(unsigned n);
+
+    LineNo getCurLineNo() const { return CurTok.EndLoc; }
+    double getDoubleVal() const { return CurTok.DoubleVal; }
+    long long getIntVal()    const { return CurTok.IntVal; }
+    std::string_view getIdStr() const { return CurTok.Str; }
+    Symbol getIdSymbol() const { return CurTok.Sym; }
+    std::string_view getLiteral() const { return CurTok.Str; }
+    bool   isSigned() const { return CurTok.IsSigned; }
+    unsigned getTokenCount() const { return TokenCount; }
+};
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// @brief ScopedSymbolTable is the symbol table of local
+/// variables. All scopes share one flat entry array, each
+/// entry link to the entry it shadows, and Heads map the id
+/// of a name to its innermost entry, so a lookup is a single
+/// index. Leaving a scope pops the entries after the scope
+/// mark and restore the shadowed heads, no allocation is
+/// needed when entering a block.
+/// -----------------------------------------------------
+class ScopedSymbolTable {
+private:
+    struct Entry {
+        Symbol       Name;
+        VariableAST *Var;
+        int          Shadowed;          // entry index of the outer same name, -1 if none
+    };
+    std::vector<Entry>    Entries;
+    std::vector<int>      Heads;        // indexed by symbol id, -1 if not defined
+    std::vector<unsigned> ScopeMarks;   // size of Entries when enter each scope
+
+    int getHead(Symbol name) const {
+        return name.getId() < Heads.size() ? Heads[name.getId()] : -1;
+    }
+public:
+    void enterScope() { ScopeMarks.push_back(Entries.size()); }
+    void leaveScope();
+
+    /* Is there no local scope, means in global scope */
+    bool empty() const { return ScopeMarks.empty(); }
+    unsigned getDepth() const { return ScopeMarks.size(); }
+
+    /* Find the innermost variable named name, nullptr if not found */
+    VariableAST *lookup(Symbol name) const {
+        int head = getHead(name);
+        return head < 0 ? nullptr : Entries[head].Var;
+    }
+    /* Insert var to the current scope, return false if the current scope already has this name */
+    bool insert(Symbol name, VariableAST *var);
+};
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// @brief ExportIndex is the view of the global functions
+/// and variables a program can see from another program,
+/// including the symbols got from its own imports. It only
+/// hold the symbols defined by the program and the indexes
+/// of its imports, a symbol got from the imports is found
+/// by a walk of the import DAG, so an index doesn't copy
+/// the symbols of every transitive import. The importer
+/// keep the symbols it found. Each entry records the
+/// program that define the symbol.
+/// -----------------------------------------------------
+struct ExportIndex {
+    struct FuncEntry {
+        FuncAST    *Func;
+        ProgramAST *Origin;         // the program define this function
+    };
+    struct VarEntry {
+        VariableAST *Var;
+        ProgramAST  *Origin;        // the program define this variable
+    };
+    std::unordered_map<Symbol, FuncEntry> Funcs;        // defined by the program
+    std::unordered_map<Symbol, VarEntry>  Vars;
+    std::unordered_set<Symbol>            HiddenVars;   // the static variables hide the imported ones
+    std::vector<const ExportIndex *>      Deps;         // the indexes of the imports, in import order
+
+    /* Find the symbol in this index then in the imports, the first import define a name wins */
+    const FuncEntry *findFunc(Symbol name) const;
+    const VarEntry *findVar(Symbol name) const;
+    void clear();
+
+private:
+    using VisitedSet = std::unordered_set<const ExportIndex *>;
+    const FuncEntry *findFunc(Symbol name, VisitedSet &visited) const;
+    const VarEntry *findVar(Symbol name, VisitedSet &visited) const;
 };
 /// -----------------------------------------------------
 
@@ -52,10 +212,22 @@ class GrammarParser {
 private:
     ProgramAST *ProgAst;
     TokenParser *TkParser;
+    TokenStream *TkStream;
     Token CurTok;
 public:
     explicit GrammarParser(ProgramAST *prog);
+    /* Parse the source in buffer instead of the input file of prog */
+    GrammarParser(ProgramAST *prog, std::unique_ptr<SourceBuffer> buffer, const std::string &fileName);
+    ~GrammarParser();
+    GrammarParser(const GrammarParser&) = delete;
+    GrammarParser &operator=(const GrammarParser&) = delete;
+
     void generateSrcToAst();
+    /* Create the global symbols from the module interface in data instead of parsing the source, false if it is malformed */
+    bool generateFromInterface(const char *data, size_t size);
+    /* Count of the errors found while parsing */
+    unsigned getErrorCount() const { return TkParser->getErrorCount(); }
+    const std::vector<std::string> &getErrorMessages() const { return TkParser->getErrorMessages(); }
 private:
     void getNextToken();
     void parseProgram();
@@ -94,13 +266,23 @@ private:
     ExprAST *parseCallExpr();
     ExprAST *parseConstExpr();
 
+    /* Create ast node in the arena of current program */
+    template<class T, class... Args>
+    T *createNode(Args&&... args) {
+        NodeCounts[T::classId()]++;
+        return ProgAst->getArena().create<T>(std::forward<Args>(args)...);
+    }
+
 public:
     /* Get function def ast , if not have define or extern, will return nullptr */
-    FuncAST *getFuncASTNode(const std::string & name);
+    FuncAST *getFuncASTNode(Symbol name);
     /* Get variable def ast , if not have define or extern, will return nullptr */
-    VariableAST *getVariableNode(const std::string& name);
-    VariableAST *getVariableNodeFromGlobalMap(const std::string& name);
-    VariableAST *getVariableNodeFromOtherGlobalMap(const std::string& name);
+    VariableAST *getVariableNode(Symbol name);
+    VariableAST *getVariableNodeFromGlobalMap(Symbol name);
+    /* Get the program define the imported function or variable, nullptr if not imported */
+    ProgramAST *getImportOrigin(Symbol name);
+    /* Index of the symbols other programs can see by importing this program */
+    const ExportIndex &getExports() { return Exports; }
     /* Insert function define to this map, if already define this func, it will return false */
     bool insertFunctionToFuncMap(FuncAST *node);
     /* Insert variable define to this map, if already define this func, it will return false */
@@ -111,18 +293,40 @@ public:
 private:
     void enterNewSymTab();
     void leaveCurSymTab();
+    void buildImportIndex();
+    void buildExportIndex();
+    const ExportIndex::FuncEntry *findImportedFunc(Symbol name);
+    const ExportIndex::VarEntry *findImportedVar(Symbol name);
+    void reportError(const char *msg, const LineNo &line) { TkParser->reportError(msg, line); }
+    /* Add the counts of this program to the statistics */
+    void addStatistics();
+
+    /* The module interface read and write the global maps */
+    friend class ModuleInterface;
 
 private:
     bool IsFuncScope = false;
     std::vector<ASTBase *> NodeStack;
-    std::unordered_map<std::string, FuncAST *> FuncDefMap;
-    std::unordered_map<std::string, VariableAST *> GlobalVariableMap;
-    std::vector<std::unordered_map<std::string, VariableAST *>> SymTabMap;
+    std::unordered_map<Symbol, FuncAST *> FuncDefMap;
+    std::unordered_map<Symbol, VariableAST *> GlobalVariableMap;
+    ScopedSymbolTable SymTab;
+    ExportIndex Imports;                // the indexes of the dependent programs
+    std::unordered_map<Symbol, const ExportIndex::FuncEntry *> ImportedFuncs;  // found in Imports, nullptr if not
+    std::unordered_map<Symbol, const ExportIndex::VarEntry *>  ImportedVars;
+    ExportIndex Exports;                // symbols visible to the importers
+    uint32_t NodeCounts[KaleStatistics::AstKindCount] = {};
+    uint64_t SymbolLookups = 0;
+    uint64_t SymbolLookupMisses = 0;
 private:
+    static std::mutex ProgToGrammarParserMapLock;
     static std::unordered_map<ProgramAST *, GrammarParser *> ProgToGrammarParserMap;
 
 public:
     static GrammarParser *getOrCreateGrammarParserByProg(ProgramAST *prog);
+    /* Create the parser of prog which parse the source in memory */
+    static GrammarParser *createGrammarParserBySource(ProgramAST *prog, std::string_view source, const std::string &fileName);
+    /* Delete the parser of prog, the parser can't be used after */
+    static void releaseGrammarParserByProg(ProgramAST *prog);
 };
 /// -----------------------------------------------------
 
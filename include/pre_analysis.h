@@ -2,17 +2,69 @@
 #ifndef KALE_PRE_ANALYSIS_H
 #define KALE_PRE_ANALYSIS_H
 
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace kale {
 
+class ProgramAST;
+
+/// -------------------------------------------------------------
+/// @brief ImportGraph is the import relation of the programs,
+/// built once in compressed adjacency form. Its strongly
+/// connected components are found by an iterative Tarjan pass
+/// in linear time. Tarjan emit a component after all the
+/// components it imports, so when every component is a single
+/// program the emit order is a compile order. A component with
+/// more than one program, or a program importing itself, is an
+/// import cycle.
+/// -------------------------------------------------------------
+class ImportGraph {
+private:
+    std::vector<ProgramAST *> Progs;
+    std::vector<unsigned>     EdgeStart;        // edges of node i are [EdgeStart[i], EdgeStart[i+1])
+    std::vector<unsigned>     Edges;            // node index of the imported program
+    std::vector<unsigned>     Order;            // nodes in emit order, grouped by component
+    std::vector<unsigned>     ComponentStart;   // component i is Order[ComponentStart[i], ComponentStart[i+1])
+    std::vector<bool>         CyclicComponent;
+
+private:
+    void computeComponents();
+
+public:
+    /// @brief the imports out of progs are ignored
+    explicit ImportGraph(const std::vector<ProgramAST *> &progs);
+
+    bool isAcyclic() const;
+    /// @brief the programs with the imported ones first, the programs
+    /// of a cycle are adjacent
+    std::vector<ProgramAST *> getCompileOrder() const;
+    /// @brief the programs of each import cycle
+    std::vector<std::vector<ProgramAST *>> getCycles() const;
+    /// @brief one import path through the programs of cycle, each
+    /// program import the next one and the last import the first
+    std::vector<ProgramAST *> getCyclePath(const std::vector<ProgramAST *> &cycle) const;
+};
+/// -------------------------------------------------------------
+
 /// -------------------------------------------------------------
 /// @brief This function parse input sources file list
 /// create the top ProgramAST node, and analysis the dependence
 /// of the program file. 
 /// @return if program' defpendence is a DAG return true, if not
-/// return false
+/// return false. On success ProgramList is in compile order, the
+/// imported programs before their importers.
 /// -------------------------------------------------------------
 bool preFileDepAnalysis();
 
+/// -------------------------------------------------------------
+/// @brief Collect the file names imported by the source held in
+/// memory, in import order. Unlike preFileDepAnalysis it use no
+/// global state, so it can be called from many threads.
+/// -------------------------------------------------------------
+std::vector<std::string> scanImportFileNames(std::string_view source);
+
 }
 
 #endif 
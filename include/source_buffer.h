@@ -0,0 +1,48 @@
+
+#ifndef KALE_SOURCE_BUFFER_H
+#define KALE_SOURCE_BUFFER_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// @brief SourceBuffer hold the whole content of a source
+/// file as an immutable continuous memory block. The file
+/// is memory-mapped when possible and read into heap memory
+/// otherwise, so the lexer can scan it with a plain pointer
+/// instead of going through stdio for every byte.
+/// -----------------------------------------------------
+class SourceBuffer {
+private:
+    const char *BufStart;
+    const char *BufEnd;
+    bool        IsMapped;
+
+private:
+    SourceBuffer(const char *start, const char *end, bool mapped)
+        : BufStart(start), BufEnd(end), IsMapped(mapped) {}
+
+public:
+    ~SourceBuffer();
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer &operator=(const SourceBuffer&) = delete;
+
+    /// @brief open file and map it to memory, return nullptr if the
+    /// file can't be opened
+    static std::unique_ptr<SourceBuffer> getFile(const std::string &fileName);
+    /// @brief copy the source held in memory to a new buffer
+    static std::unique_ptr<SourceBuffer> getMemBufferCopy(std::string_view source);
+
+    const char *getBufferStart() const { return BufStart; }
+    const char *getBufferEnd()   const { return BufEnd; }
+    size_t      getBufferSize()  const { return BufEnd - BufStart; }
+};
+/// -----------------------------------------------------
+
+}
+
+#endif
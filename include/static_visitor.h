@@ -0,0 +1,220 @@
+/**
+ * @overview: This file is the static visitor, the visitor dispatched by
+ * the class id of the ast node without the virtual accept and visit.
+*/
+
+#ifndef KALE_STATIC_VISITOR_H
+#define KALE_STATIC_VISITOR_H
+
+#include "ast.h"
+
+namespace kale {
+
+#define StaticTraversNode(X) if(X) { derived().traverse(X); }
+
+#define StaticTraversArray(X) for(auto *elem : X) { derived().traverse(elem); }
+
+/// ------------------------------------------------------------------------
+/// @brief StaticAstVisitor is the base class of the passes that visit the
+/// ast without the double virtual dispatch of AstVisitor. The pass extends
+/// StaticAstVisitor<Pass> and is run by pass.traverse(prog), traverse
+/// switch on getClassId() and call the visit of Pass for the node type,
+/// the visits, preAction and postAction of Pass are not virtual, so they
+/// are inlined in the traversal. The default visits travers the children
+/// in the same order as AstVisitor. A pass overriding some visits must
+/// bring the default ones in scope by using StaticAstVisitor::visit.
+/// ------------------------------------------------------------------------
+template<class Derived>
+class StaticAstVisitor {
+protected:
+    Derived &derived() { return *static_cast<Derived *>(this); }
+
+public:
+    void traverse(ASTBase *node) {
+        switch (node->getClassId()) {
+            case ProgramId:         return derived().visit(static_cast<ProgramAST *>(node));
+            case FuncParamId:       return derived().visit(static_cast<ParamAST *>(node));
+            case FuncId:            return derived().visit(static_cast<FuncAST *>(node));
+            case InitializeId:      return derived().visit(static_cast<InitializedAST *>(node));
+            case StructId:          return derived().visit(static_cast<StructDefAST *>(node));
+            case DataTypeId:        return derived().visit(static_cast<DataTypeAST *>(node));
+            case VariableId:        return derived().visit(static_cast<VariableAST *>(node));
+            case DataDeclId:        return derived().visit(static_cast<DataDeclAST *>(node));
+            case BlockStmtId:       return derived().visit(static_cast<BlockStmtAST *>(node));
+            case ReturnStmtId:      return derived().visit(static_cast<ReturnStmtAST *>(node));
+            case BreakStmtId:       return derived().visit(static_cast<BreakStmtAST *>(node));
+            case ContinueStmtId:    return derived().visit(static_cast<ContinueStmtAST *>(node));
+            case ForStmtId:         return derived().visit(static_cast<ForStmtAST *>(node));
+            case WhileStmtId:       return derived().visit(static_cast<WhileStmtAST *>(node));
+            case IfStmtId:          return derived().visit(static_cast<IfStmtAST *>(node));
+            case BinExprId:         return derived().visit(static_cast<BinaryExprAST *>(node));
+            case UnaryExprId:       return derived().visit(static_cast<UnaryExprAST *>(node));
+            case LiteralId:         return derived().visit(static_cast<LiteralExprAST *>(node));
+            case NumberId:          return derived().visit(static_cast<NumberExprAST *>(node));
+            case IdRefId:           return derived().visit(static_cast<IdRefAST *>(node));
+            case IdIndexedRefId:    return derived().visit(static_cast<IdIndexedRefAST *>(node));
+            case CallId:            return derived().visit(static_cast<CallExprAST *>(node));
+            case ExprStmtId:        return derived().visit(static_cast<ExprStmtAST *>(node));
+            default:                return derived().visit(node);
+        }
+    }
+
+public:
+    void preAction(ASTBase *) {}
+    void postAction(ASTBase *) {}
+
+public:
+    void visit(ASTBase *node) {
+        derived().preAction(node);
+        derived().postAction(node);
+    }
+
+    void visit(ProgramAST *node) {
+        derived().preAction(node);
+        StaticTraversArray(node->getCompElems());
+        derived().postAction(node);
+    }
+
+    void visit(ParamAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getId());
+        derived().postAction(node);
+    }
+
+    void visit(FuncAST *node) {
+        derived().preAction(node);
+        StaticTraversArray(node->getParams());
+        StaticTraversNode(node->getBlockStmt());
+        derived().postAction(node);
+    }
+
+    void visit(InitializedAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getInitExpr());
+        StaticTraversNode(node->getExpr());
+        derived().postAction(node);
+    }
+
+    void visit(StructDefAST *node) {
+        derived().preAction(node);
+        derived().postAction(node);
+    }
+
+    void visit(DataTypeAST *node) {
+        derived().preAction(node);
+        derived().postAction(node);
+    }
+
+    void visit(VariableAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getDataType());
+        StaticTraversNode(node->getInitExpr());
+        derived().postAction(node);
+    }
+
+    void visit(DataDeclAST *node) {
+        derived().preAction(node);
+        StaticTraversArray(node->getVarDecls());
+        derived().postAction(node);
+    }
+
+    void visit(BlockStmtAST *node) {
+        derived().preAction(node);
+        StaticTraversArray(node->getStmts());
+        derived().postAction(node);
+    }
+
+    void visit(ReturnStmtAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getRetExpr());
+        derived().postAction(node);
+    }
+
+    void visit(BreakStmtAST *node) {
+        derived().preAction(node);
+        derived().postAction(node);
+    }
+
+    void visit(ContinueStmtAST *node) {
+        derived().preAction(node);
+        derived().postAction(node);
+    }
+
+    void visit(ForStmtAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getExpr1());
+        StaticTraversNode(node->getExpr2());
+        StaticTraversNode(node->getExpr3());
+        StaticTraversNode(node->getStatement());
+        derived().postAction(node);
+    }
+
+    void visit(WhileStmtAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getCond());
+        StaticTraversNode(node->getStatement());
+        derived().postAction(node);
+    }
+
+    void visit(IfStmtAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getCond());
+        StaticTraversNode(node->getStatement());
+        StaticTraversNode(node->getElse());
+        derived().postAction(node);
+    }
+
+    void visit(BinaryExprAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getLhs());
+        StaticTraversNode(node->getRhs());
+        derived().postAction(node);
+    }
+
+    void visit(UnaryExprAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getUnaryExpr());
+        derived().postAction(node);
+    }
+
+    void visit(LiteralExprAST *node) {
+        derived().preAction(node);
+        derived().postAction(node);
+    }
+
+    void visit(NumberExprAST *node) {
+        derived().preAction(node);
+        derived().postAction(node);
+    }
+
+    void visit(IdRefAST *node) {
+        derived().preAction(node);
+        derived().postAction(node);
+    }
+
+    void visit(IdIndexedRefAST *node) {
+        derived().preAction(node);
+        StaticTraversArray(node->getIndexes());
+        derived().postAction(node);
+    }
+
+    void visit(CallExprAST *node) {
+        derived().preAction(node);
+        StaticTraversArray(node->getArgs());
+        derived().postAction(node);
+    }
+
+    void visit(ExprStmtAST *node) {
+        derived().preAction(node);
+        StaticTraversNode(node->getExpr());
+        derived().postAction(node);
+    }
+};
+/// ------------------------------------------------------------------------
+
+#undef StaticTraversNode
+#undef StaticTraversArray
+
+}
+
+#endif
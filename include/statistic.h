@@ -0,0 +1,92 @@
+
+#ifndef KALE_STATISTIC_H
+#define KALE_STATISTIC_H
+
+#include "common.h"
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+namespace kale {
+
+class ProgramAST;
+
+/// ------------------------------------------------------------------------
+/// @brief KaleStatistic is a named counter of a subsystem, defined as a
+/// static variable by KALE_STATISTIC, it register itself to KaleStatistics
+/// when constructed. The counter is atomic since the programs are compiled
+/// on the workers, so the hot loops count in a local variable and add it
+/// once, the parser count the tokens and the nodes of a program and add
+/// them when the program is parsed.
+/// ------------------------------------------------------------------------
+class KaleStatistic {
+private:
+    const char *Group;
+    const char *Name;
+    const char *Desc;
+    std::atomic<uint64_t> Value{0};
+
+public:
+    KaleStatistic(const char *group, const char *name, const char *desc);
+    KaleStatistic(const KaleStatistic&) = delete;
+    KaleStatistic &operator=(const KaleStatistic&) = delete;
+
+    void add(uint64_t n) { Value.fetch_add(n, std::memory_order_relaxed); }
+    KaleStatistic &operator++() { add(1); return *this; }
+    KaleStatistic &operator+=(uint64_t n) { add(n); return *this; }
+
+    /// @brief keep the max of the value and n
+    void updateMax(uint64_t n);
+
+    const char *getGroup() const { return Group; }
+    const char *getName()  const { return Name; }
+    const char *getDesc()  const { return Desc; }
+    uint64_t    getValue() const { return Value.load(std::memory_order_relaxed); }
+    void        reset()          { Value.store(0, std::memory_order_relaxed); }
+};
+
+#define KALE_STATISTIC(VAR, GROUP, DESC) static kale::KaleStatistic VAR(GROUP, #VAR, DESC)
+/// ------------------------------------------------------------------------
+
+
+/// ------------------------------------------------------------------------
+/// @brief KaleStatistics is the registry of the statistics, it also hold
+/// the ast nodes created per KAstId, the values of each module and the
+/// memory used after each compile phase, which are only recorded when
+/// the statistics are enabled by --stats. They are printed to stderr as a
+/// text table or a json object.
+/// ------------------------------------------------------------------------
+class KaleStatistics {
+private:
+    static bool Enabled;
+
+public:
+    static bool isEnabled() { return Enabled; }
+    static void enable();
+
+    /// @brief add the count of the nodes of each kind, counts is indexed
+    /// by KAstId and has AstKindCount entries
+    static constexpr unsigned AstKindCount = LastAstId + 1;
+    static void addAstNodes(const uint32_t *counts);
+
+    /// @brief record a value of the module of prog, as the instructions
+    /// emitted for it
+    static void addModuleValue(ProgramAST *prog, const char *name, uint64_t value);
+
+    /// @brief record the heap in use, the resident memory and the peak
+    /// resident memory of the process at the end of phase
+    static void endPhase(const char *phase) {
+        if(Enabled) recordPhase(phase);
+    }
+    static void recordPhase(const char *phase);
+
+    /// @brief print the statistics, format is text or json, return false
+    /// if the format is unknown
+    static bool print(const std::string &format);
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+
+#ifndef KALE_SYMBOL_H
+#define KALE_SYMBOL_H
+
+#include <string>
+#include <string_view>
+#include <functional>
+
+namespace kale {
+
+/// ------------------------------------------------------------------------
+/// @brief Symbol is the compact id of an identifier interned in the global
+/// SymbolTable. Every spelling of a name is stored once, so two Symbols are
+/// the same name if and only if their ids are equal, comparing and hashing a
+/// name become integer operations. Id 0 is the empty name.
+/// ------------------------------------------------------------------------
+class Symbol {
+private:
+    unsigned Id;
+
+public:
+    Symbol() : Id(0) {}
+    explicit Symbol(unsigned id) : Id(id) {}
+
+    /// @brief intern the string and return its symbol, thread safe
+    static Symbol intern(std::string_view str);
+
+    unsigned getId()   const { return Id; }
+    bool     isEmpty() const { return Id == 0; }
+
+    /// @brief the interned spelling, the storage lives as long as the process
+    const std::string &str()   const;
+    const char        *c_str() const { return str().c_str(); }
+
+    bool operator==(Symbol other) const { return Id == other.Id; }
+    bool operator!=(Symbol other) const { return Id != other.Id; }
+    bool operator<(Symbol other)  const { return Id < other.Id; }
+};
+/// ------------------------------------------------------------------------
+
+
+/// ------------------------------------------------------------------------
+/// @brief SymbolTable is the process wide string interner. The strings are
+/// kept in fixed size chunks which are never moved, so the string of a
+/// symbol can be read without lock once the symbol is got, only intern()
+/// and the hash map behind it are guarded by a lock.
+/// ------------------------------------------------------------------------
+class SymbolTable {
+public:
+    static Symbol             intern(std::string_view str);
+    static const std::string &getString(Symbol sym);
+    static unsigned           getSymbolCount();
+};
+/// ------------------------------------------------------------------------
+
+}
+
+namespace std {
+template<>
+struct hash<kale::Symbol> {
+    size_t operator()(kale::Symbol sym) const noexcept { return sym.getId(); }
+};
+}
+
+#endif
@@ -0,0 +1,95 @@
+
+#ifndef KALE_TIERED_JIT_H
+#define KALE_TIERED_JIT_H
+
+#include "common.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+namespace kale {
+
+/// ------------------------------------------------------------------------
+/// @brief KaleTieredJIT run the programs with two tiers, used by
+/// `kalecc -r --tiered-jit`. Every function is first compiled at O0 and
+/// called through an indirection stub, its baseline code count the calls
+/// and the loop back edges. When the count of a function reach the
+/// threshold, it is optimized at the opt level and compiled on a background
+/// thread, then the pointer of its stub is swapped to the optimized code,
+/// the calls after use it. A function running in a loop is not replaced
+/// before it returns, so main always stay at the baseline.
+/// ------------------------------------------------------------------------
+class KaleTieredJIT {
+private:
+    struct TieredFunction {
+        std::string                     Name;       // the name of the stub, the name called by the programs
+        llvm::Module                   *Baseline;   // the copy of the module before the counters are added
+        llvm::orc::ThreadSafeContext    Context;
+        bool                            Requested;
+    };
+
+    KaleOptLevel                                        Level;
+    unsigned                                            Threshold;
+    std::unique_ptr<llvm::TargetMachine>                BaselineTM;
+    std::unique_ptr<llvm::TargetMachine>                OptimizedTM;
+    std::unique_ptr<llvm::TargetMachine>                OptimizerTM;
+    std::unique_ptr<llvm::orc::LLJIT>                   J;
+    std::unique_ptr<llvm::orc::IndirectStubsManager>    Stubs;
+    std::vector<std::pair<std::unique_ptr<llvm::Module>, llvm::orc::ThreadSafeContext>> Baselines;
+    std::deque<TieredFunction>                          Functions;
+    unsigned                                            BaselineCount = 0;  // functions[0, BaselineCount) have baseline code
+
+    std::mutex                                          QueueLock;
+    std::condition_variable                             QueueCond;
+    std::deque<unsigned>                                Queue;
+    bool                                                Stopping = false;
+    std::thread                                         Worker;
+    std::atomic<unsigned>                               TieredUpCount{0};
+
+private:
+    KaleTieredJIT(KaleOptLevel level, unsigned threshold);
+
+    /* Called by the baseline code when the count of function id reach the threshold */
+    static void requestTierUp(KaleTieredJIT *self, int id);
+    void runWorker();
+    llvm::Error compileOptimized(unsigned id);
+    void instrumentFunction(llvm::Function &F, unsigned id);
+
+public:
+    ~KaleTieredJIT();
+    KaleTieredJIT(const KaleTieredJIT&) = delete;
+    KaleTieredJIT &operator=(const KaleTieredJIT&) = delete;
+
+    /// @brief create a tiered jit for the host, the hot functions are
+    /// optimized at level once they are counted threshold times
+    static llvm::Expected<std::unique_ptr<KaleTieredJIT>> create(KaleOptLevel level, unsigned threshold);
+
+    /// @brief add the module of TSM at the baseline tier, the functions it
+    /// define are renamed and a stub is defined for each of them
+    llvm::Error addModule(llvm::orc::ThreadSafeModule TSM);
+
+    /// @brief compile the baseline code of the functions added and point
+    /// their stubs to it, must be called before any function is looked up
+    llvm::Error compileBaseline();
+
+    llvm::orc::LLJIT &getJIT() { return *J; }
+
+    /// @brief the count of functions swapped to the optimized code
+    unsigned getTieredUpCount() const { return TieredUpCount.load(); }
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
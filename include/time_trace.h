@@ -0,0 +1,84 @@
+
+#ifndef KALE_TIME_TRACE_H
+#define KALE_TIME_TRACE_H
+
+#include <string>
+#include <cstdint>
+
+namespace kale {
+
+class ProgramAST;
+
+/// ------------------------------------------------------------------------
+/// @brief KaleTimeTrace record the wall and cpu time of the scopes of the compile
+/// phases, the phases of each program and the functions of each program.
+/// It is enabled by --time-trace and --time-report, the events are written
+/// as a chrome trace event file, open it in chrome://tracing or perfetto,
+/// and summed by name into a table printed to stderr.
+/// When it is not enabled a scope cost only a test of a flag.
+/// ------------------------------------------------------------------------
+class KaleTimeTrace {
+private:
+    static bool Enabled;
+
+public:
+    static bool isEnabled() { return Enabled; }
+
+    /// @brief enable the trace, the time of the events is from here
+    static void begin();
+
+    /// @brief record the scope name started at start, the times are in
+    /// micro seconds
+    static void record(const char *name, const std::string &detail, uint64_t start, uint64_t cpuStart, unsigned tid);
+
+    /// @brief record the Total event and write the trace file and the
+    /// report asked, nothing is done if the trace is not enabled
+    static void finish(const std::string &traceFile, bool report);
+
+    /// @brief the wall time since begin and the cpu time of this thread
+    static uint64_t getWallTime();
+    static uint64_t getCpuTime();
+
+    /// @brief a small id of the calling thread, the first thread asking
+    /// get 0
+    static unsigned getThreadId();
+};
+/// ------------------------------------------------------------------------
+
+
+/// ------------------------------------------------------------------------
+/// @brief KaleTimeTraceScope record an event from its construction to its
+/// destruction, the detail is the module or function it is about
+/// ------------------------------------------------------------------------
+class KaleTimeTraceScope {
+private:
+    const char *Name;
+    std::string Detail;
+    uint64_t    Start;
+    uint64_t    CpuStart;
+    unsigned    Tid;
+    bool        Active;
+
+    void start();
+
+public:
+    explicit KaleTimeTraceScope(const char *name) : Name(name), Active(KaleTimeTrace::isEnabled()) {
+        if(Active) start();
+    }
+    KaleTimeTraceScope(const char *name, const std::string &detail) : Name(name), Active(KaleTimeTrace::isEnabled()) {
+        if(Active) { Detail = detail; start(); }
+    }
+    /// @brief the detail is the source file of prog
+    KaleTimeTraceScope(const char *name, ProgramAST *prog);
+    ~KaleTimeTraceScope() {
+        if(Active) KaleTimeTrace::record(Name, Detail, Start, CpuStart, Tid);
+    }
+
+    KaleTimeTraceScope(const KaleTimeTraceScope&) = delete;
+    KaleTimeTraceScope &operator=(const KaleTimeTraceScope&) = delete;
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
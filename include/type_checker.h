@@ -5,18 +5,27 @@
 #ifndef KALEIDSCOPE_TYPE_CHECKER_H
 #define KALEIDSCOPE_TYPE_CHECKER_H
 
-#include "ast_visitor.h"
+#include "static_visitor.h"
 #include "common.h"
 
+#include <string>
+
 namespace kale {
-    class TypeChecker : public AstVisitor {
+    /// type checker is a static visitor, run it by checker.traverse(prog)
+    class TypeChecker : public StaticAstVisitor<TypeChecker> {
+        std::string ErrorMsg;
+
+        void setError(const std::string &msg, ExprAST *node);
     public:
-        void visit(kale::BinaryExprAST   *node) override;
-        void visit(kale::CallExprAST     *node) override;
-        void visit(kale::UnaryExprAST    *node) override;
-        void visit(kale::NumberExprAST   *node) override;
-        void visit(kale::IdRefAST        *node) override;
-        void visit(kale::IdIndexedRefAST *node) override;
+        using StaticAstVisitor::visit;
+
+        void visit(kale::FuncAST         *node);
+        void visit(kale::BinaryExprAST   *node);
+        void visit(kale::CallExprAST     *node);
+        void visit(kale::UnaryExprAST    *node);
+        void visit(kale::NumberExprAST   *node);
+        void visit(kale::IdRefAST        *node);
+        void visit(kale::IdIndexedRefAST *node);
 
 
         static unsigned getTypeSize(KType t);
@@ -28,6 +37,11 @@ namespace kale {
     public:
         static bool isSigned(KType);
 
+        /// the first type error as "row-col message", empty if the program
+        /// is well typed
+        const std::string &getErrorMessage() const { return ErrorMsg; }
+        bool hasError() const { return !ErrorMsg.empty(); }
+
     };
 }
 
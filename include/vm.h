@@ -0,0 +1,70 @@
+
+#ifndef KALE_VM_H
+#define KALE_VM_H
+
+#include "common.h"
+#include "bytecode.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace kale {
+
+/// ------------------------------------------------------------------------
+/// @brief KaleVM interpret the bytecode built by KaleVMBuilder, it is the
+/// engine of `kalecc --vm` and needs no llvm. The registers of a function
+/// are a window of the value stack, a call copy the args to the window of
+/// the callee after the frame of the caller. The instructions are
+/// dispatched by computed goto when the compiler support it, else by a
+/// switch. A division by zero, an index out of its array or a too deep
+/// recursion stop the program with an error instead of crashing kalecc.
+/// ------------------------------------------------------------------------
+class KaleVM {
+private:
+    struct Frame {
+        const VMFunction   *Func;
+        const VMInst       *RetPc;      // the instruction after the call
+        VMValue            *Base;
+        unsigned            Dest;       // the register of the caller set to the result
+    };
+
+    VMModule                          &Module;
+    std::vector<const VMFunction *>    FunctionTable;
+    std::vector<VMValue>               Globals;
+    std::unique_ptr<VMValue[]>         Stack;         // not zeroed, a frame zero its own registers
+    std::vector<Frame>                 Frames;
+    unsigned                           MainSlot = 0;
+    bool                               Linked = false;
+    std::string                        ErrorMsg;
+
+private:
+    /* Run the function of slot on an empty stack, result is set to its return value */
+    bool execute(unsigned slot, VMValue &result);
+    void callStd(uint8_t func, VMValue *args, unsigned count, VMValue &result);
+    bool runtimeError(const VMFunction *func, const VMInst *pc, const std::string &msg);
+
+public:
+    explicit KaleVM(VMModule &module);
+
+    /// @brief check that every function called is defined and main exists,
+    /// must be called once all programs are built to the module
+    bool link();
+
+    /// @brief run the initializers of the globals and then main. If
+    /// stdoutFile is not empty, the output of the program is written to it.
+    /// Return false if the program is stopped by an error, else ret is set
+    /// to the value returned by main
+    bool runMain(int &ret, const std::string &stdoutFile = "");
+
+    const std::string &getErrorMessage() const { return ErrorMsg; }
+
+    /// @brief the count of values of the stack, the frames of the calls in
+    /// progress must fit in it
+    static constexpr unsigned StackSize = 1 << 20;
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
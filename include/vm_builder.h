@@ -0,0 +1,111 @@
+
+#ifndef KALE_VM_BUILDER_H
+#define KALE_VM_BUILDER_H
+
+#include "common.h"
+#include "ast_visitor.h"
+#include "bytecode.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace kale {
+
+class IdDefAST;
+class VariableAST;
+
+/// ------------------------------------------------------------------------
+/// @brief KaleVMBuilder lower the typed ast of a program to the register
+/// bytecode of KaleVM, it is the backend next to KaleIRBuilder and
+/// CppBuilder used by `kalecc --vm`. The values are converted like the ir
+/// builder do, so a program print the same in the vm and in the jit. The
+/// local scalars live in registers, an expression is computed into the
+/// register of the variable it is assigned to when it can.
+/// ------------------------------------------------------------------------
+class KaleVMBuilder : public AstVisitor {
+private:
+    struct LoopLabels {
+        std::vector<unsigned> Breaks;
+        std::vector<unsigned> Continues;
+    };
+
+    VMModule                                    &Module;
+    VMFunction                                  *CurFunc = nullptr;
+    KType                                        CurRetType = Void;
+    unsigned                                     NextReg = 0;
+    unsigned                                     LocalArraySize = 0;
+    std::unordered_map<VariableAST *, unsigned>  LocalRegs;
+    std::unordered_map<VariableAST *, unsigned>  LocalArrays;
+    std::vector<LoopLabels>                      Loops;
+    std::string                                  ErrorMsg;
+
+    /// the result of the last expression, Kind is its type, Str for a string
+    int                                          DestHint = -1;
+    unsigned                                     LastReg = 0;
+    KType                                        LastKind = Void;
+    bool                                         LastIsStr = false;
+
+private:
+    void setError(const std::string &msg);
+    unsigned allocReg();
+    unsigned emit(VMOpcode op, unsigned a = 0, unsigned b = 0, unsigned c = 0, uint32_t imm = 0, uint8_t aux = 0);
+    void patchJump(unsigned at);
+    /* The register the expression is computed to, the hint if one is given */
+    unsigned takeDest();
+
+    unsigned compileExpr(ExprAST *expr, int dest = -1);
+    /* Emit the jumps taken if cond is jumpIfTrue, their targets are patched later */
+    void compileCond(ExprAST *cond, bool jumpIfTrue, std::vector<unsigned> &jumps);
+    /* Convert the last value to ty like convertToAimType of the ir builder */
+    unsigned convertTo(unsigned reg, KType from, KType to, int dest = -1);
+    /* Convert the operands of a binary expr to one type like typeConvert */
+    KType unifyOperands(unsigned &lhs, KType lk, unsigned &rhs, KType rk);
+    unsigned convertSign(unsigned reg, KType ty, bool isSigned);
+    unsigned loadConstInt(int64_t v);
+    long getConstInt(ExprAST *expr);
+    unsigned getArraySize(VariableAST *var);
+    bool isGlobal(VariableAST *var);
+    void compileIndex(IdIndexedRefAST *node, unsigned &indexReg);
+    void compileStdCall(CallExprAST *node);
+    void finishFunction();
+
+public:
+    explicit KaleVMBuilder(VMModule &module);
+
+    /// @brief lower prog to the module, false if prog use what the vm can't
+    /// run, the reason is got by getErrorMessage()
+    bool buildProgram(ProgramAST *prog);
+    const std::string &getErrorMessage() const { return ErrorMsg; }
+
+    /// @brief the normalize aux of integer type ty, 0 if ty is not integer
+    static uint8_t getNormalizeAux(KType ty);
+    static unsigned getTypeBits(KType ty);
+    static bool isFPType(KType ty) { return ty == Float || ty == Double; }
+
+public:
+    void visit(ProgramAST       *node) override;
+    void visit(FuncAST          *node) override;
+    void visit(VariableAST      *node) override;
+    void visit(DataDeclAST      *node) override;
+    void visit(BlockStmtAST     *node) override;
+    void visit(ExprStmtAST      *node) override;
+    void visit(ReturnStmtAST    *node) override;
+    void visit(BreakStmtAST     *node) override;
+    void visit(ContinueStmtAST  *node) override;
+    void visit(ForStmtAST       *node) override;
+    void visit(WhileStmtAST     *node) override;
+    void visit(IfStmtAST        *node) override;
+    void visit(BinaryExprAST    *node) override;
+    void visit(UnaryExprAST     *node) override;
+    void visit(LiteralExprAST   *node) override;
+    void visit(NumberExprAST    *node) override;
+    void visit(IdRefAST         *node) override;
+    void visit(IdIndexedRefAST  *node) override;
+    void visit(CallExprAST      *node) override;
+};
+/// ------------------------------------------------------------------------
+
+}
+
+#endif
@@ -0,0 +1,41 @@
+
+#include "arena.h"
+
+namespace kale {
+
+/// ----------------------------------------------------------
+/// ASTArena code
+void *ASTArena::allocateSlow(size_t size, size_t align) {
+    /// big object get a slab of its own, so the rest space of current
+    /// slab can still be used by the following small objects
+    size_t paddedSize = size + align - 1;
+    if(paddedSize > SlabSize / 2) {
+        char *slab = new char[paddedSize];
+        Slabs.push_back(slab);
+        BytesAllocated += size;
+        uintptr_t ptr = ((uintptr_t)slab + align - 1) & ~(uintptr_t)(align - 1);
+        return (void *)ptr;
+    }
+
+    char *slab = new char[SlabSize];
+    Slabs.push_back(slab);
+    CurPtr = slab;
+    End = slab + SlabSize;
+    return allocate(size, align);
+}
+
+void ASTArena::reset() {
+    for(auto it = Dtors.rbegin(); it != Dtors.rend(); it++) {
+        it->Dtor(it->Obj);
+    }
+    Dtors.clear();
+    for(char *slab : Slabs) {
+        delete[] slab;
+    }
+    Slabs.clear();
+    CurPtr = End = nullptr;
+    BytesAllocated = 0;
+}
+/// ----------------------------------------------------------
+
+}
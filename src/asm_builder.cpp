@@ -4,129 +4,230 @@
 #include "asm_builder.h"
 
 #include "global_variable.h"
+#include "time_trace.h"
+#include "statistic.h"
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
 #include "ir_builder.h"
+#include "compile_scheduler.h"
+#include "ir_optimizer.h"
+#include "object_cache.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/SmallString.h"
 #endif
 
-//#include "llvm/IR/LegacyPassManager.h"
-//#include "llvm/Support/ThreadPool.h"
-//#include "llvm/Support/Host.h"
-//#include "llvm/Support/TargetRegistry.h"
-//#include "llvm/Support/TargetSelect.h"
-//#include "llvm/Bitcode/BitcodeReader.h"
-//#include "llvm/Bitcode/BitcodeWriter.h"
-//#include "llvm/Support/ErrorOr.h"
-//#include "llvm/Support/MemoryBuffer.h"
-//#include "llvm/Target/TargetMachine.h"
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+/// The driver used to link the object files, only the link step is
+/// run out of process
+#ifndef KALE_LINKER
+#define KALE_LINKER "clang++-15"
+#endif
 
 
 namespace kale {
 
-//    static const llvm::Target *createTarget(const std::string& targetTriple) {
-//        std::string error;
-//        auto Target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
-//        if(!Target) {
-//            llvm::errs() << error;
-//            exit(1);
-//        }
-//
-//        return Target;
-//    }
-
-//    static void gencode(llvm::Module &M, llvm::TargetMachine *TM, llvm::raw_pwrite_stream &OS,
-//                        llvm::CodeGenFileType FT) {
-//        llvm::legacy::PassManager CodeGenPass;
-//        switch (OptLevel) {
-//            case O0: TM->setOptLevel(llvm::CodeGenOpt::None);
-//                break;
-//            case O1: TM->setOptLevel(llvm::CodeGenOpt::Less);
-//                break;
-//            case O2: TM->setOptLevel(llvm::CodeGenOpt::Default);
-//                break;
-//            case O3: TM->setOptLevel(llvm::CodeGenOpt::Aggressive);
-//                break;
-//        }
-//        if(TM->addPassesToEmitFile(CodeGenPass, OS, nullptr, FT)) {
-//            llvm::report_fatal_error("failed to gencode");
-//        }
-//        CodeGenPass.run(M);
-//    }
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+    KALE_STATISTIC(ObjectsEmitted,   "codegen", "Number of object files emitted");
+    KALE_STATISTIC(ObjectBytes,      "codegen", "Bytes of the object files emitted");
+    KALE_STATISTIC(ObjectsFromCache, "codegen", "Number of object files linked from the cache");
+    KALE_STATISTIC(ObjectsLinked,    "codegen", "Number of object files linked");
+
+    static const llvm::Target *createTarget(const std::string& targetTriple) {
+        std::string error;
+        auto Target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+        if(!Target) {
+            llvm::errs() << error;
+            exit(1);
+        }
+
+        return Target;
+    }
+
+    static llvm::CodeGenOpt::Level getCodeGenOptLevel() {
+        switch (OptLevel) {
+            case O1: return llvm::CodeGenOpt::Less;
+            case O2: return llvm::CodeGenOpt::Default;
+            case O3: return llvm::CodeGenOpt::Aggressive;
+            default: return llvm::CodeGenOpt::None;
+        }
+    }
+
+    /// the objects run on the machine compile them, so the host cpu and
+    /// its features are used when the target is the host
+    static llvm::TargetMachine *createTargetMachine(const std::string& targetTriple) {
+        auto Target = createTarget(targetTriple);
+        std::string cpu = "generic";
+        std::string features;
+        if(targetTriple == llvm::sys::getDefaultTargetTriple()) {
+            cpu = llvm::sys::getHostCPUName().str();
+            llvm::StringMap<bool> hostFeatures;
+            if(llvm::sys::getHostCPUFeatures(hostFeatures)) {
+                for(auto &feature : hostFeatures) {
+                    features += (feature.second ? "+" : "-") + feature.first().str() + ",";
+                }
+            }
+        }
+        llvm::TargetOptions options;
+        return Target->createTargetMachine(targetTriple, cpu, features, options,
+                                           llvm::Reloc::PIC_, llvm::None, getCodeGenOptLevel());
+    }
+
+    static void gencode(llvm::Module &M, llvm::TargetMachine *TM, llvm::raw_pwrite_stream &OS,
+                        llvm::CodeGenFileType FT) {
+        llvm::legacy::PassManager CodeGenPass;
+        if(TM->addPassesToEmitFile(CodeGenPass, OS, nullptr, FT)) {
+            llvm::report_fatal_error("failed to gencode");
+        }
+        CodeGenPass.run(M);
+    }
+#endif
 
     AsmBuilder::AsmBuilder() {
         TargetCPU = X86_64;
     }
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
-    LLVMBuilderChain::LLVMBuilderChain(const std::string& rpath) : AsmBuilder() {
+    LLVMBuilderChain::LLVMBuilderChain(const std::string& rpath, CompileScheduler *scheduler,
+                                       KaleObjectCache *cache)
+        : AsmBuilder(), Scheduler(scheduler), Cache(cache) {
         Rpath = rpath.substr(0, rpath.size()-6);
     }
 
-    unsigned LLVMBuilderChain::runAndCompileToExecutable() {
-//        llvm::InitializeAllTargets();
-//        llvm::InitializeAllTargetMCs();
-//        llvm::InitializeAllAsmParsers();
-//        llvm::InitializeAllAsmPrinters();
-//
-//        for(auto *prog : ProgramList) {
-//            auto builder = KaleIRBuilder::getOrCreateIrBuilderByProg(prog);
-//            auto targetTriple = builder->getLLVMModule()->getTargetTriple();
-//            auto Target = createTarget(targetTriple);
-//
-//            llvm::TargetMachine *TM = Target->createTargetMachine(targetTriple, "generic", "", {}, llvm::Reloc::PIC_);
-//            std::string filename = "kale_mod";
-//            filename += std::to_string(prog->getLineNo()->FileIndex) + ".o";
-//            ObjFileList.push_back(filename);
-//            std::error_code EC;
-//            llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
-//            if(EC) {
-//                llvm::errs() << "Could not open file: " << EC.message();
-//                exit(1);
-//            }
-//
-//            gencode(*builder->getLLVMModule(), TM, dest, llvm::CGFT_ObjectFile);
-//
-//            dest.flush();
-//            dest.close();
-//        }
-//
-//        std::string cmd = "clang++-12 ";
-//        for(auto &file : ObjFileList) {
-//            cmd += file + " ";
-//        }
-//
-//        cmd += "-L" + Rpath + "/../lib " + "-lkale_std -o " + OutputFileName;
-//        auto res = system(cmd.c_str());
-//
-//        if(res) {
-//            return res;
-//        }
-//
-//        system("rm *.o");
+    /// emit the object file of prog from its in memory module, the object
+    /// is also stored to the cache if it is given
+    static bool emitObjectFile(ProgramAST *prog, const std::string &filename, KaleObjectCache *cache) {
+        auto *module = KaleIRBuilder::getOrCreateIrBuilderByProg(prog)->getLLVMModule();
+        std::unique_ptr<llvm::TargetMachine> TM(createTargetMachine(module->getTargetTriple()));
+        module->setDataLayout(TM->createDataLayout());
+        KaleIROptimizer::optimizeModule(*module, TM.get(), OptLevel);
+
+        if(DumpIRToLL) {
+            std::error_code EC;
+            std::string llName = "kale_mod" + std::to_string(prog->getLineNo()->FileIndex) + ".ll";
+            llvm::raw_fd_ostream dest(llName, EC, llvm::sys::fs::OF_None);
+            if(!EC)
+                module->print(dest, nullptr);
+        }
+
+        llvm::SmallVector<char, 0> object;
+        llvm::raw_svector_ostream objStream(object);
+        {
+            KaleTimeTraceScope scope("EmitObject", prog);
+            gencode(*module, TM.get(), objStream, llvm::CGFT_ObjectFile);
+        }
+        llvm::StringRef objData(object.data(), object.size());
+        ++ObjectsEmitted;
+        ObjectBytes += objData.size();
+        if(KaleStatistics::isEnabled())
+            KaleStatistics::addModuleValue(prog, "object bytes", objData.size());
+        if(cache) {
+            cache->store(prog, objData);
+        }
+
         std::error_code EC;
+        llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
+        if(EC) {
+            llvm::errs() << "Could not open file: " << EC.message() << "\n";
+            return false;
+        }
+        dest << objData;
+        dest.flush();
+        return true;
+    }
+
+    unsigned LLVMBuilderChain::runAndCompileToExecutable() {
+        static std::once_flag InitTarget;
+        std::call_once(InitTarget, [] {
+            llvm::InitializeNativeTarget();
+            llvm::InitializeNativeTargetAsmPrinter();
+        });
+
+        /// the cached objects are linked from the cache directly, the others
+        /// are emitted to unique temporary files, so the kalecc run in the
+        /// same directory don't overwrite the objects of each other
+        std::vector<ProgramAST *> emitList;
+        std::vector<std::string> tmpFileList;
+        std::map<ProgramAST *, std::string> objFileOfProg;
+        bool success = true;
         for(auto *prog : ProgramList) {
-            std::string filename = "kale_mod";
-            filename += std::to_string(prog->getLineNo()->FileIndex) + ".ll";
-            ObjFileList.push_back(filename);
-            llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
-            KaleIRBuilder::getOrCreateIrBuilderByProg(prog)->getLLVMModule()->print(dest, nullptr);
-            dest.flush();
-            dest.close();
+            if(Cache && Cache->isCached(prog)) {
+                ++ObjectsFromCache;
+                ObjFileList.push_back(Cache->getObjectPath(prog));
+                continue;
+            }
+            llvm::SmallString<128> tmpName;
+            std::string prefix = "kale_mod" + std::to_string(prog->getLineNo()->FileIndex);
+            if(auto EC = llvm::sys::fs::createTemporaryFile(prefix, "o", tmpName)) {
+                llvm::errs() << "Could not create temporary file: " << EC.message() << "\n";
+                success = false;
+                break;
+            }
+            ObjFileList.push_back(tmpName.str().str());
+            tmpFileList.push_back(ObjFileList.back());
+            objFileOfProg[prog] = ObjFileList.back();
+            emitList.push_back(prog);
         }
 
-        std::string cmd = "clang++-15 ";
-        cmd += "-L" + Rpath + "/../lib ";
-        //clang++-15 -L/mnt/d/compiler/build/bin/../lib modle0.ll -lkale_std -o a.out
-        for(auto &file : ObjFileList) {
-            cmd += file + " ";
+        /// a worker generated several modules in its context and the context
+        /// is not thread safe, so the modules of a context are emitted one
+        /// by one, the modules of different contexts are emitted concurrently
+        std::map<llvm::LLVMContext *, std::mutex> contextLocks;
+        for(auto *prog : emitList) {
+            contextLocks[&KaleIRBuilder::getOrCreateIrBuilderByProg(prog)->getLLVMModule()->getContext()];
+        }
+        std::mutex lock;
+        auto emit = [&](ProgramAST *prog, unsigned) {
+            auto &context = KaleIRBuilder::getOrCreateIrBuilderByProg(prog)->getLLVMModule()->getContext();
+            bool emitted;
+            {
+                std::lock_guard<std::mutex> contextGuard(contextLocks.at(&context));
+                emitted = emitObjectFile(prog, objFileOfProg.at(prog), Cache);
+            }
+            if(!emitted) {
+                std::lock_guard<std::mutex> guard(lock);
+                success = false;
+            }
+        };
+        if(!success) {
+            emitList.clear();
+        }
+        if(Scheduler) {
+            Scheduler->runOnPrograms(emitList, emit, false);
+        }
+        else {
+            for(auto *prog : emitList) {
+                emit(prog, 0);
+            }
+        }
+
+        unsigned res = 1;
+        if(success) {
+            std::string cmd = KALE_LINKER " ";
+            for(auto &file : ObjFileList) {
+                cmd += file + " ";
+            }
+            cmd += "-L" + Rpath + "/../lib " + "-lkale_std -o " + OutputFileName;
+            KaleTimeTraceScope scope("Link", cmd);
+            ObjectsLinked += ObjFileList.size();
+            res = system(cmd.c_str());
+        }
+
+        for(auto &file : tmpFileList) {
+            std::remove(file.c_str());
         }
-        cmd += "-lkale_std -o " + OutputFileName;
-        auto res = system(cmd.c_str());
         return res;
     }
 #endif
 }
-
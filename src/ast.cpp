@@ -5,7 +5,8 @@ namespace kale{
 
 /// ----------------------------------------------------------
 /// ASTBase code
-ASTBase::ASTBase(const LineNo& lineNo, ASTBase *parent) : LineMsg(lineNo),
+ASTBase::ASTBase(KAstId kind, const LineNo& lineNo, ASTBase *parent) : LineMsg(lineNo),
+                                         Kind(kind),
                                          Parent(parent),
                                          Program(nullptr){}
                                         
@@ -27,20 +28,20 @@ void ASTBase::setProgram(ProgramAST *prog) {
 
 /// ----------------------------------------------------------
 /// ProgramAST define code
-ProgramAST::ProgramAST(const LineNo &lineNo, ASTBase *parent) : ASTBase(lineNo, parent) {
+ProgramAST::ProgramAST(const LineNo &lineNo, ASTBase *parent) : ASTBase(ProgramId, lineNo, parent) {
 }
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// ParamAST define code
-ParamAST::ParamAST(const LineNo &lineNo, ASTBase *parent, VariableAST *id) : ASTBase(lineNo, parent), Id(id) {
+ParamAST::ParamAST(const LineNo &lineNo, ASTBase *parent, VariableAST *id) : ASTBase(FuncParamId, lineNo, parent), Id(id) {
 
 }
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// FuncAST define code
-FuncAST::FuncAST(const LineNo &lineNo, ASTBase *parent, const std::string& funcName) : ASTBase(lineNo, parent) {
+FuncAST::FuncAST(const LineNo &lineNo, ASTBase *parent, Symbol funcName) : ASTBase(FuncId, lineNo, parent) {
     this->FuncName = funcName;
     this->RetType = nullptr;
     this->BlockStmt = nullptr;
@@ -49,85 +50,85 @@ FuncAST::FuncAST(const LineNo &lineNo, ASTBase *parent, const std::string& funcN
 
 /// ----------------------------------------------------------
 /// InitializedAST define code
-InitializedAST::InitializedAST(const LineNo &lineNo, ASTBase *parent) : ExprAST(lineNo, parent) {}
+InitializedAST::InitializedAST(const LineNo &lineNo, ASTBase *parent) : ExprAST(InitializeId, lineNo, parent) {}
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// StructDefAST define code
-StructDefAST::StructDefAST(const LineNo &lineNo, ASTBase *parent) : ASTBase(lineNo, parent) {}
+StructDefAST::StructDefAST(const LineNo &lineNo, ASTBase *parent) : ASTBase(StructId, lineNo, parent) {}
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// StatementAST define code
-StatementAST::StatementAST(const LineNo& lineNo, ASTBase *parent) : ASTBase(lineNo, parent) {}
+StatementAST::StatementAST(KAstId kind, const LineNo& lineNo, ASTBase *parent) : ASTBase(kind, lineNo, parent) {}
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// ExprStmtAST define code
-ExprStmtAST::ExprStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *expr) : StatementAST(lineNo, parent) {
+ExprStmtAST::ExprStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *expr) : StatementAST(ExprStmtId, lineNo, parent) {
     Expr = expr;
 }
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// DataTypeAST define code
-DataTypeAST::DataTypeAST(const LineNo& lineNo, ASTBase *parent, KType ty) : ASTBase(lineNo, parent), DataType(ty) {}
+DataTypeAST::DataTypeAST(const LineNo& lineNo, ASTBase *parent, KType ty) : ASTBase(DataTypeId, lineNo, parent), DataType(ty) {}
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// IdDefAST define code
-IdDefAST::IdDefAST(const LineNo& lineNo, ASTBase *parent, const std::string &name) : ASTBase(lineNo, parent), Name(name){}
+IdDefAST::IdDefAST(KAstId kind, const LineNo& lineNo, ASTBase *parent, Symbol name) : ASTBase(kind, lineNo, parent), Name(name){}
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// VariableAST define code
-VariableAST::VariableAST(const LineNo& lineNo, ASTBase *parent, const std::string &name) : IdDefAST(lineNo, parent, name) {
+VariableAST::VariableAST(const LineNo& lineNo, ASTBase *parent, Symbol name) : IdDefAST(VariableId, lineNo, parent, name) {
     VarFlag = 0;
 }
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// DataDeclAST define code
-DataDeclAST::DataDeclAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(lineNo, parent) {
+DataDeclAST::DataDeclAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(DataDeclId, lineNo, parent) {
 
 }   
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// BlockStmtAST define code
-BlockStmtAST::BlockStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(lineNo, parent){
+BlockStmtAST::BlockStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(BlockStmtId, lineNo, parent){
 }
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// ReturnStmtAST define code
-ReturnStmtAST::ReturnStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(lineNo, parent){
+ReturnStmtAST::ReturnStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(ReturnStmtId, lineNo, parent){
     RetExpr = nullptr;
 }
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// BreakStmtAST define code
-BreakStmtAST::BreakStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(lineNo, parent){
+BreakStmtAST::BreakStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(BreakStmtId, lineNo, parent){
 }
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// ContinueStmtAST define code
-ContinueStmtAST::ContinueStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(lineNo, parent){
+ContinueStmtAST::ContinueStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(ContinueStmtId, lineNo, parent){
 }
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// ForStmtAST define code
-ForStmtAST::ForStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *expr1, ExprAST *expr2, ExprAST *expr3) : StatementAST(lineNo, parent) {
+ForStmtAST::ForStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *expr1, ExprAST *expr2, ExprAST *expr3) : StatementAST(ForStmtId, lineNo, parent) {
     this->Expr1 = expr1;
     this->Expr2 = expr2;
     this->Expr3 = expr3;
     this->Stmt = nullptr;
 }
 
-ForStmtAST::ForStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(lineNo, parent) {
+ForStmtAST::ForStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(ForStmtId, lineNo, parent) {
     this->Expr1 = nullptr;
     this->Expr2 = nullptr;
     this->Expr3 = nullptr;
@@ -137,7 +138,7 @@ ForStmtAST::ForStmtAST(const LineNo &lineNo, ASTBase *parent) : StatementAST(lin
 
 /// ----------------------------------------------------------
 /// WhileStmtAST define code
-WhileStmtAST::WhileStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *cond) : StatementAST(lineNo, parent) {
+WhileStmtAST::WhileStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *cond) : StatementAST(WhileStmtId, lineNo, parent) {
     this->Cond = cond;
     this->Stmt = nullptr;
 }
@@ -145,7 +146,7 @@ WhileStmtAST::WhileStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *cond)
 
 /// ----------------------------------------------------------
 /// IfStmtAST define code
-IfStmtAST::IfStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *cond) : StatementAST(lineNo, parent) {
+IfStmtAST::IfStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *cond) : StatementAST(IfStmtId, lineNo, parent) {
     this->Cond = cond;
     this->Stmt = nullptr;
     this->Else = nullptr;
@@ -154,12 +155,12 @@ IfStmtAST::IfStmtAST(const LineNo &lineNo, ASTBase *parent, ExprAST *cond) : Sta
 
 /// ----------------------------------------------------------
 /// ExprAST define code
-ExprAST::ExprAST(const LineNo &lineNo, ASTBase *parent) : ASTBase(lineNo, parent) {}
+ExprAST::ExprAST(KAstId kind, const LineNo &lineNo, ASTBase *parent) : ASTBase(kind, lineNo, parent) {}
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// BinaryExprAST define code
-BinaryExprAST::BinaryExprAST(const LineNo &lineNo, ASTBase *parent, Operator op, ExprAST *lhs, ExprAST *rhs) : ExprAST(lineNo, parent) {
+BinaryExprAST::BinaryExprAST(const LineNo &lineNo, ASTBase *parent, Operator op, ExprAST *lhs, ExprAST *rhs) : ExprAST(BinExprId, lineNo, parent) {
     this->Op = op;
     assert(lhs && "Lhs can not be null!");
     this->Lhs = lhs;
@@ -170,7 +171,7 @@ BinaryExprAST::BinaryExprAST(const LineNo &lineNo, ASTBase *parent, Operator op,
 
 /// ----------------------------------------------------------
 /// UnaryExprAST define code
-UnaryExprAST::UnaryExprAST(const LineNo &lineNo, ASTBase *parent, Operator op, ExprAST *expr) : ExprAST(lineNo, parent) {
+UnaryExprAST::UnaryExprAST(const LineNo &lineNo, ASTBase *parent, Operator op, ExprAST *expr) : ExprAST(UnaryExprId, lineNo, parent) {
     this->Op = op;
     this->Expr =  expr;
 }
@@ -178,32 +179,32 @@ UnaryExprAST::UnaryExprAST(const LineNo &lineNo, ASTBase *parent, Operator op, E
 
 /// ----------------------------------------------------------
 /// LiteralExprAST define code
-LiteralExprAST::LiteralExprAST(const LineNo &lineNo, ASTBase *parent) : ExprAST(lineNo, parent) {}
+LiteralExprAST::LiteralExprAST(const LineNo &lineNo, ASTBase *parent) : ExprAST(LiteralId, lineNo, parent) {}
 
-LiteralExprAST::LiteralExprAST(const LineNo &lineNo, ASTBase *parent, const std::string& str) : ExprAST(lineNo, parent) {
+LiteralExprAST::LiteralExprAST(const LineNo &lineNo, ASTBase *parent, const std::string& str) : ExprAST(LiteralId, lineNo, parent) {
     this->Str = str;
 }
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// NumberExprAST define code
-NumberExprAST::NumberExprAST(const LineNo &lineNo, ASTBase *parent, char v) : ExprAST(lineNo, parent) {
+NumberExprAST::NumberExprAST(const LineNo &lineNo, ASTBase *parent, char v) : ExprAST(NumberId, lineNo, parent) {
     this->CValue = v;
     this->IsChar = true;
 }
 
-NumberExprAST::NumberExprAST(const LineNo &lineNo, ASTBase *parent, long long v) : ExprAST(lineNo, parent) {
+NumberExprAST::NumberExprAST(const LineNo &lineNo, ASTBase *parent, long long v) : ExprAST(NumberId, lineNo, parent) {
     this->LValue = v;
     this->IsLong = true;
 }
 
 
-NumberExprAST::NumberExprAST(const LineNo &lineNo, ASTBase *parent, double v) : ExprAST(lineNo, parent) {
+NumberExprAST::NumberExprAST(const LineNo &lineNo, ASTBase *parent, double v) : ExprAST(NumberId, lineNo, parent) {
     this->DValue = v;
     this->IsDouble = true;
 }
 
-NumberExprAST::NumberExprAST(const LineNo &lineNo, ASTBase *parent, bool v) : ExprAST(lineNo, parent) {
+NumberExprAST::NumberExprAST(const LineNo &lineNo, ASTBase *parent, bool v) : ExprAST(NumberId, lineNo, parent) {
     this->BValue = v;
     this->IsBool = true;
 }
@@ -211,18 +212,18 @@ NumberExprAST::NumberExprAST(const LineNo &lineNo, ASTBase *parent, bool v) : Ex
 
 /// ----------------------------------------------------------
 /// IdRefAST define code
-IdRefAST::IdRefAST(const LineNo &lineNo, ASTBase *parent, const std::string& name) : ExprAST(lineNo, parent), IdName(name) {}
+IdRefAST::IdRefAST(const LineNo &lineNo, ASTBase *parent, Symbol name) : ExprAST(IdRefId, lineNo, parent), IdName(name) {}
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// IdIndexedRefAST define code
-IdIndexedRefAST::IdIndexedRefAST(const LineNo &lineNo, ASTBase *parent, const std::string& name) : ExprAST(lineNo, parent), IdName(name) {}
+IdIndexedRefAST::IdIndexedRefAST(const LineNo &lineNo, ASTBase *parent, Symbol name) : ExprAST(IdIndexedRefId, lineNo, parent), IdName(name) {}
 
 /// ----------------------------------------------------------
 
 /// ----------------------------------------------------------
 /// CallExprAST define code
-CallExprAST::CallExprAST(const LineNo &lineNo, ASTBase *parent, const std::string& name) : ExprAST(lineNo, parent), FuncName(name){
+CallExprAST::CallExprAST(const LineNo &lineNo, ASTBase *parent, Symbol name) : ExprAST(CallId, lineNo, parent), FuncName(name){
     TheCallFunction = nullptr;
     IsCallStd = false;
 }
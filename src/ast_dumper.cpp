@@ -1,31 +1,32 @@
 #include <iostream>
 #include "ast.h"
 #include "ast_dumper.h"
+#include "cast.h"
 
 namespace kale {
 
     int deepTh = 0;
     const char *astName[] = {
             "ProgramId",          /* This type express program                                        */
-            "DataDeclId",         /* This type express var define and var declare                     */
-            "VariableId",         /* This type express variable in kaleidoscope                       */
-            "IdDefId",            /* This type express id base class in kaleidoscope                  */
-            "DataTypeId",         /* This type expression data type in kaleidoscope                   */
-            "TypeRefId",          /* This type expression data ref in kaleidoscope                    */
             "FuncId",             /* This type express function define and function declare           */
             "FuncParamId",        /* This type express function param define                          */
+            "DataTypeId",         /* This type expression data type in kaleidoscope                   */
+            "TypeRefId",          /* This type expression data ref in kaleidoscope                    */
+            "IdDefId",            /* This type express id base class in kaleidoscope                  */
+            "VariableId",         /* This type express variable in kaleidoscope                       */
             "StmtId",             /* This type express base statement of statement                    */
             "ExprStmtId",         /* This type express expr statement of expr statement               */
+            "DataDeclId",         /* This type express var define and var declare                     */
             "SwitchId",           /* This type express switch statement                               */
             "IfStmtId",           /* This type express if statement                                   */
             "ForStmtId",          /* This type express for statement                                  */
             "WhileStmtId",        /* This type express while statement                                */
-            "InitializeId",       /* This type express var or struct object initialized expression    */
             "ReturnStmtId",       /* This type express return statement                               */
             "BreakStmtId",        /* This type express break statement                                */
             "BlockStmtId",        /* This type express block statement                                */
             "ContinueStmtId",     /* This type express continue statement                             */
             "ExprId",             /* This type express base expr of expression                        */
+            "InitializeId",       /* This type express var or struct object initialized expression    */
             "BinExprId",          /* This type express bin expr                                       */
             "UnaryExprId",        /* This type express unary expr                                     */
             "LiteralId",          /* This type express literal                                        */
@@ -35,8 +36,8 @@ namespace kale {
             "CallId",             /* This type express function call                                  */
             "LambdaId",           /* This type express lambda expression                              */
             "StructId"            /* This type express struct type define                             */
-
     };
+    static_assert(sizeof(astName) / sizeof(astName[0]) == LastAstId + 1, "astName is indexed by KAstId");
     const char *typeName[] = {
             "Void",
             "Double",
@@ -72,16 +73,16 @@ namespace kale {
         shortAddress = "0x" + shortAddress.substr(shortAddress.length() - 6);
         int typeIndex;
         switch (astIndex) {
-            case 2: {
-                IdDefAST *variableNode = dynamic_cast<IdDefAST *>(node);
+            case VariableId: {
+                IdDefAST *variableNode = cast<IdDefAST>(node);
                 std::cout << astName[astIndex] << " " << shortAddress << " " << "<line:" << address->Row << ", col:"
                           << address->Col << "> '"
                           << variableNode->getName() << "' "
                           << std::endl;
                 break;
             }
-            case 4: {
-                DataTypeAST *dataTypeNode = dynamic_cast<DataTypeAST *>(node);
+            case DataTypeId: {
+                DataTypeAST *dataTypeNode = cast<DataTypeAST>(node);
                 typeIndex = dataTypeNode->getDataType();
                 std::cout << astName[astIndex] << " " << shortAddress << " " << "<line:" << address->Row << ", col:"
                           << address->Col << "> '"
@@ -89,8 +90,8 @@ namespace kale {
                           << std::endl;
                 break;
             }
-            case 6: {
-                FuncAST *funcNode = dynamic_cast<FuncAST *>(node);
+            case FuncId: {
+                FuncAST *funcNode = cast<FuncAST>(node);
                 typeIndex = (funcNode->getRetType())->getDataType();
                 std::cout << astName[astIndex] << " " << shortAddress << " " << "<line:" << address->Row << ", col:"
                           << address->Col << ">"
@@ -98,8 +99,8 @@ namespace kale {
                           << std::endl;
                 break;
             }
-            case 24: {
-                IdRefAST *idRefNode = dynamic_cast<IdRefAST *>(node);
+            case IdRefId: {
+                IdRefAST *idRefNode = cast<IdRefAST>(node);
                 std::cout << astName[astIndex] << " " << shortAddress << " " << "<line:" << address->Row << ", col:"
                           << address->Col << "> '"
                           << idRefNode->getIdName() << "'"
@@ -0,0 +1,38 @@
+
+#ifdef __BENCH_ENABLE__
+
+#include "bench/bench.h"
+#include <iostream>
+#include <unordered_map>
+
+namespace kale {
+
+int runBenchmark(const std::string &name) {
+    static const std::unordered_map<std::string, int (*)()> BenchMap = {
+        {"keyword", keywordBenchmark},
+        {"nested-scope", nestedScopeBenchmark},
+        {"import-graph", importGraphBenchmark},
+        {"visitor", visitorBenchmark},
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+        {"session", sessionBenchmark},
+        {"lazy-jit", lazyJitBenchmark},
+        {"vm", vmBenchmark},
+        {"opt-level", optLevelBenchmark},
+#endif
+    };
+
+    auto it = BenchMap.find(name);
+    if(it == BenchMap.end()) {
+        std::cerr << "Unknown benchmark '" << name << "', available benchmarks:";
+        for(auto &bench : BenchMap) {
+            std::cerr << " " << bench.first;
+        }
+        std::cerr << std::endl;
+        return 1;
+    }
+    return it->second();
+}
+
+}
+
+#endif
@@ -0,0 +1,136 @@
+
+#ifdef __BENCH_ENABLE__
+
+#include "bench/bench.h"
+#include "pre_analysis.h"
+#include "ast.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace kale {
+
+/// the import check of the pre analysis before the import graph, a dfs
+/// from every program with a linear scan of the path and no visited memo,
+/// kept here as the baseline of this benchmark
+static std::vector<ProgramAST *> DagCheckStack;
+
+static bool oldDepCheck(ProgramAST *prog) {
+    for(auto *p : DagCheckStack) {
+        if(p == prog) {
+            DagCheckStack.push_back(prog);
+            return false;
+        }
+    }
+    DagCheckStack.push_back(prog);
+    for(auto *p : prog->getDependentProgs()) {
+        if(!oldDepCheck(p))
+            return false;
+    }
+    DagCheckStack.pop_back();
+    return true;
+}
+
+static bool oldDepCheck(const std::vector<ProgramAST *> &progs) {
+    for(auto *prog : progs) {
+        DagCheckStack.clear();
+        if(!oldDepCheck(prog))
+            return false;
+    }
+    return true;
+}
+
+/// build layers of width programs, each program import every program of
+/// the layer below, so the number of import paths grow as width^layers
+static std::vector<ProgramAST *> buildDiamondGraph(unsigned layers, unsigned width) {
+    std::vector<ProgramAST *> progs;
+    for(unsigned l = 0; l < layers; l++) {
+        for(unsigned w = 0; w < width; w++) {
+            auto *prog = new ProgramAST({(unsigned)progs.size(), 0, 0});
+            if(l > 0) {
+                for(unsigned d = 0; d < width; d++) {
+                    prog->addDependentProg(progs[(l - 1) * width + d]);
+                }
+            }
+            progs.push_back(prog);
+        }
+    }
+    /// the importers first, as the main program given first on the command line
+    return std::vector<ProgramAST *>(progs.rbegin(), progs.rend());
+}
+
+static void releaseGraph(const std::vector<ProgramAST *> &progs) {
+    for(auto *prog : progs) {
+        delete prog;
+    }
+}
+
+/// the order is a compile order if every import is before its importer
+static bool checkCompileOrder(const std::vector<ProgramAST *> &order) {
+    std::vector<bool> seen(order.size(), false);
+    for(auto *prog : order) {
+        for(auto *dep : prog->getDependentProgs()) {
+            if(!seen[dep->getLineNo()->FileIndex])
+                return false;
+        }
+        seen[prog->getLineNo()->FileIndex] = true;
+    }
+    return true;
+}
+
+int importGraphBenchmark() {
+    bool success = true;
+
+    /// the old check on small diamonds, each layer double its time
+    printf("import-graph benchmark: layers of 2 programs, each importing the layer below\n");
+    for(unsigned layers : {8u, 12u, 16u, 20u}) {
+        auto progs = buildDiamondGraph(layers, 2);
+        BenchTimer timer;
+        bool oldAcyclic = oldDepCheck(progs);
+        double oldMs = timer.getMs();
+        timer.reset();
+        ImportGraph graph(progs);
+        bool acyclic = graph.isAcyclic();
+        double newMs = timer.getMs();
+        success &= oldAcyclic && acyclic;
+        printf("  %5zu programs : dfs per program %10.3f ms, scc %8.3f ms\n", progs.size(), oldMs, newMs);
+        releaseGraph(progs);
+    }
+
+    /// the scc pass alone on thousands of programs, the time per import
+    /// stay flat as the graph grow
+    printf("import-graph benchmark: layers of 8 programs, each importing the layer below\n");
+    for(unsigned layers : {128u, 512u, 2048u}) {
+        auto progs = buildDiamondGraph(layers, 8);
+        size_t imports = (size_t)(layers - 1) * 8 * 8;
+        BenchTimer timer;
+        ImportGraph graph(progs);
+        auto order = graph.getCompileOrder();
+        double ms = timer.getMs();
+        success &= graph.isAcyclic() && checkCompileOrder(order);
+        printf("  %5zu programs, %6zu imports : scc %8.3f ms, %6.2f ns/import\n",
+               progs.size(), imports, ms, ms * 1e6 / imports);
+        releaseGraph(progs);
+    }
+
+    /// two programs of every layer import each other, each layer is a cycle
+    {
+        auto progs = buildDiamondGraph(1024, 4);
+        for(size_t i = 0; i + 1 < progs.size(); i += 4) {
+            progs[i]->addDependentProg(progs[i + 1]);
+            progs[i + 1]->addDependentProg(progs[i]);
+        }
+        BenchTimer timer;
+        ImportGraph graph(progs);
+        auto cycles = graph.getCycles();
+        double ms = timer.getMs();
+        success &= cycles.size() == 1024;
+        printf("  %5zu programs with %zu cycles : scc %8.3f ms\n", progs.size(), cycles.size(), ms);
+        releaseGraph(progs);
+    }
+    return success ? 0 : 1;
+}
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+
+#ifdef __BENCH_ENABLE__
+
+#include "bench/bench.h"
+#include "parser.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace kale {
+
+/// The keyword map used by the lexer before the length and first character
+/// switch, kept here as the baseline of this benchmark.
+static std::map<std::string, Token> OldKeyWordTkMap = {
+    {"def", tok_def}, {"extern", tok_extern}, {"if", tok_if}, {"for", tok_for}, {"while", tok_while},
+    {"else", tok_else}, {"then", tok_then}, {"in", tok_in}, {"return", tok_return}, {"continue", tok_continue},
+    {"break", tok_break}, {"struct", tok_struct}, {"switch", tok_switch}, {"case", tok_case}, {"default", tok_default},
+    {"true", tok_true}, {"false", tok_false}, {"void", tok_void}, {"bool", tok_bool}, {"char", tok_char}, {"uchar", tok_uchar},
+    {"short", tok_short}, {"ushort", tok_ushort}, {"int", tok_int}, {"uint", tok_uint}, {"long", tok_long},
+    {"ulong", tok_ulong}, {"float", tok_float}, {"double", tok_double}, {"import", tok_import}, {"const", tok_const}
+};
+
+static Token oldMatchKeyword(const char *id, size_t len) {
+    std::string IdStr;
+    IdStr = id[0];
+    for(size_t i = 1; i < len; i++) {
+        IdStr += id[i];
+    }
+    auto it = OldKeyWordTkMap.find(IdStr);
+    if(it == OldKeyWordTkMap.end())
+        return tok_id;
+    return OldKeyWordTkMap[IdStr];
+}
+
+/// build a identifier stream looks like source code, about one third
+/// of the words are keywords.
+static std::string buildCorpus(std::vector<std::string_view> &words) {
+    static const char *Keywords[] = {
+        "def", "int", "for", "in", "return", "if", "then", "else", "while", "long",
+        "double", "const", "extern", "import", "true", "false", "break", "continue"
+    };
+    static const char *Idents[] = {
+        "i", "sum", "index", "fibonacci", "globalArray", "a", "value", "PrintLn",
+        "counter", "result", "tmp", "matrixRow", "n", "doubleValue", "interval",
+        "defaults", "format", "ifx", "u", "shorts", "constant", "whilex", "x1", "y2"
+    };
+    const unsigned KeywordCount = sizeof(Keywords) / sizeof(Keywords[0]);
+    const unsigned IdentCount = sizeof(Idents) / sizeof(Idents[0]);
+    const unsigned WordCount = 1 << 16;
+
+    std::string corpus;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    unsigned seed = 12345;
+    for(unsigned i = 0; i < WordCount; i++) {
+        seed = seed * 1103515245 + 12345;
+        const char *word = (seed >> 16) % 3 == 0 ? Keywords[(seed >> 8) % KeywordCount]
+                                                 : Idents[(seed >> 8) % IdentCount];
+        ranges.emplace_back(corpus.size(), strlen(word));
+        corpus += word;
+        corpus += ' ';
+    }
+    for(auto &range : ranges) {
+        words.emplace_back(corpus.data() + range.first, range.second);
+    }
+    return corpus;
+}
+
+int keywordBenchmark() {
+    std::vector<std::string_view> words;
+    std::string corpus = buildCorpus(words);
+    const unsigned Rounds = 50;
+
+    /// check the two matchers agree with each other
+    for(auto word : words) {
+        if(TokenParser::matchKeyword(word) != oldMatchKeyword(word.data(), word.size())) {
+            std::cerr << "keyword matcher mismatch on '" << word << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    unsigned long long oldSum = 0, newSum = 0;
+    BenchTimer timer;
+    for(unsigned r = 0; r < Rounds; r++) {
+        for(auto word : words) {
+            oldSum += oldMatchKeyword(word.data(), word.size());
+        }
+    }
+    double oldNs = timer.getNs();
+
+    timer.reset();
+    for(unsigned r = 0; r < Rounds; r++) {
+        for(auto word : words) {
+            newSum += TokenParser::matchKeyword(word);
+        }
+    }
+    double newNs = timer.getNs();
+
+    double count = (double)words.size() * Rounds;
+    printf("keyword benchmark: %zu identifiers x %u rounds (checksum %llu/%llu)\n",
+           words.size(), Rounds, oldSum, newSum);
+    printf("  std::map + string  : %8.2f ns/ident %10.2f Mident/s\n", oldNs / count, count / oldNs * 1e3);
+    printf("  length/char switch : %8.2f ns/ident %10.2f Mident/s\n", newNs / count, count / newNs * 1e3);
+    printf("  speedup            : %8.2fx\n", oldNs / newNs);
+    return oldSum == newSum ? 0 : 1;
+}
+
+}
+
+#endif
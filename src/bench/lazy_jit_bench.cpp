@@ -0,0 +1,76 @@
+
+#ifdef __BENCH_ENABLE__
+
+#include "bench/bench.h"
+#include "compilation_session.h"
+
+#include <cstdio>
+#include <string>
+
+namespace kale {
+
+static const unsigned FuncCount = 400;
+static const unsigned CalledCount = 4;
+
+/// a large program of which only a few functions are called, function i
+/// call function i + 1 while i + 1 < CalledCount
+static std::string buildLargeSource() {
+    std::string src;
+    for(unsigned f = FuncCount; f-- > 0;) {
+        std::string name = "f" + std::to_string(f);
+        src += "def " + name + "(int n) : int {\n";
+        src += "    int i, sum;\n";
+        src += "    sum = " + std::to_string(f) + ";\n";
+        src += "    for (i = 0 ; i < n ; i = i+1) in {\n";
+        src += "        sum = sum + i * i - i * 3 + " + std::to_string(f % 7) + ";\n";
+        src += "        if (sum > 100000) then { sum = sum - 100000; }\n";
+        src += "    }\n";
+        if(f + 1 < CalledCount)
+            src += "    sum = sum + f" + std::to_string(f + 1) + "(n);\n";
+        src += "    return sum;\n}\n";
+    }
+    return src;
+}
+
+/// time from a new session to the return of the first call, ret is the
+/// value returned by the call
+static double measureStartup(const std::string &src, bool lazy, int &ret) {
+    BenchTimer timer;
+    CompilationSession session(O2, lazy);
+    if(!session.addSource("large.k", src) || !session.compile()) {
+        fprintf(stderr, "lazy-jit benchmark: %s\n", session.getErrorMessage().c_str());
+        ret = -1;
+        return 0;
+    }
+    auto *entry = session.getFunction<int(int)>("f0");
+    if(!entry) {
+        fprintf(stderr, "lazy-jit benchmark: %s\n", session.getErrorMessage().c_str());
+        ret = -1;
+        return 0;
+    }
+    ret = entry(100);
+    return timer.getMs();
+}
+
+int lazyJitBenchmark() {
+    const unsigned Rounds = 3;
+    std::string src = buildLargeSource();
+
+    int eagerRet = 0, lazyRet = 0;
+    double eagerMs = 0, lazyMs = 0;
+    for(unsigned r = 0; r < Rounds; r++) {
+        eagerMs += measureStartup(src, false, eagerRet);
+        lazyMs += measureStartup(src, true, lazyRet);
+    }
+
+    printf("lazy-jit benchmark: %u functions at O2, %u of them called (result %d/%d)\n",
+           FuncCount, CalledCount, eagerRet, lazyRet);
+    printf("  eager jit startup  : %8.2f ms\n", eagerMs / Rounds);
+    printf("  lazy jit startup   : %8.2f ms\n", lazyMs / Rounds);
+    printf("  speedup            : %8.2fx\n", eagerMs / lazyMs);
+    return eagerRet == lazyRet && eagerRet >= 0 ? 0 : 1;
+}
+
+}
+
+#endif
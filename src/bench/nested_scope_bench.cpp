@@ -0,0 +1,141 @@
+
+#ifdef __BENCH_ENABLE__
+
+#include "bench/bench.h"
+#include "parser.h"
+#include "global_variable.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace kale {
+
+static const unsigned NestDepth = 256;
+static const unsigned FuncCount = 32;
+
+/// generate functions with deeply nested blocks, each block define one
+/// variable and read the variables of the outermost, the middle and the
+/// parent scope, so most lookups have to cross many scopes.
+static std::string buildNestedSource() {
+    std::string src = "int g;\n";
+    for(unsigned f = 0; f < FuncCount; f++) {
+        src += "def f" + std::to_string(f) + "() : int {\n";
+        src += "int v0;\nv0 = g;\n";
+        for(unsigned d = 1; d < NestDepth; d++) {
+            std::string cur = "v" + std::to_string(d);
+            src += "{\nint " + cur + ";\n";
+            src += cur + " = v0 + v" + std::to_string(d / 2) + " + v" + std::to_string(d - 1) + " + g;\n";
+        }
+        for(unsigned d = 1; d < NestDepth; d++) {
+            src += "}\n";
+        }
+        src += "return v0;\n}\n";
+    }
+    src += "def main() : int {\nreturn f0();\n}\n";
+    return src;
+}
+
+/// The local symbol table used by GrammarParser before the flat table,
+/// one hash map per scope searched from the innermost one, kept here as
+/// the baseline of this benchmark.
+class OldSymTab {
+private:
+    std::vector<std::unordered_map<Symbol, VariableAST *>> SymTabMap;
+public:
+    void enterScope() { SymTabMap.push_back({}); }
+    void leaveScope() { SymTabMap.pop_back(); }
+    bool insert(Symbol name, VariableAST *var) {
+        if(SymTabMap.back().find(name) != SymTabMap.back().end())
+            return false;
+        SymTabMap.back().insert({name, var});
+        return true;
+    }
+    VariableAST *lookup(Symbol name) {
+        for(auto it = SymTabMap.rbegin(); it != SymTabMap.rend(); it++) {
+            auto found = it->find(name);
+            if(found != it->end())
+                return found->second;
+        }
+        return nullptr;
+    }
+};
+
+/// replay the scope operations of the generated source on a table
+template<class Table>
+static unsigned long long replayScopes(Table &table, const std::vector<Symbol> &names, Symbol global) {
+    unsigned long long found = 0;
+    for(unsigned f = 0; f < FuncCount; f++) {
+        table.enterScope();
+        table.insert(names[0], reinterpret_cast<VariableAST *>(names[0].getId() + 1ULL));
+        for(unsigned d = 1; d < NestDepth; d++) {
+            table.enterScope();
+            table.insert(names[d], reinterpret_cast<VariableAST *>(names[d].getId() + 1ULL));
+            found += table.lookup(names[0]) != nullptr;
+            found += table.lookup(names[d / 2]) != nullptr;
+            found += table.lookup(names[d - 1]) != nullptr;
+            found += table.lookup(global) != nullptr;
+        }
+        for(unsigned d = 0; d < NestDepth; d++) {
+            table.leaveScope();
+        }
+    }
+    return found;
+}
+
+int nestedScopeBenchmark() {
+    const unsigned Rounds = 20;
+    std::vector<Symbol> names;
+    for(unsigned d = 0; d < NestDepth; d++) {
+        names.push_back(Symbol::intern("v" + std::to_string(d)));
+    }
+    Symbol global = Symbol::intern("g");
+
+    unsigned long long oldFound = 0, newFound = 0;
+    BenchTimer timer;
+    for(unsigned r = 0; r < Rounds; r++) {
+        OldSymTab table;
+        oldFound += replayScopes(table, names, global);
+    }
+    double oldNs = timer.getNs();
+
+    timer.reset();
+    for(unsigned r = 0; r < Rounds; r++) {
+        ScopedSymbolTable table;
+        newFound += replayScopes(table, names, global);
+    }
+    double newNs = timer.getNs();
+
+    /// parse the generated source end to end
+    std::string fileName = "nested_scope_bench.k";
+    std::string src = buildNestedSource();
+    {
+        std::ofstream out(fileName);
+        out << src;
+    }
+    InputFileList.push_back(fileName);
+    auto *prog = new ProgramAST({(unsigned)InputFileList.size() - 1, 0, 0});
+    prog->setProgram(prog);
+
+    timer.reset();
+    GrammarParser::getOrCreateGrammarParserByProg(prog)->generateSrcToAst();
+    double parseMs = timer.getMs();
+    std::remove(fileName.c_str());
+
+    double ops = (double)Rounds * FuncCount * NestDepth;
+    printf("nested-scope benchmark: %u functions x %u nested blocks (found %llu/%llu)\n",
+           FuncCount, NestDepth, oldFound, newFound);
+    printf("  map per scope      : %8.2f ns/block\n", oldNs / ops);
+    printf("  flat scoped table  : %8.2f ns/block\n", newNs / ops);
+    printf("  speedup            : %8.2fx\n", oldNs / newNs);
+    printf("  parse source       : %8.2f ms (%zu bytes, arena %zu bytes)\n",
+           parseMs, src.size(), prog->getArena().getBytesAllocated());
+    return oldFound == newFound ? 0 : 1;
+}
+
+}
+
+#endif
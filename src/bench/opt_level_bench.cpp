@@ -0,0 +1,96 @@
+
+#ifdef __BENCH_ENABLE__
+
+#include "bench/bench.h"
+#include "global_variable.h"
+
+#include <cstdio>
+#include <climits>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace kale {
+
+static const unsigned Rounds = 5;
+static const unsigned LevelCount = 4;
+
+/// run the command and wait it, the output is dropped if quiet, return
+/// the exit code, -1 if it is not exited normally
+static int runCommand(const std::vector<std::string> &args, bool quiet) {
+    pid_t pid = fork();
+    if(pid == 0) {
+        if(quiet) {
+            int fd = open("/dev/null", O_WRONLY);
+            dup2(fd, STDOUT_FILENO);
+            close(fd);
+        }
+        std::vector<char *> argv;
+        for(auto &arg : args) {
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    if(pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+/// the runtime of the executables built at O0 to O3 from the programs
+/// given by -i, each is built once by this kalecc and only its run is timed
+int optLevelBenchmark() {
+    if(InputFileList.empty()) {
+        fprintf(stderr, "opt level benchmark: no program is given by -i\n");
+        return 1;
+    }
+    char self[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if(len <= 0) {
+        fprintf(stderr, "opt level benchmark: could not find kalecc\n");
+        return 1;
+    }
+    self[len] = '\0';
+
+    printf("opt level benchmark: run time of the executable, %u rounds\n", Rounds);
+    printf("  %-16s %10s %10s %10s %10s %8s\n", "program", "O0 ms", "O1 ms", "O2 ms", "O3 ms", "speedup");
+    for(auto &file : InputFileList) {
+        std::string name = file.substr(file.find_last_of('/') + 1);
+        name = name.substr(0, name.find('.'));
+
+        double ms[LevelCount];
+        int expected = 0;
+        for(unsigned level = 0; level < LevelCount; level++) {
+            std::string exe = "./opt_level_" + name + "_O" + std::to_string(level);
+            if(runCommand({self, "-i", file, "-O", std::to_string(level), "-o", exe}, false)) {
+                fprintf(stderr, "opt level benchmark: could not build %s at O%u\n", file.c_str(), level);
+                return 1;
+            }
+            /// every level must exit as O0
+            BenchTimer timer;
+            for(unsigned r = 0; r < Rounds; r++) {
+                int ret = runCommand({exe}, true);
+                if(level == 0 && r == 0)
+                    expected = ret;
+                if(ret < 0 || ret != expected) {
+                    fprintf(stderr, "opt level benchmark: %s exit with %d at O%u but %d at O0\n",
+                            name.c_str(), ret, level, expected);
+                    std::remove(exe.c_str());
+                    return 1;
+                }
+            }
+            ms[level] = timer.getMs() / Rounds;
+            std::remove(exe.c_str());
+        }
+        printf("  %-16s %10.3f %10.3f %10.3f %10.3f %7.2fx\n", name.c_str(), ms[0], ms[1], ms[2], ms[3], ms[0] / ms[3]);
+    }
+    return 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+
+#ifdef __BENCH_ENABLE__
+
+#include "bench/bench.h"
+#include "compilation_session.h"
+
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+namespace kale {
+
+static const unsigned SessionsPerThread = 8;
+static const unsigned ThreadCount = 4;
+static const int      KernelSize = 1000;
+
+static const char *LibSource =
+    "def square(double x) : double {\n"
+    "    return x * x;\n"
+    "}\n";
+
+/// each session scale the kernel by its own factor, so a function got from
+/// the wrong session give a wrong result
+static std::string buildKernelSource(unsigned factor) {
+    return "import \"lib.k\";\n"
+           "def kernel(int n) : double {\n"
+           "    int i;\n"
+           "    double x, sum;\n"
+           "    sum = 0.0;\n"
+           "    x = 0.0;\n"
+           "    for (i = 0 ; i < n ; i = i+1) in {\n"
+           "        sum = sum + square(x) * " + std::to_string(factor) + ".0;\n"
+           "        x = x + 1.0;\n"
+           "    }\n"
+           "    return sum;\n"
+           "}\n";
+}
+
+static double expectKernel(unsigned factor) {
+    double sum = 0.0;
+    for(int i = 0; i < KernelSize; i++) {
+        sum += (double)i * i * factor;
+    }
+    return sum;
+}
+
+/// compile one session and check its kernel, return false if failed
+static bool runSession(unsigned factor) {
+    CompilationSession session(O2);
+    if(!session.addSource("lib.k", LibSource) ||
+       !session.addSource("kernel.k", buildKernelSource(factor)) ||
+       !session.compile()) {
+        fprintf(stderr, "session %u failed: %s\n", factor, session.getErrorMessage().c_str());
+        return false;
+    }
+    auto *kernel = session.getFunction<double(int)>("kernel");
+    if(!kernel) {
+        fprintf(stderr, "session %u failed: %s\n", factor, session.getErrorMessage().c_str());
+        return false;
+    }
+    return std::fabs(kernel(KernelSize) - expectKernel(factor)) < 1e-6;
+}
+
+/// a source with an error must fail to compile with the error in the
+/// message, and the session must still compile the fixed source after
+static bool checkBadSource(const char *src, const char *error) {
+    CompilationSession session(O0);
+    if(!session.addSource("lib.k", LibSource) || !session.compile()) {
+        fprintf(stderr, "bad source: lib.k failed: %s\n", session.getErrorMessage().c_str());
+        return false;
+    }
+    if(!session.addSource("bad.k", src) || session.compile() ||
+       session.getErrorMessage().find(error) == std::string::npos) {
+        fprintf(stderr, "bad source: expect '%s' but got '%s'\n", error, session.getErrorMessage().c_str());
+        return false;
+    }
+    if(!session.addSource("kernel.k", buildKernelSource(1)) || !session.compile()) {
+        fprintf(stderr, "bad source: the fixed source failed: %s\n", session.getErrorMessage().c_str());
+        return false;
+    }
+    auto *kernel = session.getFunction<double(int)>("kernel");
+    return kernel && std::fabs(kernel(KernelSize) - expectKernel(1)) < 1e-6;
+}
+
+int sessionBenchmark() {
+    std::atomic<unsigned> failed{0};
+
+    failed += !checkBadSource("def bad() : int {\n"
+                              "    int a;\n"
+                              "    a = ;\n"
+                              "    return a;\n"
+                              "}\n", "bad.k:2-8 error literal");
+    failed += !checkBadSource("def bad() : int {\n"
+                              "    return PrintLn(\"x\") + 1;\n"
+                              "}\n", "can't be an operand");
+
+    BenchTimer timer;
+    for(unsigned i = 0; i < SessionsPerThread; i++) {
+        failed += !runSession(i + 1);
+    }
+    double serialMs = timer.getMs();
+
+    timer.reset();
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < ThreadCount; t++) {
+        threads.emplace_back([t, &failed] {
+            for(unsigned i = 0; i < SessionsPerThread; i++) {
+                failed += !runSession(t * SessionsPerThread + i + 1);
+            }
+        });
+    }
+    for(auto &thread : threads) {
+        thread.join();
+    }
+    double concurrentMs = timer.getMs();
+
+    unsigned sessions = ThreadCount * SessionsPerThread;
+    printf("session benchmark: compile two sources and call the kernel per session (failed %u)\n", failed.load());
+    printf("  1 thread           : %8.2f ms/session\n", serialMs / SessionsPerThread);
+    printf("  %u threads          : %8.2f ms/session (%u sessions)\n", ThreadCount, concurrentMs / sessions, sessions);
+    return failed ? 1 : 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+
+#ifdef __BENCH_ENABLE__
+
+#include "bench/bench.h"
+#include "parser.h"
+#include "ast_visitor.h"
+#include "static_visitor.h"
+#include "type_checker.h"
+#include "global_variable.h"
+
+#include <fstream>
+#include <cstdio>
+#include <string>
+
+namespace kale {
+
+static const unsigned FuncCount = 64;
+static const unsigned StmtCount = 1300;
+
+/// generate functions of long expr statements, each statement is 12 nodes,
+/// so the ast has about one million nodes
+static std::string buildVisitorSource() {
+    std::string src = "int g;\n";
+    for(unsigned f = 0; f < FuncCount; f++) {
+        src += "def f" + std::to_string(f) + "() : int {\nint v;\nv = g;\n";
+        for(unsigned s = 0; s < StmtCount; s++) {
+            src += "v = v * " + std::to_string(s % 7 + 1) + " + g - 7 * v;\n";
+        }
+        src += "return v;\n}\n";
+    }
+    src += "def main() : int {\nreturn f0();\n}\n";
+    return src;
+}
+
+/// count the nodes by the virtual accept, visit and actions of AstVisitor
+class VirtualCounter : public AstVisitor {
+public:
+    unsigned long long Count{0};
+    void preAction(ASTBase *) override { Count++; }
+};
+
+/// count the nodes by the static visitor
+class StaticCounter : public StaticAstVisitor<StaticCounter> {
+public:
+    unsigned long long Count{0};
+    void preAction(ASTBase *) { Count++; }
+};
+
+int visitorBenchmark() {
+    const unsigned Rounds = 20;
+
+    std::string fileName = "visitor_bench.k";
+    std::string src = buildVisitorSource();
+    {
+        std::ofstream out(fileName);
+        out << src;
+    }
+    InputFileList.push_back(fileName);
+    auto *prog = new ProgramAST({(unsigned)InputFileList.size() - 1, 0, 0});
+    prog->setProgram(prog);
+    GrammarParser::getOrCreateGrammarParserByProg(prog)->generateSrcToAst();
+    std::remove(fileName.c_str());
+
+    unsigned long long virtualCount = 0, staticCount = 0;
+    BenchTimer timer;
+    for(unsigned r = 0; r < Rounds; r++) {
+        VirtualCounter counter;
+        prog->accept(counter);
+        virtualCount = counter.Count;
+    }
+    double virtualNs = timer.getNs();
+
+    timer.reset();
+    for(unsigned r = 0; r < Rounds; r++) {
+        StaticCounter counter;
+        counter.traverse(prog);
+        staticCount = counter.Count;
+    }
+    double staticNs = timer.getNs();
+
+    /// the type checker set the same types each round
+    timer.reset();
+    for(unsigned r = 0; r < Rounds; r++) {
+        TypeChecker checker;
+        checker.traverse(prog);
+    }
+    double checkNs = timer.getNs();
+
+    double nodes = (double)Rounds * staticCount;
+    printf("visitor benchmark: %llu nodes x %u rounds (virtual %llu)\n",
+           staticCount, Rounds, virtualCount);
+    printf("  virtual visitor    : %8.2f ns/node\n", virtualNs / nodes);
+    printf("  static visitor     : %8.2f ns/node\n", staticNs / nodes);
+    printf("  speedup            : %8.2fx\n", virtualNs / staticNs);
+    printf("  type checker       : %8.2f ns/node\n", checkNs / nodes);
+    return virtualCount == staticCount ? 0 : 1;
+}
+
+}
+
+#endif
@@ -0,0 +1,135 @@
+
+#ifdef __BENCH_ENABLE__
+
+#include "bench/bench.h"
+#include "global_variable.h"
+#include "compilation_session.h"
+#include "parser.h"
+#include "type_checker.h"
+#include "vm_builder.h"
+#include "vm.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace kale {
+
+static const unsigned Rounds = 5;
+
+/// the output of the programs is dropped while they are timed
+class StdoutSilencer {
+private:
+    int Saved;
+public:
+    StdoutSilencer() {
+        fflush(stdout);
+        Saved = dup(STDOUT_FILENO);
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    }
+    ~StdoutSilencer() {
+        fflush(stdout);
+        dup2(Saved, STDOUT_FILENO);
+        close(Saved);
+    }
+};
+
+/// parse, build and run src in the vm, return false if failed
+static bool runByVM(const std::string &name, const std::string &src, int &ret) {
+    auto *prog = new ProgramAST({0, 0, 0});
+    prog->setProgram(prog);
+    auto *parser = GrammarParser::createGrammarParserBySource(prog, src, name);
+    parser->generateSrcToAst();
+    bool success = !parser->getErrorCount();
+    if(success) {
+        TypeChecker checker;
+        checker.traverse(prog);
+        if(checker.hasError()) {
+            fprintf(stderr, "vm benchmark: %s:%s\n", name.c_str(), checker.getErrorMessage().c_str());
+            success = false;
+        }
+    }
+    if(success) {
+        VMModule module;
+        KaleVMBuilder builder(module);
+        KaleVM vm(module);
+        success = builder.buildProgram(prog) && vm.runMain(ret);
+        if(!success)
+            fprintf(stderr, "vm benchmark: %s: %s\n", name.c_str(),
+                    builder.getErrorMessage().empty() ? vm.getErrorMessage().c_str() : builder.getErrorMessage().c_str());
+    }
+    GrammarParser::releaseGrammarParserByProg(prog);
+    prog->releaseAst();
+    delete prog;
+    return success;
+}
+
+/// compile src at O0 in a session and call its main, return false if failed
+static bool runByJIT(const std::string &name, const std::string &src, int &ret) {
+    CompilationSession session(O0);
+    if(!session.addSource(name, src) || !session.compile()) {
+        fprintf(stderr, "vm benchmark: %s: %s\n", name.c_str(), session.getErrorMessage().c_str());
+        return false;
+    }
+    auto *mainFunc = session.getFunction<int()>("main");
+    if(!mainFunc) {
+        fprintf(stderr, "vm benchmark: %s: %s\n", name.c_str(), session.getErrorMessage().c_str());
+        return false;
+    }
+    ret = mainFunc();
+    return true;
+}
+
+/// time from the source to the return of main by the vm and by the jit,
+/// on the programs given by -i
+int vmBenchmark() {
+    if(InputFileList.empty()) {
+        fprintf(stderr, "vm benchmark: no program is given by -i\n");
+        return 1;
+    }
+
+    printf("vm benchmark: source to exit of main, %u rounds, jit at O0\n", Rounds);
+    printf("  %-24s %10s %10s %8s\n", "program", "vm ms", "jit ms", "speedup");
+    bool success = true;
+    for(auto &file : InputFileList) {
+        std::ifstream in(file);
+        if(!in) {
+            fprintf(stderr, "vm benchmark: could not open %s\n", file.c_str());
+            return 1;
+        }
+        std::stringstream ss;
+        ss << in.rdbuf();
+        std::string src = ss.str();
+        std::string name = file.substr(file.find_last_of('/') + 1);
+
+        int vmRet = 0, jitRet = 0;
+        double vmMs = 0, jitMs = 0;
+        for(unsigned r = 0; r < Rounds && success; r++) {
+            StdoutSilencer silencer;
+            BenchTimer timer;
+            success = runByVM(name, src, vmRet);
+            vmMs += timer.getMs();
+            timer.reset();
+            success = success && runByJIT(name, src, jitRet);
+            jitMs += timer.getMs();
+        }
+        if(!success)
+            return 1;
+        if(vmRet != jitRet) {
+            fprintf(stderr, "vm benchmark: %s: main return %d in the vm but %d in the jit\n",
+                    name.c_str(), vmRet, jitRet);
+            return 1;
+        }
+        printf("  %-24s %10.3f %10.3f %7.2fx\n", name.c_str(), vmMs / Rounds, jitMs / Rounds, jitMs / vmMs);
+    }
+    return 0;
+}
+
+}
+
+#endif
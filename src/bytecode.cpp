@@ -0,0 +1,76 @@
+#include "bytecode.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace kale {
+
+const char *getOpcodeName(VMOpcode op) {
+    static const char *Names[] = {
+#define KALE_VM_OPCODE_NAME(op) #op,
+        KALE_VM_OPCODES(KALE_VM_OPCODE_NAME)
+#undef KALE_VM_OPCODE_NAME
+    };
+    return op < OpCount ? Names[op] : "<unknown>";
+}
+
+/// ----------------------------------------------------------
+/// VMModule code
+unsigned VMModule::getFunctionSlot(const std::string &name) {
+    auto it = FunctionSlots.find(name);
+    if(it != FunctionSlots.end())
+        return it->second;
+    unsigned slot = Functions.size();
+    Functions.emplace_back();
+    Functions.back().Name = name;
+    FunctionSlots[name] = slot;
+    return slot;
+}
+
+unsigned VMModule::getGlobalSlot(const std::string &name, unsigned size) {
+    auto it = GlobalSlots.find(name);
+    if(it != GlobalSlots.end())
+        return it->second;
+    unsigned slot = GlobalVars.size();
+    GlobalVars.push_back({GlobalCount, size});
+    GlobalCount += size;
+    GlobalSlots[name] = slot;
+    return slot;
+}
+
+unsigned VMModule::addConstant(VMValue v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    auto it = ConstantSlots.find(bits);
+    if(it != ConstantSlots.end())
+        return it->second;
+    Constants.push_back(v);
+    ConstantSlots[bits] = Constants.size() - 1;
+    return Constants.size() - 1;
+}
+
+const char *VMModule::addString(const std::string &str) {
+    Strings.push_back(str);
+    return Strings.back().c_str();
+}
+
+void VMModule::dump(std::string &out) const {
+    for(auto &func : Functions) {
+        if(!func.Defined)
+            continue;
+        out += func.Name + ": params " + std::to_string(func.ParamCount) +
+               ", registers " + std::to_string(func.RegisterCount) +
+               ", frame " + std::to_string(func.FrameSize) + "\n";
+        for(unsigned pc = 0; pc < func.Code.size(); pc++) {
+            const VMInst &inst = func.Code[pc];
+            char line[128];
+            std::snprintf(line, sizeof(line), "  %4u  %-8s a=%u b=%u c=%u imm=%d aux=%u\n",
+                          pc, getOpcodeName((VMOpcode)inst.Op), inst.A, inst.B, inst.C,
+                          (int)inst.Imm, inst.Aux);
+            out += line;
+        }
+    }
+}
+/// ----------------------------------------------------------
+
+}
@@ -0,0 +1,178 @@
+
+#include "compilation_session.h"
+#include "pre_analysis.h"
+#include "parser.h"
+#include "type_checker.h"
+#include "const_folder.h"
+#include "ir_builder.h"
+#include "jit_runner.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// @brief Code implication of class CompilationSession
+/// -----------------------------------------------------
+CompilationSession::CompilationSession(KaleOptLevel level, bool lazy) : Level(level), Lazy(lazy) {
+    Context = std::make_unique<llvm::orc::ThreadSafeContext>(std::make_unique<llvm::LLVMContext>());
+}
+
+CompilationSession::~CompilationSession() {
+    /// the jit hold the compiled modules, the builders and programs are
+    /// released before the context they refer to
+    JIT.reset();
+    for(auto &src : Sources) {
+        releaseSource(src);
+    }
+    Sources.clear();
+    Context.reset();
+}
+
+bool CompilationSession::setError(const std::string &msg) {
+    ErrorMsg = msg;
+    return false;
+}
+
+void CompilationSession::releaseSource(Source &src) {
+    KaleIRBuilder::releaseIrBuilderByProg(src.Prog);
+    GrammarParser::releaseGrammarParserByProg(src.Prog);
+    src.Prog->releaseAst();
+    delete src.Prog;
+    src.Prog = nullptr;
+}
+
+void CompilationSession::dropPendingSources() {
+    for(unsigned i = CompiledCount; i < Sources.size(); i++) {
+        ProgByName.erase(Sources[i].Name);
+        releaseSource(Sources[i]);
+    }
+    Sources.resize(CompiledCount);
+}
+
+bool CompilationSession::addSource(const std::string &name, std::string_view source) {
+    std::lock_guard<std::mutex> guard(Lock);
+    if(ProgByName.find(name) != ProgByName.end())
+        return setError("source '" + name + "' is already added");
+
+    std::vector<ProgramAST *> deps;
+    for(auto &file : scanImportFileNames(source)) {
+        auto it = ProgByName.find(file);
+        if(it == ProgByName.end())
+            return setError("source '" + name + "' import unknown source '" + file + "'");
+        deps.push_back(it->second);
+    }
+
+    auto *prog = new ProgramAST({(unsigned)Sources.size(), 0, 0});
+    prog->setProgram(prog);
+    for(auto *dep : deps) {
+        prog->addDependentProg(dep);
+    }
+    Sources.push_back({name, std::string(source), prog});
+    ProgByName.insert({name, prog});
+    return true;
+}
+
+bool CompilationSession::compile() {
+    std::lock_guard<std::mutex> guard(Lock);
+    ErrorMsg.clear();
+
+    if(!JIT && Lazy) {
+        auto J = KaleJITRunner::createLazyJIT(Level);
+        if(!J)
+            return setError(llvm::toString(J.takeError()));
+        JIT = std::move(*J);
+    }
+    else if(!JIT) {
+        auto J = KaleJITRunner::createJIT(Level);
+        if(!J)
+            return setError(llvm::toString(J.takeError()));
+        JIT = std::move(*J);
+    }
+
+    /// the jit may be compiling the modules of this context on another
+    /// thread for a lookup, hold the context while generating ir
+    auto ctxLock = Context->getLock();
+    llvm::LLVMContext &ctx = *Context->getContext();
+    KaleIRBuilder::initContextSupport(ctx);
+
+    /// a source is added after the sources it import, so the order of
+    /// Sources is the order to compile them
+    for(unsigned i = CompiledCount; i < Sources.size(); i++) {
+        auto &src = Sources[i];
+        auto *parser = GrammarParser::createGrammarParserBySource(src.Prog, src.Text, src.Name);
+        parser->generateSrcToAst();
+        if(parser->getErrorCount()) {
+            std::string msg = "source '" + src.Name + "' has " + std::to_string(parser->getErrorCount()) + " error(s)";
+            for(auto &error : parser->getErrorMessages()) {
+                msg += "\n" + error;
+            }
+            setError(msg);
+            dropPendingSources();
+            return false;
+        }
+    }
+
+    for(unsigned i = CompiledCount; i < Sources.size(); i++) {
+        auto &src = Sources[i];
+        TypeChecker checker;
+        checker.traverse(src.Prog);
+        if(checker.hasError()) {
+            setError("source '" + src.Name + "' has a type error\n" + src.Name + ":" + checker.getErrorMessage());
+            dropPendingSources();
+            return false;
+        }
+        KaleConstFolder folder;
+        src.Prog->accept(folder);
+
+        auto *builder = KaleIRBuilder::getOrCreateIrBuilderByProg(src.Prog, ctx);
+        src.Prog->accept(*builder);
+        std::string verifyMsg;
+        llvm::raw_string_ostream os(verifyMsg);
+        if(llvm::verifyModule(*builder->getLLVMModule(), &os)) {
+            setError("source '" + src.Name + "' generate invalid ir: " + os.str());
+            dropPendingSources();
+            return false;
+        }
+    }
+
+    for(unsigned i = CompiledCount; i < Sources.size(); i++) {
+        auto &src = Sources[i];
+        auto module = KaleIRBuilder::getOrCreateIrBuilderByProg(src.Prog, ctx)->takeLLVMModule();
+        llvm::Error err = KaleJITRunner::addModule(*JIT, llvm::orc::ThreadSafeModule(std::move(module), *Context),
+                                                   Level, Lazy);
+        if(err) {
+            setError(llvm::toString(std::move(err)));
+            dropPendingSources();
+            return false;
+        }
+        src.Prog->setCompiledFlag(ProgramAST::CompiledFlag::Success);
+        CompiledCount = i + 1;
+    }
+    return true;
+}
+
+void *CompilationSession::getFunctionAddress(const std::string &name) {
+    std::lock_guard<std::mutex> guard(Lock);
+    if(!JIT) {
+        setError("nothing is compiled");
+        return nullptr;
+    }
+    auto sym = JIT->lookup(name);
+    if(!sym) {
+        setError(llvm::toString(sym.takeError()));
+        return nullptr;
+    }
+#if LLVM_VERSION_MAJOR >= 15
+    return sym->toPtr<void *>();
+#else
+    return reinterpret_cast<void *>(sym->getAddress());
+#endif
+}
+/// -----------------------------------------------------
+
+}
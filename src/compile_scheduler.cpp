@@ -0,0 +1,103 @@
+
+#include "compile_scheduler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <cassert>
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// @brief Code implication of class CompileScheduler
+/// -----------------------------------------------------
+CompileScheduler::CompileScheduler(unsigned threadCount) : ThreadCount(threadCount ? threadCount : 1) {
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+    for(unsigned i = 0; i < ThreadCount; i++) {
+        WorkerContexts.push_back(std::make_unique<llvm::LLVMContext>());
+    }
+#endif
+}
+
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+llvm::LLVMContext &CompileScheduler::getWorkerContext(unsigned worker) {
+    assert(worker < ThreadCount && WorkerContexts[worker] && "worker out of range");
+    return *WorkerContexts[worker];
+}
+
+std::unique_ptr<llvm::LLVMContext> CompileScheduler::takeWorkerContext(unsigned worker) {
+    assert(worker < ThreadCount && "worker out of range");
+    return std::move(WorkerContexts[worker]);
+}
+#endif
+
+void CompileScheduler::runOnPrograms(const std::vector<ProgramAST *> &progs, const Task &task, bool followDeps) {
+    /// count the unfinished imports of each program, and record who import it
+    std::unordered_map<ProgramAST *, unsigned> pending;
+    std::unordered_map<ProgramAST *, std::vector<ProgramAST *>> importers;
+    for(auto *prog : progs) {
+        pending[prog] = 0;
+    }
+    if(followDeps) {
+        for(auto *prog : progs) {
+            for(auto *dep : prog->getDependentProgs()) {
+                if(pending.find(dep) == pending.end())
+                    continue;
+                pending[prog]++;
+                importers[dep].push_back(prog);
+            }
+        }
+    }
+
+    std::deque<ProgramAST *> ready;
+    for(auto *prog : progs) {
+        if(pending[prog] == 0)
+            ready.push_back(prog);
+    }
+
+    std::mutex lock;
+    std::condition_variable cond;
+    size_t finished = 0;
+
+    /// the import graph is checked to be a DAG by the pre analysis, so all
+    /// programs will become ready in the end
+    auto work = [&](unsigned worker) {
+        std::unique_lock<std::mutex> guard(lock);
+        while(true) {
+            cond.wait(guard, [&] { return !ready.empty() || finished == progs.size(); });
+            if(ready.empty())
+                return;
+            ProgramAST *prog = ready.front();
+            ready.pop_front();
+
+            guard.unlock();
+            task(prog, worker);
+            guard.lock();
+
+            finished++;
+            for(auto *importer : importers[prog]) {
+                if(--pending[importer] == 0)
+                    ready.push_back(importer);
+            }
+            cond.notify_all();
+        }
+    };
+
+    if(ThreadCount == 1 || progs.size() <= 1) {
+        work(0);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    for(unsigned i = 0; i < ThreadCount; i++) {
+        workers.emplace_back(work, i);
+    }
+    for(auto &worker : workers) {
+        worker.join();
+    }
+}
+/// -----------------------------------------------------
+
+}
@@ -0,0 +1,555 @@
+#include "compile_server.h"
+#include "global_variable.h"
+#include "pre_analysis.h"
+#include "parser.h"
+#include "type_checker.h"
+#include "const_folder.h"
+
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+#include "jit_runner.h"
+#endif
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+extern char **environ;
+
+namespace kale {
+
+/// ----------------------------------------------------------------
+/// the request sent by the client, followed by the payload: the working
+/// directory, the args and the environment, each ended by '\0'. The
+/// standard streams of the client are passed with the header.
+struct RequestHeader {
+    uint32_t Magic;
+    uint32_t ArgCount;
+    uint32_t EnvCount;
+    uint32_t PayloadSize;
+};
+
+static const uint32_t RequestMagic = 0x4b414c45;    // "KALE"
+/// more than the args and environment linux let a command have
+static const uint32_t MaxPayloadSize = 4u << 20;
+static const unsigned MaxCachedPrograms = 256;
+
+/// the file a program is parsed from, it is reused while they are the same
+struct FileStamp {
+    std::string Path;
+    struct timespec MTime;
+    off_t Size;
+};
+
+/// a program parsed, type checked and folded by the server
+struct CachedProgram {
+    ProgramAST                *Prog;
+    FileStamp                  Stamp;
+    std::vector<ProgramAST *>  Deps;        // the programs its imports are resolved to
+    unsigned long              LastUse;
+};
+
+/// the programs for the inputs of a request
+struct PreparsedPrograms {
+    std::vector<std::string>   Inputs;      // the absolute inputs of the command line
+    std::vector<std::string>   Files;       // InputFileList, the inputs and the files they import
+    std::vector<ProgramAST *>  Programs;    // ProgramList
+};
+
+/// the index of the file in InputFileList is in the line info of every node,
+/// so a program is cached by its file and that index. It is reused by the
+/// requests reading the file unchanged with the same programs for its imports
+static std::map<std::pair<std::string, unsigned>, CachedProgram> Cache;
+static unsigned long RequestCount = 0;
+
+/// the programs and working directory of the request run by this process
+static PreparsedPrograms Request;
+static PreparsedPrograms *RequestPrograms = nullptr;
+static std::string RequestDir;
+/// ----------------------------------------------------------------
+
+
+/// ----------------------------------------------------------------
+static std::string makeAbsolute(const std::string &dir, const std::string &path) {
+    if(path.empty() || path[0] == '/')
+        return path;
+    return dir + "/" + path;
+}
+
+static bool getStamp(const std::string &path, FileStamp &stamp) {
+    struct stat st;
+    if(stat(path.c_str(), &st))
+        return false;
+    stamp.Path = path;
+    stamp.MTime = st.st_mtim;
+    stamp.Size = st.st_size;
+    return true;
+}
+
+static bool isSameStamp(const FileStamp &a, const FileStamp &b) {
+    return a.Size == b.Size && a.MTime.tv_sec == b.MTime.tv_sec && a.MTime.tv_nsec == b.MTime.tv_nsec;
+}
+
+static bool readFull(int fd, void *buf, size_t size) {
+    char *p = (char *)buf;
+    while(size) {
+        ssize_t n = read(fd, p, size);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool writeFull(int fd, const void *buf, size_t size) {
+    const char *p = (const char *)buf;
+    while(size) {
+        ssize_t n = write(fd, p, size);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void releaseProgram(ProgramAST *prog) {
+    GrammarParser::releaseGrammarParserByProg(prog);
+    prog->releaseAst();
+    delete prog;
+}
+
+/// release a program dropped from the cache and the cached programs
+/// importing it, their ast refer to its nodes
+static void evictProgram(ProgramAST *prog) {
+    std::vector<ProgramAST *> dropped = {prog};
+    for(size_t i = 0; i < dropped.size(); i++) {
+        for(auto it = Cache.begin(); it != Cache.end();) {
+            auto &deps = it->second.Deps;
+            if(std::find(deps.begin(), deps.end(), dropped[i]) != deps.end()) {
+                dropped.push_back(it->second.Prog);
+                it = Cache.erase(it);
+            }
+            else {
+                it++;
+            }
+        }
+    }
+    for(auto *p : dropped) {
+        releaseProgram(p);
+    }
+}
+
+/// drop the least recently used programs not used by this request
+static void trimCache() {
+    while(Cache.size() > MaxCachedPrograms) {
+        auto oldest = Cache.begin();
+        for(auto it = Cache.begin(); it != Cache.end(); it++) {
+            if(it->second.LastUse < oldest->second.LastUse)
+                oldest = it;
+        }
+        if(oldest->second.LastUse == RequestCount)
+            return;
+        ProgramAST *prog = oldest->second.Prog;
+        Cache.erase(oldest);
+        evictProgram(prog);
+    }
+}
+
+/// the files given by -i, in the forms cxxopts accept
+static std::vector<std::string> scanInputFiles(const std::vector<std::string> &args, const std::string &dir) {
+    std::vector<std::string> inputs;
+    auto add = [&](const std::string &value) {
+        size_t start = 0;
+        while(start <= value.size()) {
+            size_t end = value.find(',', start);
+            if(end == std::string::npos)
+                end = value.size();
+            inputs.push_back(makeAbsolute(dir, value.substr(start, end - start)));
+            start = end + 1;
+        }
+    };
+    for(size_t i = 1; i < args.size(); i++) {
+        const std::string &arg = args[i];
+        if(arg == "-i" || arg == "--input") {
+            if(i + 1 < args.size())
+                add(args[++i]);
+        }
+        else if(arg.compare(0, 8, "--input=") == 0) {
+            add(arg.substr(8));
+        }
+        else if(arg.size() > 2 && arg.compare(0, 2, "-i") == 0) {
+            add(arg.substr(2));
+        }
+    }
+    return inputs;
+}
+
+/// parse, type check and fold a program like the driver do, false if it
+/// has an error
+static bool parseAndCheck(ProgramAST *prog) {
+    auto *parser = GrammarParser::getOrCreateGrammarParserByProg(prog);
+    parser->generateSrcToAst();
+    if(parser->getErrorCount())
+        return false;
+    TypeChecker checker;
+    checker.traverse(prog);
+    if(checker.hasError())
+        return false;
+    KaleConstFolder folder;
+    prog->accept(folder);
+    return true;
+}
+
+/// the programs of inputs, each is taken from the cache if its file is
+/// unchanged or parsed and cached. nullptr if they have an error, the
+/// request print it when it parse them again. parsed is set to the count
+/// of programs parsed
+static PreparsedPrograms *getPrograms(const std::vector<std::string> &inputs, unsigned &parsed) {
+    parsed = 0;
+    if(inputs.empty())
+        return nullptr;
+
+    fflush(stderr);
+    int savedStderr = dup(STDERR_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDERR_FILENO);
+    close(devNull);
+
+    /// the programs of the analysis only hold the imports, in the compile
+    /// order each is replaced by a cached program or a program parsed here
+    InputFileList = inputs;
+    ProgramList.clear();
+    bool success = preFileDepAnalysis();
+    std::vector<ProgramAST *> scanned = ProgramList;
+    std::map<ProgramAST *, ProgramAST *> replaced;
+    std::vector<ProgramAST *> programs;
+    RequestCount++;
+    for(size_t i = 0; success && i < scanned.size(); i++) {
+        unsigned index = scanned[i]->getLineNo()->FileIndex;
+        std::vector<ProgramAST *> deps;
+        for(auto *dep : scanned[i]->getDependentProgs()) {
+            deps.push_back(replaced[dep]);
+        }
+        /// the file is stamped before it is read, a change while parsing is
+        /// seen by the next request
+        FileStamp stamp;
+        if(!getStamp(InputFileList[index], stamp)) {
+            success = false;
+            break;
+        }
+
+        auto key = std::make_pair(InputFileList[index], index);
+        auto it = Cache.find(key);
+        if(it != Cache.end() && isSameStamp(it->second.Stamp, stamp) && it->second.Deps == deps) {
+            it->second.LastUse = RequestCount;
+            replaced[scanned[i]] = it->second.Prog;
+            programs.push_back(it->second.Prog);
+            continue;
+        }
+        if(it != Cache.end()) {
+            ProgramAST *old = it->second.Prog;
+            Cache.erase(it);
+            evictProgram(old);
+        }
+
+        auto *prog = new ProgramAST({index, 0, 0});
+        for(auto *dep : deps) {
+            prog->addDependentProg(dep);
+        }
+        parsed++;
+        if(!parseAndCheck(prog)) {
+            releaseProgram(prog);
+            success = false;
+            break;
+        }
+        Cache.insert({key, {prog, stamp, deps, RequestCount}});
+        replaced[scanned[i]] = prog;
+        programs.push_back(prog);
+    }
+    for(auto *prog : scanned) {
+        delete prog;
+    }
+
+    fflush(stderr);
+    dup2(savedStderr, STDERR_FILENO);
+    close(savedStderr);
+    Request = {inputs, InputFileList, programs};
+    InputFileList.clear();
+    ProgramList.clear();
+    trimCache();
+    return success ? &Request : nullptr;
+}
+/// ----------------------------------------------------------------
+
+
+/// ----------------------------------------------------------------
+/// split the payload to count strings ended by '\0' from pos
+static bool readStrings(const std::string &payload, size_t &pos, uint32_t count, std::vector<std::string> &out) {
+    for(uint32_t i = 0; i < count; i++) {
+        size_t end = payload.find('\0', pos);
+        if(end == std::string::npos)
+            return false;
+        out.emplace_back(payload, pos, end - pos);
+        pos = end + 1;
+    }
+    return true;
+}
+
+/// the requests run with the rights of the server, only its user is served
+static bool isSameUser(int conn) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    return !getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) && cred.uid == getuid();
+}
+
+/// the request is run in a process forked twice, the first one wait for
+/// the second and send its exit code, even if it is killed by a signal
+static void serveRequest(int listenFd, int conn, DriverMain driver) {
+    if(!isSameUser(conn)) {
+        std::cerr << "kalecc daemon: a request of another user is refused" << std::endl;
+        return;
+    }
+    RequestHeader header;
+    int fds[3] = {-1, -1, -1};
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = {&header, sizeof(header)};
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(conn, &msg, MSG_WAITALL);
+    for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            std::memcpy(fds, CMSG_DATA(cmsg), std::min(sizeof(fds), (size_t)(cmsg->cmsg_len - CMSG_LEN(0))));
+    }
+    auto closeFds = [&]() {
+        for(int fd : fds) {
+            if(fd >= 0)
+                close(fd);
+        }
+    };
+
+    std::string payload;
+    std::vector<std::string> strings;
+    size_t pos = 0;
+    if(n != sizeof(header) || header.Magic != RequestMagic || fds[0] < 0 || fds[1] < 0 || fds[2] < 0 ||
+       header.ArgCount == 0 || header.PayloadSize > MaxPayloadSize) {
+        closeFds();
+        return;
+    }
+    payload.resize(header.PayloadSize);
+    if(!readFull(conn, &payload[0], payload.size()) ||
+       !readStrings(payload, pos, 1 + header.ArgCount + header.EnvCount, strings)) {
+        closeFds();
+        return;
+    }
+    std::string dir = strings[0];
+    std::vector<std::string> args(strings.begin() + 1, strings.begin() + 1 + header.ArgCount);
+    std::vector<std::string> envs(strings.begin() + 1 + header.ArgCount, strings.end());
+
+    unsigned parsed;
+    auto inputs = scanInputFiles(args, dir);
+    PreparsedPrograms *programs = getPrograms(inputs, parsed);
+    if(!inputs.empty()) {
+        std::cerr << "kalecc daemon: " << inputs[0] << (inputs.size() > 1 ? " ..." : "")
+                  << (programs ? (parsed ? " (parsed " + std::to_string(parsed) + " of " +
+                                           std::to_string(programs->Programs.size()) + ")" : " (reused)") : "")
+                  << std::endl;
+    }
+
+    pid_t waiter = fork();
+    if(waiter == 0) {
+        close(listenFd);
+        signal(SIGCHLD, SIG_DFL);
+        pid_t worker = fork();
+        if(worker == 0) {
+            close(conn);
+            for(int i = 0; i < 3; i++) {
+                dup2(fds[i], i);
+            }
+            closeFds();
+            if(chdir(dir.c_str())) {
+                std::cerr << "kalecc daemon: can not enter " << dir << std::endl;
+                _exit(1);
+            }
+            clearenv();
+            for(auto &env : envs) {
+                putenv(&env[0]);
+            }
+            RequestPrograms = programs;
+            RequestDir = dir;
+            DaemonSocket.clear();
+
+            std::vector<char *> argv;
+            for(auto &arg : args) {
+                argv.push_back(&arg[0]);
+            }
+            argv.push_back(nullptr);
+            exit(driver(argv.size() - 1, argv.data()));
+        }
+        closeFds();
+        int status = 0, code = 1;
+        if(worker > 0 && waitpid(worker, &status, 0) == worker)
+            code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        int32_t ret = code;
+        writeFull(conn, &ret, sizeof(ret));
+        _exit(0);
+    }
+    closeFds();
+}
+/// ----------------------------------------------------------------
+
+
+/// ----------------------------------------------------------------
+int runCompileServer(const std::string &socketPath, DriverMain driver) {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "kalecc daemon: socket path " << socketPath << " is too long" << std::endl;
+        return 1;
+    }
+    std::strcpy(addr.sun_path, socketPath.c_str());
+
+    /// the socket is created 0600, no other user can connect
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    mode_t mask = umask(0177);
+    int bound = listenFd < 0 ? -1 : bind(listenFd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if(listenFd < 0 || bound || listen(listenFd, 64)) {
+        std::cerr << "kalecc daemon: can not listen on " << socketPath << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    /// the waiters are reaped by the system, a client gone is not an error
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+    /// the native target is initialized once, the requests inherit it
+    if(auto JTMB = KaleJITRunner::detectHost(O0); !JTMB)
+        llvm::consumeError(JTMB.takeError());
+#endif
+
+    std::cerr << "kalecc daemon: listening on " << socketPath << std::endl;
+    for(;;) {
+        int conn = accept(listenFd, nullptr, nullptr);
+        if(conn < 0) {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+            std::cerr << "kalecc daemon: " << strerror(errno) << std::endl;
+            close(listenFd);
+            return 1;
+        }
+        serveRequest(listenFd, conn, driver);
+        close(conn);
+    }
+}
+
+bool forwardToCompileServer(int argc, char *argv[], int &ret) {
+    const char *socketPath = getenv("KALE_DAEMON_SOCKET");
+    if(!socketPath || !*socketPath)
+        return false;
+    for(int i = 1; i < argc; i++) {
+        if(!std::strncmp(argv[i], "--daemon", 8))
+            return false;
+    }
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(std::strlen(socketPath) >= sizeof(addr.sun_path))
+        return false;
+    std::strcpy(addr.sun_path, socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        return false;
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(fd);
+        return false;
+    }
+
+    char dir[PATH_MAX];
+    if(!getcwd(dir, sizeof(dir))) {
+        close(fd);
+        return false;
+    }
+    std::string payload(dir, std::strlen(dir) + 1);
+    for(int i = 0; i < argc; i++) {
+        payload.append(argv[i], std::strlen(argv[i]) + 1);
+    }
+    uint32_t envCount = 0;
+    for(char **env = environ; *env; env++, envCount++) {
+        payload.append(*env, std::strlen(*env) + 1);
+    }
+
+    RequestHeader header = {RequestMagic, (uint32_t)argc, envCount, (uint32_t)payload.size()};
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))];
+    std::memset(control, 0, sizeof(control));
+    struct iovec iov = {&header, sizeof(header)};
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    /// once the request is sent it is run by the server, it is never run
+    /// again here
+    fflush(stdout);
+    if(sendmsg(fd, &msg, 0) != (ssize_t)sizeof(header)) {
+        close(fd);
+        return false;
+    }
+    int32_t code = 1;
+    if(!writeFull(fd, payload.data(), payload.size()) || !readFull(fd, &code, sizeof(code))) {
+        std::cerr << "kalecc: the compile server at " << socketPath << " dropped the request" << std::endl;
+        code = 1;
+    }
+    close(fd);
+    ret = code;
+    return true;
+}
+
+bool usePreparsedPrograms() {
+    if(!RequestPrograms)
+        return false;
+    std::vector<std::string> inputs;
+    for(auto &file : InputFileList) {
+        inputs.push_back(makeAbsolute(RequestDir, file));
+    }
+    if(inputs != RequestPrograms->Inputs)
+        return false;
+    InputFileList = RequestPrograms->Files;
+    ProgramList = RequestPrograms->Programs;
+    return true;
+}
+/// ----------------------------------------------------------------
+
+}
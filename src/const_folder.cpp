@@ -0,0 +1,497 @@
+
+#include "const_folder.h"
+#include "type_checker.h"
+#include "vm_builder.h"
+#include "bytecode.h"
+#include "statistic.h"
+#include "ast.h"
+#include "cast.h"
+
+namespace kale {
+
+KALE_STATISTIC(ExprsFolded,          "fold", "Number of constant exprs folded to a number");
+KALE_STATISTIC(ConstsPropagated,     "fold", "Number of const variable reads replaced by the value");
+KALE_STATISTIC(DeadBranchesRemoved,  "fold", "Number of if statements replaced by the branch taken");
+
+using Value = KaleConstFolder::Value;
+
+/// -----------------------------------------------------
+/// the types and the conversions are the ones of the vm
+/// builder, which follow the ir builder
+static bool isFPType(KType ty) {
+    return KaleVMBuilder::isFPType(ty);
+}
+
+static bool isIntType(KType ty) {
+    return ty == Bool || ty == Char || ty == UChar || ty == Short || ty == UShort ||
+           ty == Int || ty == Uint || ty == Long || ty == ULong;
+}
+
+static bool isSignedType(KType ty) {
+    return ty == Char || ty == Short || ty == Int || ty == Long;
+}
+
+static KType getIntType(unsigned bits, bool isSigned) {
+    switch (bits) {
+        case 1:  return Bool;
+        case 8:  return isSigned ? Char : UChar;
+        case 16: return isSigned ? Short : UShort;
+        case 32: return isSigned ? Int : Uint;
+        default: return isSigned ? Long : ULong;
+    }
+}
+
+/// the fp values converted to an integer without overflow
+static bool isInIntRange(double v) {
+    return v > -9223372036854775809.0 && v < 18446744073709551616.0;
+}
+
+static Value makeInt(KType ty, uint64_t bits) {
+    return {ty, normalizeValue(bits, KaleVMBuilder::getNormalizeAux(ty)), 0.0};
+}
+
+static Value makeFP(KType ty, double v) {
+    return {ty, 0, ty == Float ? (double)(float)v : v};
+}
+
+static Value makeBool(bool v) {
+    return {Bool, v, 0.0};
+}
+
+/// the bits of an integer operand in the form of the sign of the expr, as
+/// convertSign of the vm builder
+static uint64_t convertSign(const Value &v, KType ty, bool isSigned) {
+    unsigned bits = KaleVMBuilder::getTypeBits(ty);
+    if(bits >= 64 || isSignedType(ty) == isSigned)
+        return v.Bits;
+    return normalizeValue(v.Bits, makeNormalizeAux(bits, isSigned));
+}
+
+/// the operands of a binary expr are converted to one type like
+/// unifyOperands of the vm builder
+static KType unifyOperands(Value &lhs, Value &rhs) {
+    KType lk = lhs.Type, rk = rhs.Type;
+    if(lk == rk)
+        return lk;
+    if(lk == Double || (lk == Float && rk != Double)) {
+        rhs = KaleConstFolder::convertValue(rhs, lk);
+        return lk;
+    }
+    if(isFPType(rk) || KaleVMBuilder::getTypeBits(lk) < KaleVMBuilder::getTypeBits(rk)) {
+        lhs = KaleConstFolder::convertValue(lhs, rk);
+        return rk;
+    }
+    if(KaleVMBuilder::getTypeBits(lk) > KaleVMBuilder::getTypeBits(rk))
+        rhs = KaleConstFolder::convertValue(rhs, lk);
+    return lk;
+}
+
+/// a return, break or continue, or a block ended by one
+static bool isJumpStmt(StatementAST *stmt) {
+    switch (stmt->getClassId()) {
+        case ReturnStmtId:
+        case BreakStmtId:
+        case ContinueStmtId:
+            return true;
+        case BlockStmtId: {
+            auto &stmts = kale_cast<BlockStmtAST>(stmt)->getStmts();
+            return !stmts.empty() && isJumpStmt(stmts.back());
+        }
+        default:
+            return false;
+    }
+}
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+bool KaleConstFolder::getNumberValue(NumberExprAST *number, KType ty, Value &value) {
+    if(!isIntType(ty) && !isFPType(ty))
+        return false;
+    /// the literal converted to ty like the generators do
+    bool isSigned = number->isSigned();
+    uint64_t bits;
+    double fpValue;
+    if(number->isLong()) {
+        bits = number->getUIValue();
+        fpValue = isSigned ? (double)(long long)bits : (double)bits;
+    }
+    else if(number->isChar()) {
+        bits = isSigned ? (uint64_t)(int64_t)number->getCValue() : (uint64_t)(unsigned char)number->getCValue();
+        fpValue = (double)number->getCValue();
+    }
+    else if(number->isBoolLiteral()) {
+        bits = number->getBoolValue();
+        fpValue = number->getBoolValue();
+    }
+    else {
+        fpValue = number->getFValue();
+        /// an fp literal out of the range of the integer is left to the runtime
+        if(isIntType(ty) && !isInIntRange(fpValue))
+            return false;
+        bits = fpValue < 0 || (isSigned && fpValue < 9223372036854775808.0) ? (uint64_t)(long long)fpValue : (uint64_t)fpValue;
+    }
+    value = isFPType(ty) ? makeFP(ty, fpValue) : makeInt(ty, bits);
+    return true;
+}
+
+Value KaleConstFolder::convertValue(const Value &value, KType to) {
+    KType from = value.Type;
+    if(from == to)
+        return value;
+
+    if(isFPType(to)) {
+        if(isFPType(from))
+            return makeFP(to, value.FP);
+        /// int to fp is unsigned like the ir builder, a signed value is
+        /// taken as its bits
+        uint64_t bits = value.Bits;
+        unsigned fromBits = KaleVMBuilder::getTypeBits(from);
+        if(isSignedType(from) && fromBits < 64)
+            bits = normalizeValue(bits, makeNormalizeAux(fromBits, false));
+        return makeFP(to, to == Float ? (double)(float)bits : (double)bits);
+    }
+
+    if(isFPType(from)) {
+        double v = value.FP;
+        uint64_t bits = v >= 9223372036854775808.0 ? (uint64_t)v : (uint64_t)(int64_t)v;
+        return makeInt(to, bits);
+    }
+
+    /// int to int, a wider type is zero extended like the ir builder do,
+    /// a narrower one is truncated
+    unsigned fromBits = KaleVMBuilder::getTypeBits(from);
+    if(fromBits < KaleVMBuilder::getTypeBits(to) && isSignedType(from))
+        return makeInt(to, normalizeValue(value.Bits, makeNormalizeAux(fromBits, false)));
+    return makeInt(to, value.Bits);
+}
+
+bool KaleConstFolder::foldBinary(Operator op, bool isSigned, const Value &l, const Value &r, Value &result) {
+    Value lhs = l, rhs = r;
+    KType ty = unifyOperands(lhs, rhs);
+    if(!isIntType(ty) && !isFPType(ty))
+        return false;
+    bool fp = isFPType(ty);
+    unsigned bits = KaleVMBuilder::getTypeBits(ty);
+
+    if(fp) {
+        double a = lhs.FP, b = rhs.FP;
+        switch (op) {
+            case Add: result = makeFP(ty, a + b); return true;
+            case Sub: result = makeFP(ty, a - b); return true;
+            case Mul: result = makeFP(ty, a * b); return true;
+            case Div: result = makeFP(ty, a / b); return true;
+            case Eq:  result = makeBool(a == b); return true;
+            case Neq: result = makeBool(a != b); return true;
+            case Gt:  result = makeBool(a >  b); return true;
+            case Ge:  result = makeBool(a >= b); return true;
+            case Lt:  result = makeBool(a <  b); return true;
+            case Le:  result = makeBool(a <= b); return true;
+            default:  return false;
+        }
+    }
+
+    /// the integer result has the width of the operands and the sign of the expr
+    KType resultTy = getIntType(bits, isSigned);
+    switch (op) {
+        case Add:    result = makeInt(resultTy, lhs.Bits + rhs.Bits); return true;
+        case Sub:    result = makeInt(resultTy, lhs.Bits - rhs.Bits); return true;
+        case Mul:    result = makeInt(resultTy, lhs.Bits * rhs.Bits); return true;
+        case BitOr:  result = makeInt(resultTy, lhs.Bits | rhs.Bits); return true;
+        case BitAnd: result = makeInt(resultTy, lhs.Bits & rhs.Bits); return true;
+        case BitXor: result = makeInt(resultTy, lhs.Bits ^ rhs.Bits); return true;
+        case Or:     result = makeBool(lhs.Bits != 0 || rhs.Bits != 0); return true;
+        case And:    result = makeBool(lhs.Bits != 0 && rhs.Bits != 0); return true;
+        case Div: {
+            uint64_t a = convertSign(lhs, ty, isSigned);
+            uint64_t b = convertSign(rhs, ty, isSigned);
+            /// the division by zero is an error of the runtime
+            if(!b)
+                return false;
+            if(!isSigned)
+                result = makeInt(resultTy, a / b);
+            else if((int64_t)b == -1)
+                result = makeInt(resultTy, 0 - a);
+            else
+                result = makeInt(resultTy, (uint64_t)((int64_t)a / (int64_t)b));
+            return true;
+        }
+        case Lsft:
+        case Rsft: {
+            /// the shift by the width or more is undefined in the ir
+            if(rhs.Bits >= bits)
+                return false;
+            if(op == Lsft)
+                result = makeInt(resultTy, lhs.Bits << rhs.Bits);
+            else
+                result = makeInt(resultTy, convertSign(lhs, ty, false) >> rhs.Bits);
+            return true;
+        }
+        default:
+            break;
+    }
+
+    uint64_t a = convertSign(lhs, ty, isSigned);
+    uint64_t b = convertSign(rhs, ty, isSigned);
+    switch (op) {
+        case Eq:  result = makeBool(a == b); return true;
+        case Neq: result = makeBool(a != b); return true;
+        case Gt:  result = makeBool(isSigned ? (int64_t)a >  (int64_t)b : a >  b); return true;
+        case Ge:  result = makeBool(isSigned ? (int64_t)a >= (int64_t)b : a >= b); return true;
+        case Lt:  result = makeBool(isSigned ? (int64_t)a <  (int64_t)b : a <  b); return true;
+        case Le:  result = makeBool(isSigned ? (int64_t)a <= (int64_t)b : a <= b); return true;
+        default:  return false;
+    }
+}
+
+bool KaleConstFolder::foldUnary(Operator op, const Value &operand, Value &result) {
+    bool fp = isFPType(operand.Type);
+    switch (op) {
+        case Add: {
+            result = operand;
+            return true;
+        }
+        case Sub: {
+            result = fp ? makeFP(operand.Type, -operand.FP) : makeInt(operand.Type, 0 - operand.Bits);
+            return true;
+        }
+        case Not: {
+            if(fp)
+                return false;
+            result = makeBool(operand.Bits == 0);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// @brief Code implication of class KaleConstFolder
+/// -----------------------------------------------------
+ExprAST *KaleConstFolder::foldExpr(ExprAST *expr) {
+    if(!expr)
+        return nullptr;
+    LastExpr = nullptr;
+    expr->accept(*this);
+    ExprAST *result = LastExpr ? LastExpr : expr;
+    LastExpr = nullptr;
+    return result;
+}
+
+StatementAST *KaleConstFolder::foldStmt(StatementAST *stmt) {
+    if(!stmt)
+        return nullptr;
+    LastStmt = nullptr;
+    stmt->accept(*this);
+    StatementAST *result = LastStmt ? LastStmt : stmt;
+    LastStmt = nullptr;
+    return result;
+}
+
+/// the value of a number of the checked program, typed by the type checker
+static bool getConstValue(ExprAST *expr, Value &value) {
+    auto *number = kale_cast<NumberExprAST>(expr);
+    return number && KaleConstFolder::getNumberValue(number, number->getExprType(), value);
+}
+
+bool KaleConstFolder::getConstVariable(IdRefAST *ref, Value &value) {
+    auto *var = kale_cast<VariableAST>(ref->getId());
+    if(!var || !var->isConst() || var->isExtern() || var->isArrray() || !var->hasInitExpr() ||
+       kale_cast<ParamAST>(var->getParent()))
+        return false;
+    auto *number = kale_cast<NumberExprAST>(var->getInitExpr());
+    if(!number)
+        return false;
+    /// the init of a program loaded from its interface is not type
+    /// checked, the literal is read as it is written
+    KType literalTy = number->isBoolLiteral() ? Bool :
+                      number->isChar()        ? Char :
+                      number->isDouble()      ? Double :
+                      number->isSigned()      ? Long : ULong;
+    Value init;
+    KType varTy = var->getDataType()->getDataType();
+    if(!getNumberValue(number, literalTy, init) || (!isIntType(varTy) && !isFPType(varTy)) ||
+       (isFPType(init.Type) && isIntType(varTy) && !isInIntRange(init.FP)))
+        return false;
+    value = convertValue(init, varTy);
+    return true;
+}
+
+ExprAST *KaleConstFolder::createNumber(const Value &value, ExprAST *old) {
+    LineNo line = *old->getLineNo();
+    ASTArena &arena = Prog->getArena();
+    NumberExprAST *number;
+    if(value.Type == Bool)
+        number = arena.create<NumberExprAST>(line, old->getParent(), value.Bits != 0);
+    else if(isFPType(value.Type))
+        number = arena.create<NumberExprAST>(line, old->getParent(), value.FP);
+    else
+        number = arena.create<NumberExprAST>(line, old->getParent(), (long long)value.Bits);
+    bool isSigned = TypeChecker::isSigned(value.Type);
+    number->setIsSigned(isSigned);
+    number->setExprType(value.Type);
+    static_cast<ExprAST *>(number)->setIsSigned(isSigned);
+    number->setProgram(old->getProgram());
+    return number;
+}
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+void KaleConstFolder::visit(ProgramAST *node) {
+    Prog = node;
+    AstVisitor::visit(node);
+}
+
+void KaleConstFolder::visit(FuncAST *node) {
+    /// the init of a param is given by the caller, it is not folded
+    if(node->getBlockStmt())
+        node->getBlockStmt()->accept(*this);
+}
+
+void KaleConstFolder::visit(VariableAST *node) {
+    ExprAST *init = node->getInitExpr();
+    if(!init)
+        return;
+    init = foldExpr(init);
+    /// a constant init is converted to the type of the variable, as the
+    /// store of the value do
+    KType varTy = node->getDataType()->getDataType();
+    Value value;
+    if(!node->isArrray() && getConstValue(init, value) && value.Type != varTy &&
+       (isFPType(varTy) || (isIntType(varTy) && (!isFPType(value.Type) || isInIntRange(value.FP))))) {
+        init = createNumber(convertValue(value, varTy), init);
+    }
+    node->setInitExpr(init);
+}
+
+void KaleConstFolder::visit(InitializedAST *node) {
+    if(node->getExpr())
+        node->setExpr(foldExpr(node->getExpr()));
+    if(node->getInitExpr())
+        node->getInitExpr()->accept(*this);
+}
+
+void KaleConstFolder::visit(BlockStmtAST *node) {
+    auto &stmts = node->getStmts();
+    for(unsigned i = 0; i < stmts.size(); i++) {
+        StatementAST *stmt = stmts[i];
+        StatementAST *folded = foldStmt(stmt);
+        if(folded == stmt)
+            continue;
+        folded->setParent(node);
+        node->setStmt(i, folded);
+        /// the statements after the branch taken can't be reached if it
+        /// jump out, and no code can be generated after the jump
+        if(isJumpStmt(folded)) {
+            node->truncateStmts(i + 1);
+            break;
+        }
+    }
+}
+
+void KaleConstFolder::visit(ExprStmtAST *node) {
+    node->setExpr(foldExpr(node->getExpr()));
+}
+
+void KaleConstFolder::visit(ReturnStmtAST *node) {
+    node->setRetExpr(foldExpr(node->getRetExpr()));
+}
+
+void KaleConstFolder::visit(ForStmtAST *node) {
+    node->setExpr1(foldExpr(node->getExpr1()));
+    node->setExpr2(foldExpr(node->getExpr2()));
+    node->setExpr3(foldExpr(node->getExpr3()));
+    if(StatementAST *stmt = foldStmt(node->getStatement())) {
+        stmt->setParent(node);
+        node->setStatement(stmt);
+    }
+}
+
+void KaleConstFolder::visit(WhileStmtAST *node) {
+    node->setCond(foldExpr(node->getCond()));
+    if(StatementAST *stmt = foldStmt(node->getStatement())) {
+        stmt->setParent(node);
+        node->setStatement(stmt);
+    }
+}
+
+void KaleConstFolder::visit(IfStmtAST *node) {
+    node->setCond(foldExpr(node->getCond()));
+    if(StatementAST *stmt = foldStmt(node->getStatement())) {
+        stmt->setParent(node);
+        node->setStatement(stmt);
+    }
+    if(StatementAST *stmt = foldStmt(node->getElse())) {
+        stmt->setParent(node);
+        node->setElse(stmt);
+    }
+
+    Value cond;
+    if(!getConstValue(node->getCond(), cond))
+        return;
+    bool taken = isFPType(cond.Type) ? cond.FP != 0 : cond.Bits != 0;
+    StatementAST *branch = taken ? node->getStatement() : node->getElse();
+    /// the if without else and never taken is an empty block
+    if(!branch)
+        branch = Prog->getArena().create<BlockStmtAST>(*node->getLineNo(), node->getParent());
+    ++DeadBranchesRemoved;
+    LastStmt = branch;
+}
+
+void KaleConstFolder::visit(BinaryExprAST *node) {
+    if(node->getExprOp() == Assign) {
+        /// the variable assigned is kept, only the indexes of an element
+        /// are folded
+        if(!kale_cast<IdRefAST>(node->getLhs()))
+            node->setLhs(foldExpr(node->getLhs()));
+        node->setRhs(foldExpr(node->getRhs()));
+        return;
+    }
+
+    node->setLhs(foldExpr(node->getLhs()));
+    node->setRhs(foldExpr(node->getRhs()));
+    Value lhs, rhs, result;
+    if(getConstValue(node->getLhs(), lhs) && getConstValue(node->getRhs(), rhs) &&
+       foldBinary(node->getExprOp(), node->isSign(), lhs, rhs, result)) {
+        ++ExprsFolded;
+        LastExpr = createNumber(result, node);
+    }
+}
+
+void KaleConstFolder::visit(UnaryExprAST *node) {
+    node->setUnaryExpr(foldExpr(node->getUnaryExpr()));
+    Value operand, result;
+    if(getConstValue(node->getUnaryExpr(), operand) && foldUnary(node->getExprOp(), operand, result)) {
+        ++ExprsFolded;
+        LastExpr = createNumber(result, node);
+    }
+}
+
+void KaleConstFolder::visit(IdRefAST *node) {
+    Value value;
+    if(getConstVariable(node, value)) {
+        ++ConstsPropagated;
+        LastExpr = createNumber(value, node);
+    }
+}
+
+void KaleConstFolder::visit(IdIndexedRefAST *node) {
+    auto &indexes = node->getIndexes();
+    for(unsigned i = 0; i < indexes.size(); i++) {
+        node->setIndex(i, foldExpr(indexes[i]));
+    }
+}
+
+void KaleConstFolder::visit(CallExprAST *node) {
+    auto &args = node->getArgs();
+    for(unsigned i = 0; i < args.size(); i++) {
+        node->setArg(i, foldExpr(args[i]));
+    }
+}
+/// -----------------------------------------------------
+
+}
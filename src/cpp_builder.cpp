@@ -24,25 +24,25 @@ namespace kale {
     CppBuilder *build;
     const char *astName1[] = {
             "ProgramId",          /* This type express program                                        */
-            "DataDeclId",         /* This type express var define and var declare                     */
-            "VariableId",         /* This type express variable in kaleidoscope                       */
-            "IdDefId",            /* This type express id base class in kaleidoscope                  */
-            "DataTypeId",         /* This type expression data type in kaleidoscope                   */
-            "TypeRefId",          /* This type expression data ref in kaleidoscope                    */
             "FuncId",             /* This type express function define and function declare           */
             "FuncParamId",        /* This type express function param define                          */
+            "DataTypeId",         /* This type expression data type in kaleidoscope                   */
+            "TypeRefId",          /* This type expression data ref in kaleidoscope                    */
+            "IdDefId",            /* This type express id base class in kaleidoscope                  */
+            "VariableId",         /* This type express variable in kaleidoscope                       */
             "StmtId",             /* This type express base statement of statement                    */
             "ExprStmtId",         /* This type express expr statement of expr statement               */
+            "DataDeclId",         /* This type express var define and var declare                     */
             "SwitchId",           /* This type express switch statement                               */
             "IfStmtId",           /* This type express if statement                                   */
             "ForStmtId",          /* This type express for statement                                  */
             "WhileStmtId",        /* This type express while statement                                */
-            "InitializeId",       /* This type express var or struct object initialized expression    */
             "ReturnStmtId",       /* This type express return statement                               */
             "BreakStmtId",        /* This type express break statement                                */
             "BlockStmtId",        /* This type express block statement                                */
             "ContinueStmtId",     /* This type express continue statement                             */
             "ExprId",             /* This type express base expr of expression                        */
+            "InitializeId",       /* This type express var or struct object initialized expression    */
             "BinExprId",          /* This type express bin expr                                       */
             "UnaryExprId",        /* This type express unary expr                                     */
             "LiteralId",          /* This type express literal                                        */
@@ -52,8 +52,8 @@ namespace kale {
             "CallId",             /* This type express function call                                  */
             "LambdaId",           /* This type express lambda expression                              */
             "StructId"            /* This type express struct type define                             */
-
     };
+    static_assert(sizeof(astName1) / sizeof(astName1[0]) == LastAstId + 1, "astName1 is indexed by KAstId");
     const char *typeName1[] = {"Void", "Double", "Float", "Bool", "Char", "UChar", "Enum", "Short", "UShort", "Int",
                                "Uint", "Long", "ULong", "Struct", "Pointer"};
 
@@ -169,7 +169,7 @@ namespace kale {
 
     void CppBuilder::visit(VariableAST *node) {
         goodLook();
-        if ((node->getParent())->getClassId() == 7) {
+        if ((node->getParent())->getClassId() == FuncParamId) {
             TraversNode(node->getDataType());
             std::string name(node->getName());
             if(parmNum != 0){
@@ -278,7 +278,7 @@ namespace kale {
 
     void CppBuilder::visit(BinaryExprAST *node) {
         std::string ope(op[node->getExprOp()]);
-        if ((node->getLhs())->getClassId() == 12) {
+        if ((node->getLhs())->getClassId() == ForStmtId) {
             for (int i = 0; i < build->deepth; i++) {
                 build->write (" ");
             }
@@ -300,7 +300,7 @@ namespace kale {
 
     void CppBuilder::visit(LiteralExprAST *node) {
         build->write("\"" + node->getStr() + "\"" );
-        if ((node->getParent())->getClassId() == 26) {
+        if ((node->getParent())->getClassId() == CallId) {
             if(argNum != 0){
                 build->write (",");
                 argNum--;
@@ -321,7 +321,7 @@ namespace kale {
             std::string value = std::to_string(node->getFValue());
             build->write (value);
         }
-        if ((node->getParent())->getClassId() == 26) {
+        if ((node->getParent())->getClassId() == CallId) {
             if(argNum != 0){
                 build->write (",");
                 argNum--;
@@ -331,7 +331,7 @@ namespace kale {
 
     void CppBuilder::visit(IdRefAST *node) {
         build->write (node->getIdName());
-        if ((node->getParent())->getClassId() == 26) {
+        if ((node->getParent())->getClassId() == CallId) {
             if(argNum != 0){
                 build->write (",");
                 argNum--;
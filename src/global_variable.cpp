@@ -21,6 +21,9 @@ std::vector<ProgramAST*> ProgramList;
 /// T ==> The output file name
 std::string OutputFileName;
 
+/// T ==> The output file name is given by -o
+bool ExplicitOutputFile = false;
+
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
 /// T ==> The print ir flag
 bool PrintIR = false;
@@ -37,16 +40,42 @@ bool DumpIRToLL = false;
 /// T ==> The flag of compile and run executable file
 bool CompileAndRun = false;
 
+/// T ==> Run the programs by the bytecode vm
+bool RunInVM = false;
+bool PrintBytecode = false;
+
+/// T ==> The socket served by the compile server, empty if not a server
+std::string DaemonSocket;
+
 /// T ==> Use multi thread compile
 bool UseMultThreadCompile = false;
 int ThreadCount = 1;
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
 bool UseLLVMToolChainFlag = true;
+
+/// T ==> The directory of the object cache, empty if not use cache
+std::string CacheDir;
+
+/// T ==> Compile each function on its first call when run by the jit
+bool LazyJIT = false;
+
+/// T ==> Run the functions at O0 first and optimize the hot ones when run by the jit
+bool TieredJIT = false;
+unsigned TierUpThreshold = 1000;
 #endif
 
 KaleOptLevel OptLevel = O0;
 
+/// T ==> The chrome trace file of the compile time, empty if not traced
+std::string TimeTraceFile;
+
+/// T ==> Print the compile time of each phase
+bool TimeReport = false;
+
+/// T ==> Print the statistics as text or json, empty if not printed
+std::string StatsFormat;
+
 std::string CheckInputFile;
 bool UseCheck = false;
 
@@ -60,6 +89,11 @@ bool OnlyPrintIR = false;
 bool OnlyPrintAST = false;
 #endif
 
+/// T ==> This global variable define for benchmark
+#ifdef __BENCH_ENABLE__
+std::string BenchName;
+#endif
+
 /// T ==> Std Function map
 std::unordered_set<std::string> StdFunctionSet = {
     "Print","PrintLn",
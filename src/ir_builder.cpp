@@ -3,6 +3,8 @@
 #include "ir_support.h"
 #include "type_checker.h"
 #include "global_variable.h"
+#include "time_trace.h"
+#include "statistic.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/Support/Host.h"
 #include "llvm/ADT/Triple.h"
@@ -13,15 +15,30 @@ namespace kale {
 
 #define ENTRY_BBLK "entry"
 
-KaleIRBuilder::KaleIRBuilder(ProgramAST *prog) : Prog(prog) {
+KALE_STATISTIC(ModulesGenerated,    "irgen", "Number of llvm modules generated");
+KALE_STATISTIC(FunctionsGenerated,  "irgen", "Number of llvm functions generated");
+KALE_STATISTIC(InstructionsEmitted, "irgen", "Number of llvm instructions emitted");
+
+KaleIRBuilder::KaleIRBuilder(ProgramAST *prog, llvm::LLVMContext &ctx) : Context(ctx), Prog(prog) {
     assert(prog && "program can not be nullptr");
     std::string module_name = "module" + std::to_string(prog->getLineNo()->FileIndex);
-    TheModule = new llvm::Module(module_name, GlobalContext);
+    TheModule = new llvm::Module(module_name, Context);
     TheModule->setTargetTriple(llvm::sys::getDefaultTargetTriple());
-    TheIRBuilder = new llvm::IRBuilder<>(GlobalContext);
+    TheIRBuilder = new llvm::IRBuilder<>(Context);
     CurBblk = nullptr;
 }
 
+KaleIRBuilder::~KaleIRBuilder() {
+    delete TheIRBuilder;
+    delete TheModule;
+}
+
+std::unique_ptr<llvm::Module> KaleIRBuilder::takeLLVMModule() {
+    std::unique_ptr<llvm::Module> module(TheModule);
+    TheModule = nullptr;
+    return module;
+}
+
 void KaleIRBuilder::generateProgToIr() {
     for(auto *prog : Prog->getDependentProgs()) {
         switch (prog->getCompiledFlag())
@@ -43,12 +60,31 @@ void KaleIRBuilder::generateProgToIr() {
     Prog->setCompiledFlag(ProgramAST::CompiledFlag::Success);
 }
 
+void KaleIRBuilder::visit(ProgramAST *node) {
+    AstVisitor::visit(node);
+
+    /// the module is complete, count what is emitted for it
+    unsigned funcs = 0, insts = 0;
+    for(auto &func : *TheModule) {
+        if(func.isDeclaration())
+            continue;
+        funcs++;
+        insts += func.getInstructionCount();
+    }
+    ++ModulesGenerated;
+    FunctionsGenerated += funcs;
+    InstructionsEmitted += insts;
+    if(KaleStatistics::isEnabled())
+        KaleStatistics::addModuleValue(node, "instructions", insts);
+}
+
 void KaleIRBuilder::visit(FuncAST *node) {
     llvm::FunctionType *funcTy = getFunctionTypeByFuncASTNode(node);
     if(node->isFuncDeclare()) {
        node->setLLVMFunction(llvm::dyn_cast<llvm::Function>(TheModule->getOrInsertFunction(node->getFuncName(), funcTy).getCallee()));
     }
     else {
+        KaleTimeTraceScope scope("IRGenFunction", node->getFuncName());
         createAndSetCurrentFunc(node->getFuncName(), funcTy);
         node->setLLVMFunction(CurFunc);
         CurFuncAst = node;
@@ -74,17 +110,7 @@ void KaleIRBuilder::visit(StructDefAST *node) {
 }
 
 void KaleIRBuilder::visit(VariableAST *node) {
-    llvm::Type *ty = getLLVMType(node->getDataType());
-    if(!node->getDims().empty()) {
-        unsigned size = 1;
-        auto begin = node->getDims().rbegin();
-        auto end = node->getDims().rend();
-        while(begin != end) {
-            size = size * getConstIntByExpr(*begin);
-            begin++;
-        }
-        ty = llvm::ArrayType::get(ty, size);
-    }
+    llvm::Type *ty = getVariableLLVMType(node);
     llvm::Value *value;
     node->setLLVMType(ty);
     if(node->isExtern()) {
@@ -96,7 +122,7 @@ void KaleIRBuilder::visit(VariableAST *node) {
         llvm::Constant *initValue = nullptr;
         if(node->getInitExpr()) {
             node->getInitExpr()->accept(*this);
-            initValue = dyn_cast<llvm::Constant>(LastValue);
+            initValue = llvm::dyn_cast<llvm::Constant>(LastValue);
             assert(initValue && "illegal init!");
         }
         else {
@@ -133,7 +159,7 @@ void KaleIRBuilder::visit(ReturnStmtAST *node) {
 void KaleIRBuilder::visit(BreakStmtAST *node) {
     assert(!AfterStack.empty() && "break jump stack can not be empty!");
     TheIRBuilder->CreateBr(AfterStack.back());
-//    llvm::BasicBlock *BreakAfter = llvm::BasicBlock::Create(GlobalContext, "break_next");
+//    llvm::BasicBlock *BreakAfter = llvm::BasicBlock::Create(Context, "break_next");
 //    CurFunc->getBasicBlockList().push_back(BreakAfter);
 //    TheIRBuilder->SetInsertPoint(BreakAfter);
 }
@@ -141,15 +167,15 @@ void KaleIRBuilder::visit(BreakStmtAST *node) {
 void KaleIRBuilder::visit(ContinueStmtAST *node) {
     assert(!CondStack.empty() && "break jump stack can not be empty!");
     TheIRBuilder->CreateBr(CondStack.back());
-//    llvm::BasicBlock *ContinueAfter = llvm::BasicBlock::Create(GlobalContext, "continue_next");
+//    llvm::BasicBlock *ContinueAfter = llvm::BasicBlock::Create(Context, "continue_next");
 //    CurFunc->getBasicBlockList().push_back(ContinueAfter);
 //    TheIRBuilder->SetInsertPoint(ContinueAfter);
 }
 
 void KaleIRBuilder::visit(ForStmtAST *node) {
-    llvm::BasicBlock *Cond = BasicBlock::Create(GlobalContext, "for_cond");
-    llvm::BasicBlock *Body = BasicBlock::Create(GlobalContext, "for_body");
-    llvm::BasicBlock *After = BasicBlock::Create(GlobalContext, "for_after");
+    llvm::BasicBlock *Cond = BasicBlock::Create(Context, "for_cond");
+    llvm::BasicBlock *Body = BasicBlock::Create(Context, "for_body");
+    llvm::BasicBlock *After = BasicBlock::Create(Context, "for_after");
 
     AfterStack.push_back(After);
     CondStack.push_back(Cond);
@@ -180,9 +206,9 @@ void KaleIRBuilder::visit(ForStmtAST *node) {
 }
 
 void KaleIRBuilder::visit(WhileStmtAST *node) {
-    llvm::BasicBlock *Cond = BasicBlock::Create(GlobalContext, "while_cond");
-    llvm::BasicBlock *Body = BasicBlock::Create(GlobalContext, "while_body");
-    llvm::BasicBlock *After = BasicBlock::Create(GlobalContext, "while_after");
+    llvm::BasicBlock *Cond = BasicBlock::Create(Context, "while_cond");
+    llvm::BasicBlock *Body = BasicBlock::Create(Context, "while_body");
+    llvm::BasicBlock *After = BasicBlock::Create(Context, "while_after");
 
     AfterStack.push_back(After);
     CondStack.push_back(Cond);
@@ -207,12 +233,12 @@ void KaleIRBuilder::visit(WhileStmtAST *node) {
 }
 
 void KaleIRBuilder::visit(IfStmtAST *node) {
-    llvm::BasicBlock *IfBody = BasicBlock::Create(GlobalContext, "if_body");
-    llvm::BasicBlock *After = BasicBlock::Create(GlobalContext, "if_after");
+    llvm::BasicBlock *IfBody = BasicBlock::Create(Context, "if_body");
+    llvm::BasicBlock *After = BasicBlock::Create(Context, "if_after");
     node->getCond()->accept(*this);
     convertToI1();
     if(node->getElse()) {
-        llvm::BasicBlock *Else = BasicBlock::Create(GlobalContext, "else_body");
+        llvm::BasicBlock *Else = BasicBlock::Create(Context, "else_body");
         TheIRBuilder->CreateCondBr(LastValue, IfBody, Else);
         CurFunc->getBasicBlockList().push_back(IfBody);
         TheIRBuilder->SetInsertPoint(IfBody);
@@ -253,12 +279,12 @@ void KaleIRBuilder::visit(BinaryExprAST *node) {
         node->getRhs()->accept(*this);
         llvm::Type *storeTy = nullptr;
         if(auto ref = kale_cast<IdRefAST>(node->getLhs())){
-            storeTy = ref->getId()->getVarLLVMType();
+            storeTy = getIdLLVMType(ref->getId());
         }
         else {
             auto indexedRef = kale_cast<IdIndexedRefAST>(node->getLhs());
             assert(indexedRef);
-            storeTy = indexedRef->getId()->getVarLLVMType()->getArrayElementType();
+            storeTy = getIdLLVMType(indexedRef->getId())->getArrayElementType();
         }
         storeValueToPointer(storeTy, lhs, LastValue);
     }
@@ -300,7 +326,13 @@ void KaleIRBuilder::visit(BinaryExprAST *node) {
                 break;
             }
             case Div: {
-                LastValue = TheIRBuilder->CreateFDiv(lhs, rhs);
+                if(lhs->getType()->isFloatTy() || lhs->getType()->isDoubleTy()) {
+                    LastValue = TheIRBuilder->CreateFDiv(lhs, rhs);
+                }
+                else {
+                    if(node->isSign()) {LastValue = TheIRBuilder->CreateSDiv(lhs, rhs);}
+                    else{LastValue = TheIRBuilder->CreateUDiv(lhs, rhs);}
+                }
                 break;
             }
             case Eq: {
@@ -336,7 +368,7 @@ void KaleIRBuilder::visit(BinaryExprAST *node) {
                 break;
             }
             case Lsft: {
-                LastValue = TheIRBuilder->CreateLShr(lhs, rhs);
+                LastValue = TheIRBuilder->CreateShl(lhs, rhs);
                 break;
             }
             case Or: {
@@ -399,7 +431,7 @@ void KaleIRBuilder::visit(UnaryExprAST *node) {
 }
 
 void KaleIRBuilder::visit(LiteralExprAST *node) {
-    llvm::Constant *initvalue = llvm::ConstantDataArray::get(GlobalContext, llvm::ArrayRef<char>(node->getStr().c_str(), node->getStr().size() + 1));
+    llvm::Constant *initvalue = llvm::ConstantDataArray::get(Context, llvm::ArrayRef<char>(node->getStr().c_str(), node->getStr().size() + 1));
     LastValue = new llvm::GlobalVariable(
             *TheModule,
             initvalue->getType(),
@@ -408,7 +440,7 @@ void KaleIRBuilder::visit(LiteralExprAST *node) {
             initvalue,
             "private_str"
             );
-    LastValue = TheIRBuilder->CreateBitCast(LastValue, llvm::Type::getInt8PtrTy(GlobalContext));
+    LastValue = TheIRBuilder->CreateBitCast(LastValue, llvm::Type::getInt8PtrTy(Context));
 }
 
 void KaleIRBuilder::visit(NumberExprAST *node) {
@@ -463,11 +495,11 @@ void KaleIRBuilder::visit(NumberExprAST *node) {
 void KaleIRBuilder::visit(IdRefAST *node) {
     NeededType = node->getId()->getDataType()->getDataType();
     if(IsNeedPointer) {
-        LastValue = node->getId()->getLLVMValue();
+        LastValue = getIdLLVMValue(node->getId());
     }
     else {
-        LastValue = node->getId()->getLLVMValue();
-        if(LastValue->getType()->isPointerTy()) { LastValue = TheIRBuilder->CreateLoad(node->getId()->getVarLLVMType(), LastValue);}
+        LastValue = getIdLLVMValue(node->getId());
+        if(LastValue->getType()->isPointerTy()) { LastValue = TheIRBuilder->CreateLoad(getIdLLVMType(node->getId()), LastValue);}
     }
 }
 
@@ -504,9 +536,10 @@ void KaleIRBuilder::visit(IdIndexedRefAST *node) {
     }
 
     IsNeedPointer = isNeed;
-    LastValue = TheIRBuilder->CreateInBoundsGEP(var->getVarLLVMType(), node->getLLVMValue(), {KaleIRConstantValueSupport::KaleIntZero, v});
+    llvm::Type *varTy = getIdLLVMType(var);
+    LastValue = TheIRBuilder->CreateInBoundsGEP(varTy, getIdLLVMValue(var), {KaleIRConstantValueSupport::KaleIntZero, v});
     if(!IsNeedPointer) {
-        LastValue = TheIRBuilder->CreateLoad(var->getVarLLVMType()->getArrayElementType(), LastValue);
+        LastValue = TheIRBuilder->CreateLoad(varTy->getArrayElementType(), LastValue);
     }
 }
 
@@ -528,11 +561,53 @@ void KaleIRBuilder::visit(CallExprAST *node) {
                 index++;
             }
         }
-        auto callee = node->getLLVMFunction();
+        auto callee = getCallee(node->getFuncDef());
         LastValue = TheIRBuilder->CreateCall(callee, args);
     }
 }
 
+llvm::Type *KaleIRBuilder::getVariableLLVMType(VariableAST *var) {
+    llvm::Type *ty = getLLVMType(var->getDataType());
+    if(!var->getDims().empty()) {
+        unsigned size = 1;
+        auto begin = var->getDims().rbegin();
+        auto end = var->getDims().rend();
+        while(begin != end) {
+            size = size * getConstIntByExpr(*begin);
+            begin++;
+        }
+        ty = llvm::ArrayType::get(ty, size);
+    }
+    return ty;
+}
+
+/// the node is defined in another program, so its llvm value is in the
+/// module (and maybe the context) of that program
+bool KaleIRBuilder::isImported(ASTBase *node) {
+    while(node && node->getClassId() != ProgramId) {
+        node = node->getParent();
+    }
+    return node && node != Prog;
+}
+
+llvm::FunctionCallee KaleIRBuilder::getCallee(FuncAST *func) {
+    if(!isImported(func))
+        return func->getLLVMFunction();
+    return TheModule->getOrInsertFunction(func->getFuncName(), getFunctionTypeByFuncASTNode(func));
+}
+
+llvm::Value *KaleIRBuilder::getIdLLVMValue(IdDefAST *id) {
+    if(!isImported(id))
+        return id->getLLVMValue();
+    return TheModule->getOrInsertGlobal(id->getName(), getIdLLVMType(id));
+}
+
+llvm::Type *KaleIRBuilder::getIdLLVMType(IdDefAST *id) {
+    if(!isImported(id))
+        return id->getVarLLVMType();
+    return getVariableLLVMType(kale_cast<VariableAST>(id));
+}
+
 llvm::FunctionType *KaleIRBuilder::getFunctionTypeByFuncASTNode(FuncAST *node) {
     llvm::Type *rettype = getLLVMType(node->getRetType());
     std::vector<llvm::Type *> argtys;
@@ -637,7 +712,7 @@ void KaleIRBuilder::createAndSetCurrentFunc(const llvm::StringRef& name, llvm::F
 }
 void KaleIRBuilder::createAndSetCurrentBblk(const llvm::StringRef& name) {
     assert(CurFunc);
-    llvm::BasicBlock *bblk = llvm::BasicBlock::Create(GlobalContext, name, CurFunc);
+    llvm::BasicBlock *bblk = llvm::BasicBlock::Create(Context, name, CurFunc);
     if(CurBblk) {
         if(CurBblk->getTerminator()) {
             CurBblk = bblk;
@@ -660,7 +735,7 @@ llvm::Constant *KaleIRBuilder::createConstantValue(llvm::Type *ty) {
         return llvm::ConstantFP::get(ty, 0.0);
     }
     else if(ty->isArrayTy()) {
-        auto arrTy = dyn_cast<ArrayType>(ty);
+        auto arrTy = llvm::dyn_cast<ArrayType>(ty);
         auto elemTy = arrTy->getElementType();
         auto size = arrTy->getNumElements();
         auto v = createConstantValue(elemTy);
@@ -771,19 +846,19 @@ void KaleIRBuilder::generateStdFuncCall(CallExprAST *node) {
     else {
         if(node->isArgEmpty()) LastValue = TheIRBuilder->CreateCall(func);
         else {
-            auto params = StdKaleFuncTypeMap[node->getName()];
+            /// the map is shared by the threads, it is only read here
+            auto found = StdKaleFuncTypeMap.find(node->getName());
             auto paramargs = node->getArgs();
             unsigned index = 0;
-            if(!params.empty()) {
-                for(auto param : params) {
+            if(found != StdKaleFuncTypeMap.end()) {
+                for(auto param : found->second) {
                     paramargs[index]->accept(*this);
                     convertToAimType(kaleTypeToLLVMType(param));
                     args.push_back(LastValue);
                     index++;
                 }
             }
-            auto callee = node->getLLVMFunction();
-            LastValue = TheIRBuilder->CreateCall(callee, args);
+            LastValue = TheIRBuilder->CreateCall(func, args);
         }
     }
 }
@@ -816,27 +891,49 @@ llvm::Type *KaleIRBuilder::kaleTypeToLLVMType(KType ty) {
     }
 }
 
+std::mutex KaleIRBuilder::ProgToIrBuilderMapLock;
 std::unordered_map<ProgramAST *, KaleIRBuilder *> KaleIRBuilder::ProgToIrBuilderMap = {};
 
 KaleIRBuilder *KaleIRBuilder::getOrCreateIrBuilderByProg(ProgramAST *prog) {
+    return getOrCreateIrBuilderByProg(prog, GlobalContext);
+}
+
+KaleIRBuilder *KaleIRBuilder::getOrCreateIrBuilderByProg(ProgramAST *prog, llvm::LLVMContext &ctx) {
+    std::lock_guard<std::mutex> guard(ProgToIrBuilderMapLock);
     if(ProgToIrBuilderMap.find(prog) == ProgToIrBuilderMap.end()) {
-        KaleIRBuilder *builder = new KaleIRBuilder(prog);
+        KaleIRBuilder *builder = new KaleIRBuilder(prog, ctx);
         ProgToIrBuilderMap.insert({prog, builder});
         return builder;
     }
     return ProgToIrBuilderMap[prog];
 }
 
+void KaleIRBuilder::releaseIrBuilderByProg(ProgramAST *prog) {
+    std::lock_guard<std::mutex> guard(ProgToIrBuilderMapLock);
+    auto it = ProgToIrBuilderMap.find(prog);
+    if(it != ProgToIrBuilderMap.end()) {
+        delete it->second;
+        ProgToIrBuilderMap.erase(it);
+    }
+}
+
 std::unordered_map<std::string, std::vector<KType>> KaleIRBuilder::StdKaleFuncTypeMap = {};
-std::unordered_map<std::string, llvm::FunctionType*> KaleIRBuilder::StdLLVMFuncTypeMap = {};
+thread_local std::unordered_map<std::string, llvm::FunctionType*> KaleIRBuilder::StdLLVMFuncTypeMap = {};
+
+void KaleIRBuilder::initContextSupport(llvm::LLVMContext &ctx) {
+    KaleIRTypeSupport::initIRTypeSupport(ctx);
+    KaleIRConstantValueSupport::initIRConastantSupport();
+    initStdFunctionTypeMap(ctx);
+}
 
-void KaleIRBuilder::initStdFunctionTypeMap() {
+void KaleIRBuilder::initStdFunctionTypeMap(llvm::LLVMContext &ctx) {
+    StdLLVMFuncTypeMap.clear();
     llvm::FunctionType *ty;
     ty = llvm::FunctionType::get(KaleIRTypeSupport::KaleIntType, {}, false);
     StdLLVMFuncTypeMap.insert({"GetInt", ty});
     ty = llvm::FunctionType::get(KaleIRTypeSupport::KaleDoubleType, {}, false);
     StdLLVMFuncTypeMap.insert({"GetDouble", ty});
-    ty = llvm::FunctionType::get(KaleIRTypeSupport::KaleVoidType, {llvm::Type::getInt8PtrTy(GlobalContext)}, true);
+    ty = llvm::FunctionType::get(KaleIRTypeSupport::KaleVoidType, {llvm::Type::getInt8PtrTy(ctx)}, true);
     StdLLVMFuncTypeMap.insert({"Print", ty});
     StdLLVMFuncTypeMap.insert({"PrintLn", ty});
 }
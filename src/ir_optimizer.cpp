@@ -0,0 +1,49 @@
+
+#include "ir_optimizer.h"
+#include "time_trace.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// @brief Code implication of class KaleIROptimizer
+/// -----------------------------------------------------
+static llvm::OptimizationLevel getOptimizationLevel(KaleOptLevel level) {
+    switch (level) {
+        case O1: return llvm::OptimizationLevel::O1;
+        case O2: return llvm::OptimizationLevel::O2;
+        case O3: return llvm::OptimizationLevel::O3;
+        default: return llvm::OptimizationLevel::O0;
+    }
+}
+
+void KaleIROptimizer::optimizeModule(llvm::Module &M, llvm::TargetMachine *TM, KaleOptLevel level) {
+    if(level == O0)
+        return;
+    KaleTimeTraceScope scope("Optimize", M.getModuleIdentifier());
+
+    if(TM) {
+        M.setDataLayout(TM->createDataLayout());
+    }
+
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+
+    llvm::PassBuilder PB(TM);
+    FAM.registerPass([&] { return PB.buildDefaultAAPipeline(); });
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    llvm::ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(getOptimizationLevel(level));
+    MPM.run(M, MAM);
+}
+/// -----------------------------------------------------
+
+}
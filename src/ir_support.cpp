@@ -8,46 +8,46 @@ namespace kale {
 
 // clang-format off
 
-llvm::Type *KaleIRTypeSupport::KaleVoidType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleBoolType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleCharType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleUCharType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleShortType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleUShortType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleIntType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleUIntType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleLongType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleULongType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleFloatType = nullptr;
-llvm::Type *KaleIRTypeSupport::KaleDoubleType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleVoidType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleBoolType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleCharType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleUCharType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleShortType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleUShortType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleIntType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleUIntType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleLongType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleULongType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleFloatType = nullptr;
+thread_local llvm::Type *KaleIRTypeSupport::KaleDoubleType = nullptr;
 
-void KaleIRTypeSupport::initIRTypeSupport() {
-    KaleVoidType    = llvm::Type::getVoidTy(GlobalContext);
-    KaleBoolType    = llvm::Type::getInt1Ty(GlobalContext);
-    KaleCharType    = llvm::Type::getInt8Ty(GlobalContext);
-    KaleUCharType   = llvm::Type::getInt8Ty(GlobalContext);
-    KaleShortType   = llvm::Type::getInt16Ty(GlobalContext);
-    KaleUShortType  = llvm::Type::getInt16Ty(GlobalContext);
-    KaleIntType     = llvm::Type::getInt32Ty(GlobalContext);
-    KaleUIntType    = llvm::Type::getInt32Ty(GlobalContext);
-    KaleLongType    = llvm::Type::getInt64Ty(GlobalContext);
-    KaleULongType   = llvm::Type::getInt64Ty(GlobalContext);
-    KaleFloatType   = llvm::Type::getFloatTy(GlobalContext);
-    KaleDoubleType  = llvm::Type::getDoubleTy(GlobalContext);
+void KaleIRTypeSupport::initIRTypeSupport(llvm::LLVMContext &ctx) {
+    KaleVoidType    = llvm::Type::getVoidTy(ctx);
+    KaleBoolType    = llvm::Type::getInt1Ty(ctx);
+    KaleCharType    = llvm::Type::getInt8Ty(ctx);
+    KaleUCharType   = llvm::Type::getInt8Ty(ctx);
+    KaleShortType   = llvm::Type::getInt16Ty(ctx);
+    KaleUShortType  = llvm::Type::getInt16Ty(ctx);
+    KaleIntType     = llvm::Type::getInt32Ty(ctx);
+    KaleUIntType    = llvm::Type::getInt32Ty(ctx);
+    KaleLongType    = llvm::Type::getInt64Ty(ctx);
+    KaleULongType   = llvm::Type::getInt64Ty(ctx);
+    KaleFloatType   = llvm::Type::getFloatTy(ctx);
+    KaleDoubleType  = llvm::Type::getDoubleTy(ctx);
 }
 
-llvm::Constant *KaleIRConstantValueSupport::KaleFalse = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleTrue = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleCharZero = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleUCharZero = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleShortZero = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleUShortZero = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleIntZero = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleUIntZero = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleLongZero = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleULongZero = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleFloatZero = nullptr;
-llvm::Constant *KaleIRConstantValueSupport::KaleDoubleZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleFalse = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleTrue = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleCharZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleUCharZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleShortZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleUShortZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleIntZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleUIntZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleLongZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleULongZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleFloatZero = nullptr;
+thread_local llvm::Constant *KaleIRConstantValueSupport::KaleDoubleZero = nullptr;
 
 void KaleIRConstantValueSupport::initIRConastantSupport() {
     KaleTrue        = llvm::ConstantInt::get(KaleIRTypeSupport::KaleBoolType, 1);
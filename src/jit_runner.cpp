@@ -0,0 +1,276 @@
+
+#include "jit_runner.h"
+#include "global_variable.h"
+#include "compile_scheduler.h"
+#include "ir_builder.h"
+#include "ir_optimizer.h"
+#include "object_cache.h"
+#include "tiered_jit.h"
+#include "time_trace.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+extern "C" {
+#include "kaleidoscope_std.h"
+}
+
+#include <cstdio>
+#include <cassert>
+#include <mutex>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// @brief Code implication of class KaleJITRunner
+/// -----------------------------------------------------
+static llvm::CodeGenOpt::Level getJITCodeGenOptLevel(KaleOptLevel level) {
+    switch (level) {
+        case O1: return llvm::CodeGenOpt::Less;
+        case O2: return llvm::CodeGenOpt::Default;
+        case O3: return llvm::CodeGenOpt::Aggressive;
+        default: return llvm::CodeGenOpt::None;
+    }
+}
+
+/// the std functions are called by name from the jitted code, bind them to
+/// the ones linked into kalecc
+llvm::Error KaleJITRunner::defineStdSymbols(llvm::orc::LLJIT &J) {
+    llvm::orc::SymbolMap symbols;
+    auto flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+    symbols[J.mangleAndIntern("Print")] =
+        llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&Print), flags);
+    symbols[J.mangleAndIntern("PrintLn")] =
+        llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&PrintLn), flags);
+    symbols[J.mangleAndIntern("GetInt")] =
+        llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&GetInt), flags);
+    symbols[J.mangleAndIntern("GetDouble")] =
+        llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&GetDouble), flags);
+    return J.getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols)));
+}
+
+static bool reportError(llvm::Error err) {
+    llvm::logAllUnhandledErrors(std::move(err), llvm::errs(), "kalecc jit: ");
+    return false;
+}
+
+llvm::Expected<llvm::orc::JITTargetMachineBuilder> KaleJITRunner::detectHost(KaleOptLevel level) {
+    static std::once_flag InitTarget;
+    std::call_once(InitTarget, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+
+    auto JTMB = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if(!JTMB)
+        return JTMB.takeError();
+    JTMB->setCodeGenOptLevel(getJITCodeGenOptLevel(level));
+    return JTMB;
+}
+
+llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> KaleJITRunner::createJIT(KaleOptLevel level,
+                                                                          llvm::ObjectCache *cache) {
+    auto JTMB = detectHost(level);
+    if(!JTMB)
+        return JTMB.takeError();
+
+    llvm::orc::LLJITBuilder builder;
+    builder.setJITTargetMachineBuilder(std::move(*JTMB));
+    if(cache) {
+        builder.setCompileFunctionCreator([cache](llvm::orc::JITTargetMachineBuilder JTMB)
+                -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+            auto TM = JTMB.createTargetMachine();
+            if(!TM)
+                return TM.takeError();
+            return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*TM), cache);
+        });
+    }
+    auto J = builder.create();
+    if(!J)
+        return J.takeError();
+    if(auto err = defineStdSymbols(**J))
+        return std::move(err);
+    return J;
+}
+
+/// called by the stub of a function if its lazy compile failed
+static void reportLazyCompileFailure() {
+    fprintf(stderr, "kalecc jit: failed to compile function lazily\n");
+    abort();
+}
+
+llvm::Expected<std::unique_ptr<llvm::orc::LLLazyJIT>> KaleJITRunner::createLazyJIT(KaleOptLevel level) {
+    auto JTMB = detectHost(level);
+    if(!JTMB)
+        return JTMB.takeError();
+    auto TM = JTMB->createTargetMachine();
+    if(!TM)
+        return TM.takeError();
+
+    llvm::orc::LLLazyJITBuilder builder;
+    builder.setJITTargetMachineBuilder(std::move(*JTMB));
+    builder.setLazyCompileFailureAddr(llvm::pointerToJITTargetAddress(&reportLazyCompileFailure));
+    auto J = builder.create();
+    if(!J)
+        return J.takeError();
+
+    /// each function is extracted to its own module when it is first
+    /// called, and optimized alone before compiled
+    (*J)->setPartitionFunction(llvm::orc::CompileOnDemandLayer::compileRequested);
+    if(level != O0) {
+        std::shared_ptr<llvm::TargetMachine> sharedTM = std::move(*TM);
+        (*J)->getIRTransformLayer().setTransform(
+            [sharedTM, level](llvm::orc::ThreadSafeModule TSM, const llvm::orc::MaterializationResponsibility &)
+                -> llvm::Expected<llvm::orc::ThreadSafeModule> {
+            TSM.withModuleDo([&](llvm::Module &M) {
+                KaleIROptimizer::optimizeModule(M, sharedTM.get(), level);
+            });
+            return std::move(TSM);
+        });
+    }
+
+    if(auto err = defineStdSymbols(**J))
+        return std::move(err);
+    return J;
+}
+
+llvm::Error KaleJITRunner::addModule(llvm::orc::LLJIT &J, llvm::orc::ThreadSafeModule TSM, KaleOptLevel level, bool lazy) {
+    if(lazy) {
+        /// the functions are optimized by the transform layer when compiled
+        TSM.withModuleDo([&](llvm::Module &M) {
+            M.setDataLayout(J.getDataLayout());
+            M.setTargetTriple(J.getTargetTriple().str());
+        });
+        return static_cast<llvm::orc::LLLazyJIT &>(J).addLazyIRModule(std::move(TSM));
+    }
+    if(auto err = TSM.withModuleDo([&](llvm::Module &M) { return prepareModule(J, M, level); }))
+        return err;
+    return J.addIRModule(std::move(TSM));
+}
+
+llvm::Error KaleJITRunner::prepareModule(llvm::orc::LLJIT &J, llvm::Module &M, KaleOptLevel level) {
+    M.setDataLayout(J.getDataLayout());
+    M.setTargetTriple(J.getTargetTriple().str());
+    if(level == O0)
+        return llvm::Error::success();
+
+    auto JTMB = detectHost(level);
+    if(!JTMB)
+        return JTMB.takeError();
+    auto TM = JTMB->createTargetMachine();
+    if(!TM)
+        return TM.takeError();
+    KaleIROptimizer::optimizeModule(M, TM->get(), level);
+    return llvm::Error::success();
+}
+
+bool KaleJITRunner::runMain(CompileScheduler &scheduler, int &ret, const std::string &stdoutFile,
+                            KaleObjectCache *cache) {
+    std::unique_ptr<llvm::orc::LLJIT> J;
+    std::unique_ptr<KaleTieredJIT> tiered;
+    if(TieredJIT) {
+        auto tieredJIT = KaleTieredJIT::create(OptLevel, TierUpThreshold);
+        if(!tieredJIT)
+            return reportError(tieredJIT.takeError());
+        tiered = std::move(*tieredJIT);
+        cache = nullptr;
+    }
+    else if(LazyJIT) {
+        auto lazyJIT = createLazyJIT(OptLevel);
+        if(!lazyJIT)
+            return reportError(lazyJIT.takeError());
+        J = std::move(*lazyJIT);
+        cache = nullptr;
+    }
+    else {
+        auto eagerJIT = createJIT(OptLevel, cache);
+        if(!eagerJIT)
+            return reportError(eagerJIT.takeError());
+        J = std::move(*eagerJIT);
+    }
+
+    /// the jit own the contexts from now, a module is added with the
+    /// context it was generated in
+    std::unordered_map<llvm::LLVMContext *, llvm::orc::ThreadSafeContext> contexts;
+    for(unsigned i = 0; i < scheduler.getThreadCount(); i++) {
+        auto ctx = scheduler.takeWorkerContext(i);
+        llvm::LLVMContext *key = ctx.get();
+        contexts.insert({key, llvm::orc::ThreadSafeContext(std::move(ctx))});
+    }
+
+    for(auto *prog : ProgramList) {
+        KaleTimeTraceScope scope("AddModule", prog);
+        if(cache && cache->isCached(prog)) {
+            auto object = llvm::MemoryBuffer::getFile(cache->getObjectPath(prog));
+            if(!object)
+                return reportError(llvm::errorCodeToError(object.getError()));
+            if(auto err = J->addObjectFile(std::move(*object)))
+                return reportError(std::move(err));
+            continue;
+        }
+        auto module = KaleIRBuilder::getOrCreateIrBuilderByProg(prog)->takeLLVMModule();
+        auto found = contexts.find(&module->getContext());
+        assert(found != contexts.end() && "module not generated in a worker context");
+        if(cache)
+            cache->registerModule(module.get(), prog);
+        llvm::orc::ThreadSafeModule TSM(std::move(module), found->second);
+        if(auto err = tiered ? tiered->addModule(std::move(TSM)) : addModule(*J, std::move(TSM), OptLevel, LazyJIT))
+            return reportError(std::move(err));
+    }
+    if(tiered) {
+        KaleTimeTraceScope scope("CompileBaseline");
+        if(auto err = tiered->compileBaseline())
+            return reportError(std::move(err));
+    }
+
+    /// the eager jit compile the modules on the lookup of main
+    auto mainSym = [&] {
+        KaleTimeTraceScope scope("JITCompile");
+        return (tiered ? &tiered->getJIT() : J.get())->lookup("main");
+    }();
+    if(!mainSym)
+        return reportError(mainSym.takeError());
+#if LLVM_VERSION_MAJOR >= 15
+    auto mainFunc = mainSym->toPtr<int (*)()>();
+#else
+    auto mainFunc = reinterpret_cast<int (*)()>(mainSym->getAddress());
+#endif
+
+    /// redirect the output of the program to the file
+    int savedStdout = -1;
+    if(!stdoutFile.empty()) {
+        int fd = open(stdoutFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) {
+            llvm::errs() << "kalecc jit: could not open file " << stdoutFile << "\n";
+            return false;
+        }
+        fflush(stdout);
+        savedStdout = dup(STDOUT_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    }
+
+    {
+        KaleTimeTraceScope scope("RunMain");
+        ret = mainFunc();
+        fflush(stdout);
+    }
+
+    if(savedStdout >= 0) {
+        dup2(savedStdout, STDOUT_FILENO);
+        close(savedStdout);
+    }
+    return true;
+}
+/// -----------------------------------------------------
+
+}
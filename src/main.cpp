@@ -7,21 +7,36 @@
 #include "cxxopts.hpp"
 #include "parser.h"
 #include "cpp_builder.h"
+#include "compile_scheduler.h"
+#include "compile_server.h"
+#include "time_trace.h"
+#include "statistic.h"
+#include "type_checker.h"
+#include "const_folder.h"
+#include "vm_builder.h"
+#include "vm.h"
 
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
 #include "ir_builder.h"
-#include "type_checker.h"
 #include "ir_support.h"
+#include "jit_runner.h"
+#include "object_cache.h"
 #endif
 
 #ifdef __CTEST_ENABLE__
 #include "test/test.h"
 #endif  
 
+#ifdef __BENCH_ENABLE__
+#include "bench/bench.h"
+#endif
+
 
 #include <memory>
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <unistd.h>
 
 
 using namespace cxxopts;
@@ -49,12 +64,22 @@ int parseCmdArgs(int argc, char *argv[]) {
             ("print-ir", "Print ir generation message", cxxopts::value<bool>()->default_value("false"))
             ("serialize-ir", "Dump ir to file", cxxopts::value<bool>()->default_value("false"))
             ("use-llvm-tool-chain", "Use llvm tool chain", cxxopts::value<bool>()->default_value("true"))
+            ("cache-dir", "Object cache directory, default to $KALE_CACHE_DIR", cxxopts::value<std::string>())
+            ("lazy-jit", "Compile each function on its first call with -r", cxxopts::value<bool>()->default_value("false"))
+            ("tiered-jit", "Run functions at O0 first and optimize the hot ones in background with -r", cxxopts::value<bool>()->default_value("false"))
+            ("tier-up-threshold", "Calls and loop iterations before a function is optimized", cxxopts::value<unsigned>()->default_value("1000"))
 #endif
             ("print-ast", "Print ast of source file", cxxopts::value<bool>()->default_value("false"))
             ("o, output", "Output file name", cxxopts::value<std::string>()->default_value("a.out"))
             ("h, help", "Print help")
             ("j", "Mult thread compile", cxxopts::value<int>()->default_value("1"))
             ("r, run", "Compile and run", cxxopts::value<bool>()->default_value("false"))
+            ("vm", "Run the programs by the bytecode vm instead of compiling them", cxxopts::value<bool>()->default_value("false"))
+            ("print-bytecode", "Print the bytecode run by --vm", cxxopts::value<bool>()->default_value("false"))
+            ("daemon", "Serve the compile requests sent to this unix socket", cxxopts::value<std::string>())
+            ("time-trace", "Write the time of the compile phases as a chrome trace to the file", cxxopts::value<std::string>()->implicit_value("kalecc-trace.json"))
+            ("time-report", "Print the time of the compile phases", cxxopts::value<bool>()->default_value("false"))
+            ("stats", "Print the compiler statistics and the memory of the phases, as text or json", cxxopts::value<std::string>()->implicit_value("text"))
 
             ("O, optimize-level", "Optimize level", cxxopts::value<unsigned>()->default_value("0"))
             ("check-input", "The Check input file", cxxopts::value<std::string>());
@@ -66,6 +91,9 @@ int parseCmdArgs(int argc, char *argv[]) {
 #endif
         ("only-parse", "Only parse", cxxopts::value<bool>()->default_value("false"));
 #endif
+#ifdef __BENCH_ENABLE__
+        options.add_options()("bench", "Run the named micro benchmark", cxxopts::value<std::string>());
+#endif
     
         auto result = options.parse(argc, argv);
 
@@ -74,6 +102,25 @@ int parseCmdArgs(int argc, char *argv[]) {
             exit(0);
         }
 
+        /// the server take no input, each request give its own
+        if(result.count("daemon")) {
+            DaemonSocket = result["daemon"].as<std::string>();
+            return 0;
+        }
+
+#ifdef __BENCH_ENABLE__
+        if(result.count("bench")) {
+            BenchName = result["bench"].as<std::string>();
+            /// the benchmarks running programs take them by -i
+            if(result.count("input")) {
+                for(auto &file : result["input"].as<std::vector<std::string>>()) {
+                    InputFileList.push_back(file);
+                }
+            }
+            return 0;
+        }
+#endif
+
         if(!result.count("input")) {
             std::cerr << "No input files was given!" << std::endl;
             return 1;
@@ -88,8 +135,34 @@ int parseCmdArgs(int argc, char *argv[]) {
         PrintIR = result["print-ir"].as<bool>();
         DumpIRToLL = result["serialize-ir"].as<bool>();
         UseLLVMToolChainFlag = result["use-llvm-tool-chain"].as<bool>();
+        if(result.count("cache-dir")) {
+            CacheDir = result["cache-dir"].as<std::string>();
+        }
+        else if(const char *dir = getenv("KALE_CACHE_DIR")) {
+            CacheDir = dir;
+        }
+        LazyJIT = result["lazy-jit"].as<bool>();
+        TieredJIT = result["tiered-jit"].as<bool>();
+        TierUpThreshold = result["tier-up-threshold"].as<unsigned>();
+        if(LazyJIT && TieredJIT) {
+            std::cerr << "--lazy-jit and --tiered-jit can't be used together!" << std::endl;
+            return 1;
+        }
 #endif
         CompileAndRun = result["run"].as<bool>();
+        RunInVM = result["vm"].as<bool>();
+        PrintBytecode = result["print-bytecode"].as<bool>();
+        if(result.count("time-trace")) {
+            TimeTraceFile = result["time-trace"].as<std::string>();
+        }
+        TimeReport = result["time-report"].as<bool>();
+        if(result.count("stats")) {
+            StatsFormat = result["stats"].as<std::string>();
+            if(StatsFormat != "text" && StatsFormat != "json") {
+                std::cerr << "--stats must be text or json!" << std::endl;
+                return 1;
+            }
+        }
 
         ThreadCount = result["j"].as<int>();
         if(ThreadCount > 1) {
@@ -98,6 +171,7 @@ int parseCmdArgs(int argc, char *argv[]) {
         }
 
         OutputFileName = result["output"].as<std::string>();
+        ExplicitOutputFile = result.count("output") > 0;
 
         switch (result["optimize-level"].as<unsigned>()) {
             case O1: OptLevel = O1;
@@ -133,7 +207,113 @@ int parseCmdArgs(int argc, char *argv[]) {
 
 
 
-int main(int argc, char *argv[]) {
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+/// @brief the cache is not used when the ast or ir is asked, they are
+/// not produced for the cached programs, the lazy and tiered jit
+/// compile the functions one by one instead of the whole programs and
+/// the vm run no object
+static bool useObjectCache() {
+    if(CacheDir.empty() || PrintAST || PrintIR || DumpIRToLL || LazyJIT || TieredJIT || RunInVM)
+        return false;
+#ifdef __CTEST_ENABLE__
+    if(OnlyParse || OnlyPrintAST || OnlyPrintIR)
+        return false;
+#endif
+    return true;
+}
+#endif
+
+
+/// @brief type check the programs, the errors are printed once all are
+/// checked. Return false if a program is ill typed
+static bool typeCheckPrograms(CompileScheduler &scheduler, const std::vector<ProgramAST *> &progs) {
+    /// each worker only write the message of its own program
+    std::vector<std::string> errors(InputFileList.size());
+    scheduler.runOnPrograms(progs, [&errors](ProgramAST *prog, unsigned) {
+        KaleTimeTraceScope scope("TypeCheck", prog);
+        TypeChecker checker;
+        checker.traverse(prog);
+        if(checker.hasError())
+            errors[prog->getLineNo()->FileIndex] = checker.getErrorMessage();
+    }, false);
+    KaleStatistics::endPhase("TypeCheck");
+
+    bool success = true;
+    for(unsigned i = 0; i < errors.size(); i++) {
+        if(!errors[i].empty()) {
+            printf("error: %s:%s\n", InputFileList[i].c_str(), errors[i].c_str());
+            success = false;
+        }
+    }
+    return success;
+}
+
+/// @brief run the programs by the bytecode vm, it is the same in the
+/// llvm and cmodel builds
+static int runInVM(CompileScheduler &scheduler, bool checked) {
+    if(!checked) {
+        if(!typeCheckPrograms(scheduler, ProgramList)) {
+            std::cerr << "Exit with error!" << std::endl;
+            return 1;
+        }
+
+        scheduler.runOnPrograms(ProgramList, [](ProgramAST *prog, unsigned) {
+            KaleTimeTraceScope scope("Fold", prog);
+            KaleConstFolder folder;
+            prog->accept(folder);
+        }, true);
+        KaleStatistics::endPhase("Fold");
+    }
+
+    VMModule module;
+    for(auto *prog : ProgramList) {
+        KaleTimeTraceScope scope("BytecodeGen", prog);
+        KaleVMBuilder builder(module);
+        if(!builder.buildProgram(prog)) {
+            std::cerr << "kalecc vm: " << builder.getErrorMessage() << std::endl;
+            std::cerr << "Exit with error!" << std::endl;
+            return 1;
+        }
+    }
+    KaleStatistics::endPhase("BytecodeGen");
+    for(auto *prog : ProgramList) {
+        prog->releaseAst();
+    }
+    KaleStatistics::endPhase("ReleaseAst");
+
+    if(PrintBytecode) {
+        std::string out;
+        module.dump(out);
+        std::cout << out;
+    }
+
+    KaleVM vm(module);
+    int ret = 0;
+    std::string outputFile = UseCheck ? "kale_vm_output" + std::to_string(getpid()) + ".txt" : "";
+    bool success;
+    {
+        KaleTimeTraceScope scope("RunMain");
+        success = vm.runMain(ret, outputFile);
+    }
+    KaleStatistics::endPhase("RunMain");
+    if(!success) {
+        std::cerr << "kalecc vm: " << vm.getErrorMessage() << std::endl;
+        std::cerr << "Exit with error!" << std::endl;
+        if(!outputFile.empty())
+            std::remove(outputFile.c_str());
+        return 1;
+    }
+    if(UseCheck) {
+        std::string cmd = "FileCheck-15 " + CheckInputFile + " --input-file=" + outputFile;
+        ret = system(cmd.c_str());
+        std::remove(outputFile.c_str());
+    }
+    return ret;
+}
+
+
+/// @brief the driver, run by main or by the compile server for a request
+static int runCompiler(int argc, char *argv[]) {
     /// parse command line option
     if(parseCmdArgs(argc, argv)) {
         std::cerr << "Exit with error!" << std::endl;
@@ -143,17 +323,96 @@ int main(int argc, char *argv[]) {
 #ifdef __CTEST_ENABLE__
     if(TokenParserTestFlag) {return tokenParserTest();}
 #endif    
-    
+
+#ifdef __BENCH_ENABLE__
+    if(!BenchName.empty()) {return runBenchmark(BenchName);}
+#endif
+
+    if(!DaemonSocket.empty()) {return runCompileServer(DaemonSocket, runCompiler);}
+
+    /// the time trace, time report and statistics are written on every
+    /// return of the driver
+    struct ReportGuard {
+        ReportGuard() {
+            if(!TimeTraceFile.empty() || TimeReport)
+                KaleTimeTrace::begin();
+            if(!StatsFormat.empty())
+                KaleStatistics::enable();
+        }
+        ~ReportGuard() {
+            KaleTimeTrace::finish(TimeTraceFile, TimeReport);
+            if(!StatsFormat.empty())
+                KaleStatistics::print(StatsFormat);
+        }
+    } reportGuard;
+
+    /// in a request of the compile server the programs may be parsed and
+    /// type checked already
+    bool preparsed = usePreparsedPrograms();
+
     /// Pre Analysis
-    if(!preFileDepAnalysis()) {
-        std::cerr << "Exit with error!" << std::endl;
-        return 1;
+    if(!preparsed) {
+        KaleTimeTraceScope scope("PreAnalysis");
+        if(!preFileDepAnalysis()) {
+            std::cerr << "Exit with error!" << std::endl;
+            return 1;
+        }
+        KaleStatistics::endPhase("PreAnalysis");
     }
     
-    /// @fixme ast generate test
-    for(auto *prog : ProgramList) {
+    /// a program is parsed after the programs it imports, the independent
+    /// programs are parsed concurrently when -j is given
+    std::vector<ProgramAST *> parseList = ProgramList;
+    std::vector<ProgramAST *> compileList = ProgramList;
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+    /// the programs found in the object cache are not compiled again, only
+    /// the cached programs imported by the others are parsed
+    std::unique_ptr<KaleObjectCache> cache;
+    if(useObjectCache()) {
+        cache = std::make_unique<KaleObjectCache>(CacheDir, CompileAndRun && !ExplicitOutputFile ? "jit" : "aot");
+        cache->lookupPrograms(ProgramList);
+        parseList = cache->getProgramsToParse(ProgramList);
+        compileList = cache->getProgramsToCompile(ProgramList);
+    }
+#endif
+    if(preparsed) {
+        parseList.clear();
+    }
+
+    CompileScheduler scheduler(UseMultThreadCompile ? ThreadCount : 1);
+    scheduler.runOnPrograms(parseList, [&](ProgramAST *prog, unsigned) {
         auto parser = GrammarParser::getOrCreateGrammarParserByProg(prog);
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+        /// a cached program is only parsed for its exports, they are read
+        /// from its interface when the cache has one
+        if(cache) {
+            KaleTimeTraceScope scope("LoadInterface", prog);
+            if(cache->loadInterface(prog, parser))
+                return;
+        }
+#endif
+        KaleTimeTraceScope scope("Parse", prog);
         parser->generateSrcToAst();
+#ifndef __USE_C_MODULE_TRANSLATION_METHOD__
+        if(cache && !parser->getErrorCount()) {
+            cache->storeInterface(prog, parser);
+        }
+#endif
+    }, true);
+    KaleStatistics::endPhase("Parse");
+
+    /// the errors are printed after the parse, so the programs parsed in
+    /// parallel do not mix their errors
+    bool parseFailed = false;
+    for(auto *prog : parseList) {
+        for(auto &msg : GrammarParser::getOrCreateGrammarParserByProg(prog)->getErrorMessages()) {
+            printf("error: %s\n", msg.c_str());
+            parseFailed = true;
+        }
+    }
+    if(parseFailed) {
+        std::cerr << "Exit with error!" << std::endl;
+        return 1;
     }
 
 #ifdef __CTEST_ENABLE__
@@ -166,7 +425,7 @@ int main(int argc, char *argv[]) {
     if(PrintAST) {
         DumpVisitor v;
         for(auto *prog : ProgramList) {
-            prog->accept(v);
+            v.traverse(prog);
         }
     }
 
@@ -174,30 +433,54 @@ int main(int argc, char *argv[]) {
     if (OnlyPrintAST) {
         DumpVisitor v;
         for(auto *prog : ProgramList) {
-            v.visit(prog);
+            v.traverse(prog);
         }
         return 0;
     }
 #endif
 
+    if(RunInVM) {
+        return runInVM(scheduler, preparsed);
+    }
+
 #ifndef __USE_C_MODULE_TRANSLATION_METHOD__
-    TypeChecker checker;
-    for(auto *prog : ProgramList) {
-        prog->accept(checker);
+    /// type checking only write the expr nodes of its own program
+    if(!preparsed) {
+        if(!typeCheckPrograms(scheduler, compileList)) {
+            std::cerr << "Exit with error!" << std::endl;
+            return 1;
+        }
+
+        /// a program read the const variables of the programs it import,
+        /// so they are folded first
+        scheduler.runOnPrograms(compileList, [](ProgramAST *prog, unsigned) {
+            KaleTimeTraceScope scope("Fold", prog);
+            KaleConstFolder folder;
+            prog->accept(folder);
+        }, true);
+        KaleStatistics::endPhase("Fold");
     }
 
-    KaleIRTypeSupport::initIRTypeSupport();
-    KaleIRConstantValueSupport::initIRConastantSupport();
-    KaleIRBuilder::initStdFunctionTypeMap();
-    /// generate ir
-    for(auto *prog : ProgramList) {
-        auto builder = KaleIRBuilder::getOrCreateIrBuilderByProg(prog);
+    /// generate ir, each worker generate ir in its own context and the
+    /// imported symbols are declared in the module of the importer
+    scheduler.runOnPrograms(compileList, [&scheduler](ProgramAST *prog, unsigned worker) {
+        KaleTimeTraceScope scope("IRGen", prog);
+        llvm::LLVMContext &ctx = scheduler.getWorkerContext(worker);
+        KaleIRBuilder::initContextSupport(ctx);
+        auto builder = KaleIRBuilder::getOrCreateIrBuilderByProg(prog, ctx);
         prog->accept(*builder);
 //        if(llvm::verifyModule(*builder->getLLVMModule())) {
 //            std::cerr << "Exit with error!" << std::endl;
 //            return 1;
 //        }
+    }, false);
+    KaleStatistics::endPhase("IRGen");
+
+    /// the ast is no longer needed after ir generation, release them in one shot
+    for(auto *prog : ProgramList) {
+        prog->releaseAst();
     }
+    KaleStatistics::endPhase("ReleaseAst");
 
     /// print ir
     if(PrintIR) {
@@ -216,11 +499,29 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 #endif
+    /// without an output file the program is run in process by the jit
+    if(CompileAndRun && !ExplicitOutputFile) {
+        int ret = 0;
+        std::string outputFile = UseCheck ? "kale_jit_output" + std::to_string(getpid()) + ".txt" : "";
+        if(!KaleJITRunner::runMain(scheduler, ret, outputFile, cache.get())) {
+            std::cerr << "Exit with error!" << std::endl;
+            return 1;
+        }
+        KaleStatistics::endPhase("JIT");
+        if(UseCheck) {
+            std::string cmd = "FileCheck-15 " + CheckInputFile + " --input-file=" + outputFile;
+            ret = system(cmd.c_str());
+            std::remove(outputFile.c_str());
+        }
+        return ret;
+    }
+
     /// compile ir to executable file
-    if(LLVMBuilderChain(argv[0]).runAndCompileToExecutable()) {
+    if(LLVMBuilderChain(argv[0], &scheduler, cache.get()).runAndCompileToExecutable()) {
         std::cerr << "Exit with error!";
         return 1;
     }
+    KaleStatistics::endPhase("Codegen");
 
     /// run this case?
     if(CompileAndRun) {
@@ -248,6 +549,7 @@ int main(int argc, char *argv[]) {
     cmd = "gcc ";
     int index = 0;
     for(auto *prog : ProgramList) {
+        KaleTimeTraceScope scope("CGen", prog);
         fileName = "file" + std::to_string(index++) + ".c";
         std::ofstream outFile( fileName);
         cmd.append(fileName).append(" ");
@@ -257,9 +559,19 @@ int main(int argc, char *argv[]) {
 
         outFile.close();
     }
+    KaleStatistics::endPhase("CGen");
+    for(auto *prog : ProgramList) {
+        prog->releaseAst();
+    }
+    KaleStatistics::endPhase("ReleaseAst");
     cmd.append("-L").append(rpath).append("/../lib ").append("-lkale_std ")
             .append("-o ").append(OutputFileName);
-    int ret = system(cmd.c_str());
+    int ret;
+    {
+        KaleTimeTraceScope scope("CCompile", cmd);
+        ret = system(cmd.c_str());
+    }
+    KaleStatistics::endPhase("CCompile");
     if(ret == 0){
         if(CompileAndRun){
             cmd = "./" + OutputFileName;
@@ -273,3 +585,14 @@ int main(int argc, char *argv[]) {
 #endif
     return 0;
 }
+
+
+int main(int argc, char *argv[]) {
+    /// with $KALE_DAEMON_SOCKET set the command is run by the compile
+    /// server if one answer
+    int ret;
+    if(forwardToCompileServer(argc, argv, ret)) {
+        return ret;
+    }
+    return runCompiler(argc, argv);
+}
@@ -0,0 +1,309 @@
+
+#include "module_interface.h"
+#include "parser.h"
+#include "cast.h"
+
+#include <vector>
+#include <cstring>
+
+namespace kale {
+
+static_assert(sizeof(ModuleInterface::InterfaceHeader) == 32, "interface header layout changed");
+static_assert(sizeof(ModuleInterface::FuncRecord) == 16, "interface func record layout changed");
+static_assert(sizeof(ModuleInterface::VarRecord) == 24, "interface var record layout changed");
+
+/// ----------------------------------------------------------------
+/// @brief fold the integer constant expr of an array dimension, as
+/// the ir builder compute the dimensions
+static bool foldInteger(ExprAST *expr, int64_t &value) {
+    switch (expr->getClassId())
+    {
+        case NumberId: {
+            auto *number = kale_cast<NumberExprAST>(expr);
+            if(number->isDouble())
+                return false;
+            value = number->isChar() ? number->getCValue() :
+                    number->isBoolLiteral() ? number->getBoolValue() : number->getIValue();
+            return true;
+        }
+        case UnaryExprId: {
+            auto *unary = kale_cast<UnaryExprAST>(expr);
+            if(!foldInteger(unary->getUnaryExpr(), value))
+                return false;
+            switch(unary->getExprOp()) {
+                case Add: return true;
+                case Sub: value = -value; return true;
+                case Not: value = !value; return true;
+                default:  return false;
+            }
+        }
+        case BinExprId: {
+            auto *bin = kale_cast<BinaryExprAST>(expr);
+            int64_t rhs;
+            if(!foldInteger(bin->getLhs(), value) || !foldInteger(bin->getRhs(), rhs))
+                return false;
+            switch(bin->getExprOp()) {
+                case Add: value += rhs; return true;
+                case Sub: value -= rhs; return true;
+                case Mul: value *= rhs; return true;
+                case Div: {
+                    if(rhs == 0)
+                        return false;
+                    value /= rhs;
+                    return true;
+                }
+                default:  return false;
+            }
+        }
+        default:
+            return false;
+    }
+}
+
+/// @brief record the value of a const variable initialized by a number,
+/// maybe negated, the other init exprs are not recorded
+static void foldConstValue(ExprAST *expr, ModuleInterface::VarRecord &rec) {
+    bool negate = false;
+    while(auto *unary = kale_cast<UnaryExprAST>(expr)) {
+        if(unary->getExprOp() == Sub)
+            negate = !negate;
+        else if(unary->getExprOp() != Add)
+            return;
+        expr = unary->getUnaryExpr();
+    }
+    auto *number = kale_cast<NumberExprAST>(expr);
+    if(!number)
+        return;
+    if(number->isDouble()) {
+        rec.Kind = ModuleInterface::DoubleValue;
+        rec.Value.DoubleVal = negate ? -number->getFValue() : number->getFValue();
+        return;
+    }
+    if(negate)
+        return;
+    if(number->isChar()) {
+        rec.Kind = ModuleInterface::CharValue;
+        rec.Value.IntVal = number->getCValue();
+    }
+    else if(number->isBoolLiteral()) {
+        rec.Kind = ModuleInterface::BoolValue;
+        rec.Value.IntVal = number->getBoolValue();
+    }
+    else {
+        rec.Kind = ModuleInterface::IntValue;
+        rec.Value.IntVal = number->getIValue();
+        if(number->isSigned())
+            rec.Flags |= ModuleInterface::ValueSigned;
+    }
+}
+
+static uint8_t getTypeCode(DataTypeAST *type) {
+    return type ? (uint8_t)type->getDataType() : ModuleInterface::NoType;
+}
+
+template<class T>
+static void appendRecords(std::string &out, const std::vector<T> &records) {
+    out.append((const char *)records.data(), records.size() * sizeof(T));
+}
+/// ----------------------------------------------------------------
+
+
+/// ----------------------------------------------------------------
+bool ModuleInterface::write(GrammarParser &parser, std::string &out) {
+    std::vector<FuncRecord> funcs;
+    std::vector<VarRecord>  globals;
+    std::vector<VarRecord>  params;
+    std::vector<int64_t>    dims;
+    std::string             strings;
+
+    auto addString = [&strings](Symbol name) {
+        uint32_t offset = strings.size();
+        strings.append(name.str());
+        strings.push_back('\0');
+        return offset;
+    };
+    auto makeVarRecord = [&](VariableAST *var, VarRecord &rec) {
+        std::memset(&rec, 0, sizeof(rec));
+        rec.Name = addString(var->getSymbol());
+        rec.Type = getTypeCode(var->getDataType());
+        rec.Flags = (var->isConst() ? VarConst : 0) | (var->isStatic() ? VarStatic : 0) |
+                    (var->isExtern() ? VarExtern : 0);
+        rec.FirstDim = dims.size();
+        rec.DimCount = var->getArrayDimSize();
+        for(auto *dim : var->getDims()) {
+            int64_t value;
+            if(!foldInteger(dim, value))
+                return false;
+            dims.push_back(value);
+        }
+        if(var->isConst() && var->hasInitExpr())
+            foldConstValue(var->getInitExpr(), rec);
+        return true;
+    };
+
+    for(auto &entry : parser.GlobalVariableMap) {
+        VarRecord rec;
+        if(!makeVarRecord(entry.second, rec))
+            return false;
+        globals.push_back(rec);
+    }
+    for(auto &entry : parser.FuncDefMap) {
+        FuncAST *func = entry.second;
+        FuncRecord rec;
+        std::memset(&rec, 0, sizeof(rec));
+        rec.Name = addString(func->getFuncSymbol());
+        rec.RetType = getTypeCode(func->getRetType());
+        rec.Flags = func->isFuncDeclare() ? 0 : FuncDefined;
+        rec.FirstParam = params.size();
+        rec.ParamCount = func->getParams().size();
+        for(auto *param : func->getParams()) {
+            VarRecord paramRec;
+            if(!makeVarRecord(param->getId(), paramRec))
+                return false;
+            params.push_back(paramRec);
+        }
+        funcs.push_back(rec);
+    }
+
+    /// the header and records are multiples of 8 bytes, so the dims
+    /// stay 8 byte aligned
+    InterfaceHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.Magic = Magic;
+    header.Version = Version;
+    header.FuncCount = funcs.size();
+    header.GlobalCount = globals.size();
+    header.ParamCount = params.size();
+    header.DimCount = dims.size();
+    header.StringSize = strings.size();
+
+    out.clear();
+    out.append((const char *)&header, sizeof(header));
+    appendRecords(out, funcs);
+    appendRecords(out, globals);
+    appendRecords(out, params);
+    appendRecords(out, dims);
+    out.append(strings);
+    return true;
+}
+/// ----------------------------------------------------------------
+
+
+/// ----------------------------------------------------------------
+bool ModuleInterface::read(GrammarParser &parser, const char *data, size_t size) {
+    InterfaceHeader header;
+    if(size < sizeof(header))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+    if(header.Magic != Magic || header.Version != Version)
+        return false;
+
+    uint64_t funcOffset  = sizeof(header);
+    uint64_t varOffset   = funcOffset + (uint64_t)header.FuncCount * sizeof(FuncRecord);
+    uint64_t dimOffset   = varOffset + ((uint64_t)header.GlobalCount + header.ParamCount) * sizeof(VarRecord);
+    uint64_t strOffset   = dimOffset + (uint64_t)header.DimCount * sizeof(int64_t);
+    if(strOffset + header.StringSize != size)
+        return false;
+    if(header.StringSize && data[size - 1] != '\0')
+        return false;
+
+    /// the records are read in place, the buffer is mapped or allocated,
+    /// both aligned enough for them
+    auto *funcs   = (const FuncRecord *)(data + funcOffset);
+    auto *globals = (const VarRecord *)(data + varOffset);
+    auto *params  = globals + header.GlobalCount;
+    auto *dims    = (const int64_t *)(data + dimOffset);
+    const char *strings = data + strOffset;
+
+    ProgramAST *prog = parser.ProgAst;
+    LineNo line = {prog->getLineNo()->FileIndex, 0, 0};
+
+    auto getName = [&](uint32_t offset, Symbol &name) {
+        if(offset >= header.StringSize)
+            return false;
+        name = Symbol::intern(strings + offset);
+        return true;
+    };
+    auto getType = [&](uint8_t code, ASTBase *parent, DataTypeAST *&type) {
+        if(code == NoType) {
+            type = nullptr;
+            return true;
+        }
+        if(code > Pointer)
+            return false;
+        type = parser.createNode<DataTypeAST>(line, parent, (KType)code);
+        return true;
+    };
+    auto makeVar = [&](const VarRecord &rec, ASTBase *parent) -> VariableAST * {
+        Symbol name;
+        DataTypeAST *type;
+        if(!getName(rec.Name, name) || (uint64_t)rec.FirstDim + rec.DimCount > header.DimCount)
+            return nullptr;
+        auto *var = parser.createNode<VariableAST>(line, parent, name);
+        if(!getType(rec.Type, var, type))
+            return nullptr;
+        var->setDataType(type);
+        if(rec.Flags & VarConst)  var->setIsConst();
+        if(rec.Flags & VarStatic) var->setIsStatic();
+        if(rec.Flags & VarExtern) var->setIsExtern();
+        for(uint32_t i = 0; i < rec.DimCount; i++) {
+            auto *dim = parser.createNode<NumberExprAST>(line, var, (long long)dims[rec.FirstDim + i]);
+            dim->setIsSigned(true);
+            var->addDims(dim);
+        }
+        switch(rec.Kind) {
+            case NoValue: break;
+            case IntValue: {
+                auto *value = parser.createNode<NumberExprAST>(line, var, (long long)rec.Value.IntVal);
+                value->setIsSigned(rec.Flags & ValueSigned);
+                var->setInitExpr(value);
+                break;
+            }
+            case DoubleValue: var->setInitExpr(parser.createNode<NumberExprAST>(line, var, rec.Value.DoubleVal)); break;
+            case CharValue:   var->setInitExpr(parser.createNode<NumberExprAST>(line, var, (char)rec.Value.IntVal)); break;
+            case BoolValue:   var->setInitExpr(parser.createNode<NumberExprAST>(line, var, rec.Value.IntVal != 0)); break;
+            default: return nullptr;
+        }
+        return var;
+    };
+
+    /// the globals share one declaration, so they are found to be global
+    /// by the walk to their program as the parsed ones
+    auto *decl = parser.createNode<DataDeclAST>(line, prog);
+    for(uint32_t i = 0; i < header.GlobalCount; i++) {
+        VariableAST *var = makeVar(globals[i], decl);
+        if(!var)
+            return false;
+        decl->addVarDecl(var);
+        parser.GlobalVariableMap.insert({var->getSymbol(), var});
+    }
+
+    for(uint32_t i = 0; i < header.FuncCount; i++) {
+        const FuncRecord &rec = funcs[i];
+        Symbol name;
+        DataTypeAST *retType;
+        if(!getName(rec.Name, name) || (uint64_t)rec.FirstParam + rec.ParamCount > header.ParamCount)
+            return false;
+        auto *func = parser.createNode<FuncAST>(line, prog, name);
+        if(!getType(rec.RetType, func, retType))
+            return false;
+        func->setRetType(retType);
+        for(uint32_t j = 0; j < rec.ParamCount; j++) {
+            auto *param = parser.createNode<ParamAST>(line, func, nullptr);
+            VariableAST *var = makeVar(params[rec.FirstParam + j], param);
+            if(!var)
+                return false;
+            param->setId(var);
+            func->addFuncParam(param);
+        }
+        /// a defined function keep an empty body, so an importer which
+        /// define the same name is told it is redefined
+        if(rec.Flags & FuncDefined)
+            func->setBlockStmt(parser.createNode<BlockStmtAST>(line, func));
+        parser.FuncDefMap.insert({name, func});
+    }
+    return true;
+}
+/// ----------------------------------------------------------------
+
+}
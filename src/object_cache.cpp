@@ -0,0 +1,217 @@
+
+#include "object_cache.h"
+#include "global_variable.h"
+#include "source_buffer.h"
+#include "module_interface.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <thread>
+#include <functional>
+#include <unordered_set>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Bump when the generated code change without the compiler binary change
+#ifndef KALE_COMPILER_VERSION
+#define KALE_COMPILER_VERSION "kalecc-1"
+#endif
+
+namespace kale {
+
+/// the compiler is identified by its version and the running binary, so
+/// a rebuilt kalecc never reuse the objects of the old one
+static const std::string &getCompilerId() {
+    static const std::string Id = [] {
+        std::string id = KALE_COMPILER_VERSION " llvm-" LLVM_VERSION_STRING;
+        struct stat st;
+        if(stat("/proc/self/exe", &st) == 0) {
+            id += " " + std::to_string(st.st_size) + " " + std::to_string(st.st_mtime);
+        }
+        return id;
+    }();
+    return Id;
+}
+
+/// -----------------------------------------------------
+/// @brief Code implication of class KaleObjectCache
+/// -----------------------------------------------------
+KaleObjectCache::KaleObjectCache(const std::string &dir, const std::string &kind)
+    : CacheDir(dir), Kind(kind) {
+    llvm::sys::fs::create_directories(CacheDir);
+}
+
+const std::string &KaleObjectCache::computeKey(ProgramAST *prog) {
+    auto it = Keys.find(prog);
+    if(it != Keys.end())
+        return it->second;
+
+    std::string key;
+    auto buffer = SourceBuffer::getFile(InputFileList[prog->getLineNo()->FileIndex]);
+    if(buffer) {
+        llvm::MD5 hash;
+        auto addField = [&hash](llvm::StringRef field) {
+            hash.update(field);
+            hash.update(llvm::ArrayRef<uint8_t>((const uint8_t *)"\0", 1));
+        };
+        addField(getCompilerId());
+        addField(Kind);
+        addField(llvm::sys::getDefaultTargetTriple());
+        addField(llvm::sys::getHostCPUName());
+        addField(std::to_string(OptLevel));
+        addField(llvm::StringRef(buffer->getBufferStart(), buffer->getBufferSize()));
+        bool depsKnown = true;
+        for(auto *dep : prog->getDependentProgs()) {
+            const std::string &depKey = computeKey(dep);
+            depsKnown &= !depKey.empty();
+            addField(depKey);
+        }
+        if(depsKnown) {
+            llvm::MD5::MD5Result result;
+            hash.final(result);
+            key = result.digest().str().str();
+        }
+    }
+    return Keys[prog] = key;
+}
+
+void KaleObjectCache::lookupPrograms(const std::vector<ProgramAST *> &progs) {
+    for(auto *prog : progs) {
+        const std::string &key = computeKey(prog);
+        Cached[prog] = !key.empty() && llvm::sys::fs::exists(getObjectPath(prog));
+    }
+}
+
+bool KaleObjectCache::isCached(ProgramAST *prog) const {
+    auto it = Cached.find(prog);
+    return it != Cached.end() && it->second;
+}
+
+std::string KaleObjectCache::getObjectPath(ProgramAST *prog) const {
+    auto it = Keys.find(prog);
+    if(it == Keys.end() || it->second.empty())
+        return "";
+    return CacheDir + "/" + it->second + ".o";
+}
+
+std::vector<ProgramAST *> KaleObjectCache::getProgramsToParse(const std::vector<ProgramAST *> &progs) const {
+    std::unordered_set<ProgramAST *> needed;
+    std::function<void(ProgramAST *)> mark = [&](ProgramAST *prog) {
+        if(!needed.insert(prog).second)
+            return;
+        for(auto *dep : prog->getDependentProgs()) {
+            mark(dep);
+        }
+    };
+    for(auto *prog : progs) {
+        if(!isCached(prog))
+            mark(prog);
+    }
+
+    std::vector<ProgramAST *> result;
+    for(auto *prog : progs) {
+        if(needed.count(prog))
+            result.push_back(prog);
+    }
+    return result;
+}
+
+std::vector<ProgramAST *> KaleObjectCache::getProgramsToCompile(const std::vector<ProgramAST *> &progs) const {
+    std::vector<ProgramAST *> result;
+    for(auto *prog : progs) {
+        if(!isCached(prog))
+            result.push_back(prog);
+    }
+    return result;
+}
+
+bool KaleObjectCache::writeFile(const std::string &path, llvm::StringRef data) {
+    /// write to a file of this thread then rename it, so a reader never
+    /// see a partial file even if many compilers share the cache
+    std::string tmpPath = path + ".tmp" + std::to_string(getpid()) + "_" +
+                          std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::error_code EC;
+        llvm::raw_fd_ostream out(tmpPath, EC, llvm::sys::fs::OF_None);
+        if(EC)
+            return false;
+        out << data;
+        out.close();
+        if(out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tmpPath);
+            return false;
+        }
+    }
+    if(llvm::sys::fs::rename(tmpPath, path)) {
+        llvm::sys::fs::remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+bool KaleObjectCache::store(ProgramAST *prog, llvm::StringRef object) {
+    std::string path = getObjectPath(prog);
+    if(path.empty())
+        return false;
+    return writeFile(path, object);
+}
+
+/// the interface has the key of the object, so it is up to date exactly
+/// when the object is
+std::string KaleObjectCache::getInterfacePath(ProgramAST *prog) const {
+    auto it = Keys.find(prog);
+    if(it == Keys.end() || it->second.empty())
+        return "";
+    return CacheDir + "/" + it->second + ".ki";
+}
+
+bool KaleObjectCache::loadInterface(ProgramAST *prog, GrammarParser *parser) const {
+    if(!isCached(prog))
+        return false;
+    auto buffer = SourceBuffer::getFile(getInterfacePath(prog));
+    if(!buffer)
+        return false;
+    return parser->generateFromInterface(buffer->getBufferStart(), buffer->getBufferSize());
+}
+
+bool KaleObjectCache::storeInterface(ProgramAST *prog, GrammarParser *parser) {
+    std::string path = getInterfacePath(prog);
+    if(path.empty() || llvm::sys::fs::exists(path))
+        return false;
+    std::string data;
+    if(!ModuleInterface::write(*parser, data))
+        return false;
+    return writeFile(path, data);
+}
+
+void KaleObjectCache::registerModule(const llvm::Module *M, ProgramAST *prog) {
+    std::lock_guard<std::mutex> guard(ModuleLock);
+    ModuleProgs[M] = prog;
+}
+
+void KaleObjectCache::notifyObjectCompiled(const llvm::Module *M, llvm::MemoryBufferRef Obj) {
+    ProgramAST *prog = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(ModuleLock);
+        auto it = ModuleProgs.find(M);
+        if(it == ModuleProgs.end())
+            return;
+        prog = it->second;
+        ModuleProgs.erase(it);
+    }
+    store(prog, Obj.getBuffer());
+}
+
+std::unique_ptr<llvm::MemoryBuffer> KaleObjectCache::getObject(const llvm::Module *) {
+    /// the cached programs are loaded as objects before any ir is generated
+    return nullptr;
+}
+/// -----------------------------------------------------
+
+}
@@ -3,6 +3,8 @@
 #include "error.h"
 #include "cast.h"
 #include "global_variable.h"
+#include "module_interface.h"
+#include "time_trace.h"
 
 
 #include <iostream>
@@ -10,12 +12,21 @@
 #include <cctype>
 #include <cstdlib>
 #include <cassert>
+#include <cstring>
+#include <cstdint>
 #include <vector>
 #include <map>
 #include <set>
 
 namespace kale {
 
+KALE_STATISTIC(ProgramsParsed,     "parser", "Number of programs parsed");
+KALE_STATISTIC(InterfacesRead,     "parser", "Number of programs read from their module interface");
+KALE_STATISTIC(TokensLexed,        "parser", "Number of tokens lexed");
+KALE_STATISTIC(SymbolTableLookups, "parser", "Number of symbol table lookups");
+KALE_STATISTIC(SymbolTableMisses,  "parser", "Number of symbol table lookups not found");
+KALE_STATISTIC(AstBytesAllocated,  "parser", "Bytes of ast nodes allocated in the arenas");
+
 /// -----------------------------------------------------
 /// @brief Code implication of class TokenParser
 /// -----------------------------------------------------
@@ -23,25 +34,41 @@ TokenParser::TokenParser(unsigned fileIndex){
     this->LineInfo = {fileIndex, 0, 0};
     this->DoubleNumVal = 0.0;
     this->IntNumVal = 0;
-    this->LiteralVal = "";
-    this->IdStr = "";
+    this->LiteralVal = {};
+    this->IdStr = {};
     this->LastChar = ' ';
+    this->IsSigned = true;
 
     if(fileIndex < InputFileList.size()) {
-        Handle = fopen(InputFileList[fileIndex].c_str(), "rt+");
-    }
-    else {
-        Handle = nullptr;
+        FileName = InputFileList[fileIndex];
+        Buffer = SourceBuffer::getFile(FileName);
     }
+
+    BufPtr = Buffer ? Buffer->getBufferStart() : nullptr;
+    BufEnd = Buffer ? Buffer->getBufferEnd() : nullptr;
+}
+
+TokenParser::TokenParser(unsigned fileIndex, std::unique_ptr<SourceBuffer> buffer, const std::string &fileName)
+    : TokenParser(-1u) {
+    LineInfo.FileIndex = fileIndex;
+    FileName = fileName;
+    Buffer = std::move(buffer);
+    BufPtr = Buffer ? Buffer->getBufferStart() : nullptr;
+    BufEnd = Buffer ? Buffer->getBufferEnd() : nullptr;
+}
+
+void TokenParser::reportError(const char *msg, const LineNo &line) {
+    ErrorMessages.push_back(FileName + ":" + std::to_string(line.Row) + "-" + std::to_string(line.Col) + " " + msg);
+    ErrorCount++;
 }
 
 bool TokenParser::openSuccess() {
-    return Handle != nullptr;
+    return Buffer != nullptr;
 }
 
 
 void TokenParser::getChar() {
-    LastChar = fgetc(Handle);
+    LastChar = BufPtr != BufEnd ? (unsigned char)*BufPtr++ : EOF;
     if(LastChar == '\n') {
         LineInfo.Row++; LineInfo.Col = 0;
     }
@@ -50,14 +77,47 @@ void TokenParser::getChar() {
     }
 }
 
-static std::map<std::string, Token> KeyWordTkMap = {
-    {"def", tok_def}, {"extern", tok_extern}, {"if", tok_if}, {"for", tok_for}, {"while", tok_while},
-    {"else", tok_else}, {"then", tok_then}, {"in", tok_in}, {"return", tok_return}, {"continue", tok_continue},
-    {"break", tok_break}, {"struct", tok_struct}, {"switch", tok_switch}, {"case", tok_case}, {"default", tok_default},
-    {"true", tok_true}, {"false", tok_false}, {"void", tok_void}, {"bool", tok_bool}, {"char", tok_char}, {"uchar", tok_uchar},
-    {"short", tok_short}, {"ushort", tok_ushort}, {"int", tok_int}, {"uint", tok_uint}, {"long", tok_long},
-    {"ulong", tok_ulong}, {"float", tok_float}, {"double", tok_double}, {"import", tok_import}, {"const", tok_const}
-};
+static constexpr unsigned keyWordKey(size_t len, char c) {
+    return (unsigned)(len << 8) | (unsigned char)c;
+}
+
+Token TokenParser::matchKeyword(std::string_view id) {
+    /// dispatch by length and first character, then only compare the rest
+    /// characters of the few candidates, no allocation and no map walk
+#define KEYWORD(STR, TOK) if(memcmp(id.data() + 1, STR + 1, sizeof(STR) - 2) == 0) return TOK;
+    if(id.empty() || id.size() > 8)
+        return tok_id;
+    switch (keyWordKey(id.size(), id[0])) {
+        case keyWordKey(2, 'i'): { KEYWORD("if", tok_if) KEYWORD("in", tok_in) break; }
+        case keyWordKey(3, 'd'): { KEYWORD("def", tok_def) break; }
+        case keyWordKey(3, 'f'): { KEYWORD("for", tok_for) break; }
+        case keyWordKey(3, 'i'): { KEYWORD("int", tok_int) break; }
+        case keyWordKey(4, 'b'): { KEYWORD("bool", tok_bool) break; }
+        case keyWordKey(4, 'c'): { KEYWORD("case", tok_case) KEYWORD("char", tok_char) break; }
+        case keyWordKey(4, 'e'): { KEYWORD("else", tok_else) break; }
+        case keyWordKey(4, 'l'): { KEYWORD("long", tok_long) break; }
+        case keyWordKey(4, 't'): { KEYWORD("then", tok_then) KEYWORD("true", tok_true) break; }
+        case keyWordKey(4, 'u'): { KEYWORD("uint", tok_uint) break; }
+        case keyWordKey(4, 'v'): { KEYWORD("void", tok_void) break; }
+        case keyWordKey(5, 'b'): { KEYWORD("break", tok_break) break; }
+        case keyWordKey(5, 'c'): { KEYWORD("const", tok_const) break; }
+        case keyWordKey(5, 'f'): { KEYWORD("false", tok_false) KEYWORD("float", tok_float) break; }
+        case keyWordKey(5, 's'): { KEYWORD("short", tok_short) break; }
+        case keyWordKey(5, 'u'): { KEYWORD("uchar", tok_uchar) KEYWORD("ulong", tok_ulong) break; }
+        case keyWordKey(5, 'w'): { KEYWORD("while", tok_while) break; }
+        case keyWordKey(6, 'd'): { KEYWORD("double", tok_double) break; }
+        case keyWordKey(6, 'e'): { KEYWORD("extern", tok_extern) break; }
+        case keyWordKey(6, 'i'): { KEYWORD("import", tok_import) break; }
+        case keyWordKey(6, 'r'): { KEYWORD("return", tok_return) break; }
+        case keyWordKey(6, 's'): { KEYWORD("struct", tok_struct) KEYWORD("switch", tok_switch) break; }
+        case keyWordKey(6, 'u'): { KEYWORD("ushort", tok_ushort) break; }
+        case keyWordKey(7, 'd'): { KEYWORD("default", tok_default) break; }
+        case keyWordKey(8, 'c'): { KEYWORD("continue", tok_continue) break; }
+        default: break;
+    }
+#undef KEYWORD
+    return tok_id;
+}
 
 
 Token TokenParser::getToken() {
@@ -81,16 +141,16 @@ Token TokenParser::getToken() {
 
     /// parse import "xxx.k"
     if(LastChar == '\"') {
-        LiteralVal = "";
         getChar();
+        const char *start = getCurCharPtr();
         // @TODO need to import check
-        while(LastChar != '\"') {
-            LiteralVal += (char)LastChar;
+        while(LastChar != '\"' && LastChar != EOF) {
             getChar();
             // if(LastChar == '\n' || LastChar == ' ' || LastChar == '\r') {
             //     LOG_ERROR("Illigal character in import literal \'%c\'", LineInfo, LastChar);
             // }
         }
+        LiteralVal = std::string_view(start, getCurCharPtr() - start);
         getChar();
         return tok_literal;
     }
@@ -115,35 +175,29 @@ Token TokenParser::getToken() {
 
     // identifier: [a-zA-Z][a-zA-Z0-9]*
     if(isalpha(LastChar)) {
-        IdStr = LastChar;
+        const char *start = getCurCharPtr();
         getChar();
         while(isalnum((LastChar))) {
-            IdStr += LastChar;
             getChar();
         }
-
-        auto it = KeyWordTkMap.find(IdStr);
-
-        if(it == KeyWordTkMap.end())
-            return tok_id;
-        return KeyWordTkMap[IdStr];
+        IdStr = std::string_view(start, getCurCharPtr() - start);
+        return matchKeyword(IdStr);
     } 
 
     if (isdigit(LastChar)) {
         IsSigned = true;
-        std::string NumStr = "";
+        const char *start = getCurCharPtr();
 
         bool isFloat = false;
-//        NumStr += LastChar;
         do {
-            NumStr += LastChar;
             getChar();
             if(LastChar == '.')
                 isFloat = true;
         } while(isdigit(LastChar) || LastChar == '.');
 
+        std::string_view NumStr(start, getCurCharPtr() - start);
         if(isFloat) {
-            DoubleNumVal = strtod(NumStr.c_str(), nullptr);
+            DoubleNumVal = strtod(std::string(NumStr).c_str(), nullptr);
             return tok_fnumber;
         }
 
@@ -152,7 +206,13 @@ Token TokenParser::getToken() {
             IsSigned = false;
         }
 
-        IntNumVal = atoll(NumStr.c_str());
+        /// accumulate unsigned, a literal out of the range wraps instead of
+        /// the signed overflow, and the bits of a big unsigned literal are kept
+        uint64_t val = 0;
+        for(char c : NumStr) {
+            val = val * 10 + (uint64_t)(c - '0');
+        }
+        IntNumVal = (long long)val;
         return tok_inumber;
     }
 
@@ -240,60 +300,218 @@ Token TokenParser::getToken() {
 }
 
 
-std::vector<Token> TokenParser::lookUp(unsigned n) {
-    std::vector<Token> LookUpToks;
-    int CurrentLoc = ftell(Handle);
-    int SavedChar = LastChar;
-    LineNo preNo = LineInfo;
-    
-    int i = 0, tok;
-    while (i < n) {
-        tok = getToken();
-        LookUpToks.push_back((Token)tok);
-        if(tok == tok_eof)
-            break;
-        i++;
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// @brief Code implication of class TokenStream
+/// -----------------------------------------------------
+TokenStream::TokenStream(TokenParser *lexer) : Lexer(lexer), Head(0), Count(0) {
+    CurTok = {tok_eof, lexer->getCurLineNo(), {}, Symbol(), 0, 0.0, true};
+}
+
+void TokenStream::lexOneToken() {
+    assert(Count < RingSize && "token ring is full");
+    TokenInfo &info = Ring[(Head + Count) & (RingSize - 1)];
+    info.Kind = Lexer->getToken();
+    TokenCount++;
+    info.EndLoc = Lexer->getCurLineNo();
+    switch (info.Kind) {
+        case tok_id:        { info.Str = Lexer->getIdStr(); info.Sym = Symbol::intern(info.Str); break; }
+        case tok_literal:   { info.Str = Lexer->getLiteral(); break; }
+        case tok_inumber:
+        case tok_charlit:   { info.IntVal = Lexer->getIntVal(); info.IsSigned = Lexer->isSigned(); break; }
+        case tok_fnumber:   { info.DoubleVal = Lexer->getDoubleVal(); break; }
+        default: break;
+    }
+    Count++;
+}
+
+Token TokenStream::getNextToken() {
+    if(Count == 0)
+        lexOneToken();
+    CurTok = Ring[Head];
+    Head = (Head + 1) & (RingSize - 1);
+    Count--;
+    return CurTok.Kind;
+}
+
+Token TokenStream::lookUp(unsigned n) {
+    assert(n >= 1 && n <= RingSize && "look up out of the token ring");
+    while(Count < n)
+        lexOneToken();
+    return Ring[(Head + n - 1) & (RingSize - 1)].Kind;
+}
+
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// @brief Code implication of class ExportIndex
+/// -----------------------------------------------------
+const ExportIndex::FuncEntry *ExportIndex::findFunc(Symbol name) const {
+    VisitedSet visited;
+    return findFunc(name, visited);
+}
+
+const ExportIndex::VarEntry *ExportIndex::findVar(Symbol name) const {
+    VisitedSet visited;
+    return findVar(name, visited);
+}
+
+/// the imports are walked depth first in import order, an index already
+/// walked has not the name, so each index is walked once on a diamond
+const ExportIndex::FuncEntry *ExportIndex::findFunc(Symbol name, VisitedSet &visited) const {
+    auto it = Funcs.find(name);
+    if(it != Funcs.end())
+        return &it->second;
+    visited.insert(this);
+    for(auto *dep : Deps) {
+        if(visited.count(dep))
+            continue;
+        if(auto *entry = dep->findFunc(name, visited))
+            return entry;
     }
-    
-    fseek(Handle, CurrentLoc, SEEK_SET);  
-    
-    LastChar = SavedChar;
-    LineInfo = preNo;
+    return nullptr;
+}
+
+const ExportIndex::VarEntry *ExportIndex::findVar(Symbol name, VisitedSet &visited) const {
+    auto it = Vars.find(name);
+    if(it != Vars.end())
+        return &it->second;
+    visited.insert(this);
+    if(HiddenVars.count(name))
+        return nullptr;
+    for(auto *dep : Deps) {
+        if(visited.count(dep))
+            continue;
+        if(auto *entry = dep->findVar(name, visited))
+            return entry;
+    }
+    return nullptr;
+}
+
+void ExportIndex::clear() {
+    Funcs.clear();
+    Vars.clear();
+    HiddenVars.clear();
+    Deps.clear();
+}
+/// -----------------------------------------------------
 
-    return LookUpToks;   
+
+/// -----------------------------------------------------
+/// @brief Code implication of class ScopedSymbolTable
+/// -----------------------------------------------------
+void ScopedSymbolTable::leaveScope() {
+    assert(!ScopeMarks.empty() && "leave scope without enter");
+    unsigned mark = ScopeMarks.back();
+    ScopeMarks.pop_back();
+    while(Entries.size() > mark) {
+        Entry &entry = Entries.back();
+        Heads[entry.Name.getId()] = entry.Shadowed;
+        Entries.pop_back();
+    }
 }
 
+bool ScopedSymbolTable::insert(Symbol name, VariableAST *var) {
+    assert(!ScopeMarks.empty() && "insert local variable in global scope");
+    int head = getHead(name);
+    if(head >= 0 && (unsigned)head >= ScopeMarks.back())
+        return false;
+    if(name.getId() >= Heads.size())
+        Heads.resize(name.getId() + 1, -1);
+    Entries.push_back({name, var, head});
+    Heads[name.getId()] = Entries.size() - 1;
+    return true;
+}
 /// -----------------------------------------------------
 
 
 /// -----------------------------------------------------
 /// @brief Code implication of class GrammarParser
 /// -----------------------------------------------------
+/// the std function names interned once, so checking whether a call
+/// is a std call is an integer lookup
+static bool isStdFunction(Symbol name) {
+    static const std::unordered_set<Symbol> StdFunctionSymbols = [] {
+        std::unordered_set<Symbol> symbols;
+        for(auto &funcName : StdFunctionSet)
+            symbols.insert(Symbol::intern(funcName));
+        return symbols;
+    }();
+    return StdFunctionSymbols.count(name) != 0;
+}
+
 GrammarParser::GrammarParser(ProgramAST *prog) {
     ProgAst = prog;
-    SymTabMap = {};
     GlobalVariableMap = {};
     TkParser = new TokenParser(prog->getLineNo()->FileIndex);
+    TkStream = new TokenStream(TkParser);
+}
+
+GrammarParser::GrammarParser(ProgramAST *prog, std::unique_ptr<SourceBuffer> buffer, const std::string &fileName) {
+    ProgAst = prog;
+    GlobalVariableMap = {};
+    TkParser = new TokenParser(prog->getLineNo()->FileIndex, std::move(buffer), fileName);
+    TkStream = new TokenStream(TkParser);
+}
+
+GrammarParser::~GrammarParser() {
+    delete TkStream;
+    delete TkParser;
 }
 
 void GrammarParser::generateSrcToAst() {
     NodeStack.clear();
-    parseProgram();
+    buildImportIndex();
+    try {
+        parseProgram();
+    }
+    catch(const SyntaxError &) {
+        /// the error is kept by the token parser, the ast is left half built
+        /// in the arena and is never visited
+    }
+    buildExportIndex();
+    ++ProgramsParsed;
+    addStatistics();
+}
+
+bool GrammarParser::generateFromInterface(const char *data, size_t size) {
+    NodeStack.clear();
+    buildImportIndex();
+    if(!ModuleInterface::read(*this, data, size)) {
+        /// the nodes already created stay in the arena until it is released
+        FuncDefMap.clear();
+        GlobalVariableMap.clear();
+        return false;
+    }
+    buildExportIndex();
+    ++InterfacesRead;
+    addStatistics();
+    return true;
+}
 
+void GrammarParser::addStatistics() {
+    TokensLexed += TkStream->getTokenCount();
+    SymbolTableLookups += SymbolLookups;
+    SymbolTableMisses += SymbolLookupMisses;
+    AstBytesAllocated += ProgAst->getArena().getBytesAllocated();
+    KaleStatistics::addAstNodes(NodeCounts);
 }
 
 void GrammarParser::getNextToken() {
-    CurTok = TkParser->getToken();
+    CurTok = TkStream->getNextToken();
 }
 
 void GrammarParser::parseProgram() {
 
     assert(ProgAst && "Program ast can't be nullptr");
     NodeStack.push_back(ProgAst);
-    while(TkParser->lookUp(1)[0] != tok_eof) {
-        switch(TkParser->lookUp(1)[0]) {
+    while(TkStream->lookUp(1) != tok_eof) {
+        switch(TkStream->lookUp(1)) {
             case tok_extern: {
-                switch(TkParser->lookUp(2)[1]) {
+                switch(TkStream->lookUp(2)) {
                     case tok_id: {
                         ProgAst->addCompElem(parseFuncExtern());
                         break;
@@ -323,7 +541,7 @@ void GrammarParser::parseProgram() {
 }
 
 DataTypeAST *GrammarParser::parseTypeDecl() {
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     KType datatype;
     getNextToken();
     switch (CurTok)
@@ -342,34 +560,34 @@ DataTypeAST *GrammarParser::parseTypeDecl() {
     case tok_ulong:     { datatype = ULong;break;    }
     case tok_struct:    { datatype = Struct;break;   }
     default:
-        LOG_ERROR("unsupport type declare", TkParser->getCurLineNo())
+        LOG_ERROR("unsupport type declare", TkStream->getCurLineNo())
     }
-    return new DataTypeAST(line, NodeStack.back(), datatype);
+    return createNode<DataTypeAST>(line, NodeStack.back(), datatype);
 }
 
 
 DataDeclAST *GrammarParser::parseVarExtern()   {
 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     // eat extern
     getNextToken();
 
-    DataDeclAST *Decl = new DataDeclAST(line, NodeStack.back());
+    DataDeclAST *Decl = createNode<DataDeclAST>(line, NodeStack.back());
 
     bool isConst = false;
-    if(TkParser->lookUp(1)[0] == tok_const) {
+    if(TkStream->lookUp(1) == tok_const) {
         getNextToken();
         isConst = true;
     }
 
     DataTypeAST *type = parseTypeDecl();
-    if(TkParser->lookUp(1)[0] != tok_id) {
-        LOG_ERROR("without any data decl!", TkParser->getCurLineNo())
+    if(TkStream->lookUp(1) != tok_id) {
+        LOG_ERROR("without any data decl!", TkStream->getCurLineNo())
     }
 
-    while(TkParser->lookUp(1)[0] != ';') {
+    while(TkStream->lookUp(1) != ';') {
         
-        line = TkParser->getCurLineNo();
+        line = TkStream->getCurLineNo();
         // eat id
         getNextToken();
 
@@ -377,21 +595,21 @@ DataDeclAST *GrammarParser::parseVarExtern()   {
             LOG_ERROR("Illegal variable extern declare", line)
         }
 
-        auto *var = new VariableAST(line, Decl, TkParser->getIdStr());
+        auto *var = createNode<VariableAST>(line, Decl, TkStream->getIdSymbol());
         if(isConst) var->setIsConst();
         var->setIsExtern();
         var->setDataType(type);
 
         NodeStack.push_back(var);
-        while(TkParser->lookUp(1)[0] == '[') {
+        while(TkStream->lookUp(1) == '[') {
             // eat '['
             getNextToken();
             
-            line = TkParser->getCurLineNo();
+            line = TkStream->getCurLineNo();
 
             var->addDims(parseExpr());
 
-            if(TkParser->lookUp(1)[0] != ']'){
+            if(TkStream->lookUp(1) != ']'){
                 LOG_ERROR("not have dim declare", line)
             }
 
@@ -401,7 +619,7 @@ DataDeclAST *GrammarParser::parseVarExtern()   {
         NodeStack.pop_back();
         Decl->addVarDecl(var);
         insertVariableToVarMap(var);
-        if(TkParser->lookUp(1)[0] == ',') {
+        if(TkStream->lookUp(1) == ',') {
             getNextToken();
         }
     }
@@ -410,7 +628,7 @@ DataDeclAST *GrammarParser::parseVarExtern()   {
     getNextToken();
 
     if(CurTok != ';') {
-        LOG_ERROR("missing ';'", TkParser->getCurLineNo())
+        LOG_ERROR("missing ';'", TkStream->getCurLineNo())
     }
 
     return Decl;
@@ -418,31 +636,31 @@ DataDeclAST *GrammarParser::parseVarExtern()   {
 
 
 FuncAST *GrammarParser::parseFuncExtern()  {
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     // eat extern
     getNextToken();
     // eat id
     getNextToken();
-    FuncAST *funcExtern = new FuncAST(line, NodeStack.back(), TkParser->getIdStr());
+    FuncAST *funcExtern = createNode<FuncAST>(line, NodeStack.back(), TkStream->getIdSymbol());
 
     NodeStack.push_back(funcExtern);
     // parse params
-    if(TkParser->lookUp(1)[0] != '(') {
-        LOG_ERROR("missing '(' in function extern", TkParser->getCurLineNo());
+    if(TkStream->lookUp(1) != '(') {
+        LOG_ERROR("missing '(' in function extern", TkStream->getCurLineNo());
     }
 
     // eat '('
     getNextToken();
     enterNewSymTab();
-    while(TkParser->lookUp(1)[0] != ')') {
+    while(TkStream->lookUp(1) != ')') {
         funcExtern->addFuncParam(parseParamDecl());
-        unsigned lookUp = TkParser->lookUp(1)[0];
+        unsigned lookUp = TkStream->lookUp(1);
         if(lookUp == ',') {
             // eat ','
             getNextToken();
         }
         else if(lookUp != ')') {
-            LOG_ERROR("missing ')' in function decl", TkParser->getCurLineNo());
+            LOG_ERROR("missing ')' in function decl", TkStream->getCurLineNo());
         }
     }
     leaveCurSymTab();
@@ -450,17 +668,17 @@ FuncAST *GrammarParser::parseFuncExtern()  {
     // eat ')'
     getNextToken();
 
-    if(TkParser->lookUp(1)[0] == ':') {
+    if(TkStream->lookUp(1) == ':') {
         getNextToken();
         funcExtern->setRetType(parseTypeDecl());
     }
     else {
-        auto *retTy = new DataTypeAST(*funcExtern->getLineNo(), funcExtern, Void);
+        auto *retTy = createNode<DataTypeAST>(*funcExtern->getLineNo(), funcExtern, Void);
         funcExtern->setRetType(retTy);
     }
 
-    if(TkParser->lookUp(1)[0] != ';') {
-        LOG_ERROR("missing ';'", TkParser->getCurLineNo())
+    if(TkStream->lookUp(1) != ';') {
+        LOG_ERROR("missing ';'", TkStream->getCurLineNo())
     }
 
     // eat ';'
@@ -474,22 +692,22 @@ FuncAST *GrammarParser::parseFuncExtern()  {
 
 DataDeclAST *GrammarParser::parseVarDef() {
 
-    LineNo line = TkParser->getCurLineNo();
-    DataDeclAST *Decl = new DataDeclAST(line, NodeStack.back());
+    LineNo line = TkStream->getCurLineNo();
+    DataDeclAST *Decl = createNode<DataDeclAST>(line, NodeStack.back());
 
     bool isConst = false;
-    if(TkParser->lookUp(1)[0] == tok_const) {
+    if(TkStream->lookUp(1) == tok_const) {
         getNextToken();
         isConst = true;
     }
     DataTypeAST *type = parseTypeDecl();
-    if(TkParser->lookUp(1)[0] != tok_id) {
-        LOG_ERROR("without any data decl!", TkParser->getCurLineNo());
+    if(TkStream->lookUp(1) != tok_id) {
+        LOG_ERROR("without any data decl!", TkStream->getCurLineNo());
     }
 
-    while(TkParser->lookUp(1)[0] != ';') {
+    while(TkStream->lookUp(1) != ';') {
 
-        line = TkParser->getCurLineNo();
+        line = TkStream->getCurLineNo();
         // eat id
         getNextToken();
 
@@ -497,27 +715,27 @@ DataDeclAST *GrammarParser::parseVarDef() {
             LOG_ERROR("Illegal variable extern declare", line);
         }
 
-        VariableAST *var = new VariableAST(line, Decl, TkParser->getIdStr());
+        VariableAST *var = createNode<VariableAST>(line, Decl, TkStream->getIdSymbol());
         if(isConst) var->setIsConst();
         var->setDataType(type);
 
         NodeStack.push_back(var);
-        while(TkParser->lookUp(1)[0] == '[') {
+        while(TkStream->lookUp(1) == '[') {
             // eat '['
             getNextToken();
 
-            line = TkParser->getCurLineNo();
+            line = TkStream->getCurLineNo();
 
             var->addDims(parseExpr());
 
-            if(TkParser->lookUp(1)[0] != ']'){
+            if(TkStream->lookUp(1) != ']'){
                 LOG_ERROR("not have dim declare", line)
             }
 
             getNextToken();
         }
 
-        if(TkParser->lookUp(1)[0] == tok_assign) {
+        if(TkStream->lookUp(1) == tok_assign) {
             getNextToken();
             var->setInitExpr(parseInitExpr());
         }
@@ -525,7 +743,7 @@ DataDeclAST *GrammarParser::parseVarDef() {
         NodeStack.pop_back();
         Decl->addVarDecl(var);
         insertVariableToVarMap(var);
-        if(TkParser->lookUp(1)[0] == ',') {
+        if(TkStream->lookUp(1) == ',') {
             getNextToken();
         }
     }
@@ -534,7 +752,7 @@ DataDeclAST *GrammarParser::parseVarDef() {
     getNextToken();
 
     if(CurTok != ';') {
-        LOG_ERROR("missing ';'", TkParser->getCurLineNo())
+        LOG_ERROR("missing ';'", TkStream->getCurLineNo())
     }
 
     return Decl;
@@ -542,19 +760,19 @@ DataDeclAST *GrammarParser::parseVarDef() {
 
 
 ExprAST *GrammarParser::parseInitExpr()    {
-    if(TkParser->lookUp(1)[0] == '{') {
-        InitializedAST *init = new InitializedAST(TkParser->getCurLineNo(), NodeStack.back());
+    if(TkStream->lookUp(1) == '{') {
+        InitializedAST *init = createNode<InitializedAST>(TkStream->getCurLineNo(), NodeStack.back());
         // eat '{'
         NodeStack.push_back(init);
-        while(TkParser->lookUp(1)[0] != '}') {
-            if(TkParser->lookUp(1)[0] == '{') {
-                init->setInitExpr(dynamic_cast<InitializedAST*>(parseInitExpr()));
+        while(TkStream->lookUp(1) != '}') {
+            if(TkStream->lookUp(1) == '{') {
+                init->setInitExpr(dyn_cast_or_null<InitializedAST>(parseInitExpr()));
             }
             else{
                 init->setExpr(parseExpr());
             }
 
-            if(TkParser->lookUp(1)[0] == ',')
+            if(TkStream->lookUp(1) == ',')
                 getNextToken();
         }
         NodeStack.pop_back();
@@ -568,51 +786,52 @@ ExprAST *GrammarParser::parseInitExpr()    {
 
 
 FuncAST *GrammarParser::parseFuncDef()     {
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
 
     // eat def
     getNextToken();
 
     // eat id
     getNextToken();
+    KaleTimeTraceScope scope("ParseFunction", TkStream->getIdSymbol().str());
 
-    FuncAST *funcDef = new FuncAST(line, NodeStack.back(), TkParser->getIdStr());
+    FuncAST *funcDef = createNode<FuncAST>(line, NodeStack.back(), TkStream->getIdSymbol());
     enterNewSymTab();
     IsFuncScope = true;
     // parse params
-    if(TkParser->lookUp(1)[0] != '(') {
-        LOG_ERROR("missing '(' in function extern", TkParser->getCurLineNo());
+    if(TkStream->lookUp(1) != '(') {
+        LOG_ERROR("missing '(' in function extern", TkStream->getCurLineNo());
     }
 
     NodeStack.push_back((ASTBase*)funcDef);
     // eat '('
     getNextToken();
-    while(TkParser->lookUp(1)[0] != ')') {
+    while(TkStream->lookUp(1) != ')') {
         funcDef->addFuncParam(parseParamDecl());
-        unsigned lookUp = TkParser->lookUp(1)[0];
+        unsigned lookUp = TkStream->lookUp(1);
         if(lookUp == ',') {
             // eat ','
             getNextToken();
         }
         else if(lookUp != ')') {
-            LOG_ERROR("missing ')' in function decl", TkParser->getCurLineNo());
+            LOG_ERROR("missing ')' in function decl", TkStream->getCurLineNo());
         }
     }
 
     // eat ')'
     getNextToken();
 
-    if(TkParser->lookUp(1)[0] == ':') {
+    if(TkStream->lookUp(1) == ':') {
         getNextToken();
         funcDef->setRetType(parseTypeDecl());
     }
     else {
-        auto *retTy = new DataTypeAST(*funcDef->getLineNo(), funcDef, Void);
+        auto *retTy = createNode<DataTypeAST>(*funcDef->getLineNo(), funcDef, Void);
         funcDef->setRetType(retTy);
     }
     if(!insertFunctionToFuncMap(funcDef)) {
-        std::cerr << "Redefine this function '" << funcDef->getFuncName() << "'" << std::endl;
-        exit(-1);
+        std::string msg = "redefine this function '" + funcDef->getFuncName() + "'";
+        reportError(msg.c_str(), *funcDef->getLineNo());
     }
     funcDef->setBlockStmt(parseBlockStmt());
     NodeStack.pop_back();
@@ -638,11 +857,11 @@ ASTBase *GrammarParser::parseParamList()   { return nullptr; }
 
 ParamAST *GrammarParser::parseParamDecl()   {
 
-    LineNo line = TkParser->getCurLineNo();
-    ParamAST *param = new ParamAST(line, NodeStack.back(), nullptr);
+    LineNo line = TkStream->getCurLineNo();
+    ParamAST *param = createNode<ParamAST>(line, NodeStack.back(), nullptr);
     bool isConst = false;
 
-    if(TkParser->lookUp(1)[0] == tok_const) {
+    if(TkStream->lookUp(1) == tok_const) {
         getNextToken();
         isConst = true;
     }
@@ -652,22 +871,22 @@ ParamAST *GrammarParser::parseParamDecl()   {
 
     // eat id
     getNextToken();
-    VariableAST *var = new VariableAST(line, param, TkParser->getIdStr());
+    VariableAST *var = createNode<VariableAST>(line, param, TkStream->getIdSymbol());
     var->setDataType(datatype);
     NodeStack.push_back(var);
-    while(TkParser->lookUp(1)[0] == '[') {
+    while(TkStream->lookUp(1) == '[') {
         // eat '['
         getNextToken();
         var->addDims(parseExpr());
 
-        if(TkParser->lookUp(1)[0] != ']') {
-            LOG_ERROR("missing ']' in param decl", TkParser->getCurLineNo());
+        if(TkStream->lookUp(1) != ']') {
+            LOG_ERROR("missing ']' in param decl", TkStream->getCurLineNo());
         }
         // eat ']'
         getNextToken();
     }
 
-    if(TkParser->lookUp(1)[0] == tok_assign) {
+    if(TkStream->lookUp(1) == tok_assign) {
         var->setInitExpr(parseInitExpr());
     }
 
@@ -682,7 +901,7 @@ ParamAST *GrammarParser::parseParamDecl()   {
 
 StatementAST *GrammarParser::parseStmt() {
 
-    int tk = TkParser->lookUp(1)[0];
+    int tk = TkStream->lookUp(1);
     switch(tk) {
         case tok_return: {
             return parseReturnStmt();
@@ -734,13 +953,13 @@ BlockStmtAST *GrammarParser::parseBlockStmt()   {
     else {
         IsFuncScope = false;
     }
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     // eat '{'
     getNextToken();
 
-    BlockStmtAST *block = new BlockStmtAST(line, NodeStack.back());
+    BlockStmtAST *block = createNode<BlockStmtAST>(line, NodeStack.back());
     NodeStack.push_back(block);
-    while(TkParser->lookUp(1)[0] != '}')  {
+    while(TkStream->lookUp(1) != '}')  {
         if(StatementAST* stmt = parseStmt()) {
             block->addStmt(stmt);
         }
@@ -759,12 +978,12 @@ BlockStmtAST *GrammarParser::parseBlockStmt()   {
 
 IfStmtAST *GrammarParser::parseIfStmt()      {
 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
 
     // eat 'if'
     getNextToken();
 
-    IfStmtAST *ifStmt = new IfStmtAST(line, NodeStack.back(), nullptr);
+    IfStmtAST *ifStmt = createNode<IfStmtAST>(line, NodeStack.back(), nullptr);
     NodeStack.push_back(ifStmt);
     getNextToken();
     ifStmt->setCond(parseExpr());
@@ -773,12 +992,12 @@ IfStmtAST *GrammarParser::parseIfStmt()      {
     getNextToken();
 
     if(CurTok != tok_then) {
-        LOG_ERROR("missing 'then' in if stmt", TkParser->getCurLineNo());
+        LOG_ERROR("missing 'then' in if stmt", TkStream->getCurLineNo());
     }
 
     ifStmt->setStatement(parseStmt());
 
-    if(TkParser->lookUp(1)[0] == tok_else) {
+    if(TkStream->lookUp(1) == tok_else) {
         // eat else
         getNextToken();
         ifStmt->setElse(parseStmt());
@@ -790,8 +1009,8 @@ IfStmtAST *GrammarParser::parseIfStmt()      {
 
 
 ExprStmtAST *GrammarParser::parseExprStmt()    {
-    LineNo line = TkParser->getCurLineNo();
-    ExprStmtAST *exprStmt = new ExprStmtAST(line, NodeStack.back(), nullptr);
+    LineNo line = TkStream->getCurLineNo();
+    ExprStmtAST *exprStmt = createNode<ExprStmtAST>(line, NodeStack.back(), nullptr);
     NodeStack.push_back(exprStmt);
     exprStmt->setExpr(parseExpr());
     NodeStack.pop_back();
@@ -803,28 +1022,28 @@ ExprStmtAST *GrammarParser::parseExprStmt()    {
 
 ForStmtAST *GrammarParser::parseForStmt()     {
 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
 
     // eat 'for'
     getNextToken();
 
     ExprAST *expr1 = nullptr, *expr2 = nullptr, *expr3 = nullptr;
-    ForStmtAST *forStmt = new ForStmtAST(line, NodeStack.back(), nullptr, nullptr, nullptr);
+    ForStmtAST *forStmt = createNode<ForStmtAST>(line, NodeStack.back(), nullptr, nullptr, nullptr);
     NodeStack.push_back(forStmt);
     // eat '('
     getNextToken();
 
-    if(TkParser->lookUp(1)[0] != ';') {
+    if(TkStream->lookUp(1) != ';') {
         expr1 = parseExpr();
     }
     getNextToken();
 
-    if(TkParser->lookUp(1)[0] != ';') {
+    if(TkStream->lookUp(1) != ';') {
         expr2 = parseExpr();
     }
     getNextToken();
 
-    if(TkParser->lookUp(1)[0] != ')') {
+    if(TkStream->lookUp(1) != ')') {
         expr3 = parseExpr();
     }
 
@@ -847,11 +1066,11 @@ ForStmtAST *GrammarParser::parseForStmt()     {
 
 WhileStmtAST *GrammarParser::parseWhileStmt()   {
 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
 
     // eat 'while'
     getNextToken();
-    WhileStmtAST *whileStmt = new WhileStmtAST(line, NodeStack.back(), nullptr);
+    WhileStmtAST *whileStmt = createNode<WhileStmtAST>(line, NodeStack.back(), nullptr);
     NodeStack.push_back(whileStmt);
     // eat '('
     getNextToken();
@@ -871,12 +1090,12 @@ WhileStmtAST *GrammarParser::parseWhileStmt()   {
 
 ReturnStmtAST *GrammarParser::parseReturnStmt()  {
 
-    ReturnStmtAST *returnStmt = new ReturnStmtAST(TkParser->getCurLineNo(), NodeStack.back());
+    ReturnStmtAST *returnStmt = createNode<ReturnStmtAST>(TkStream->getCurLineNo(), NodeStack.back());
 
     getNextToken();
 
     NodeStack.push_back(returnStmt);
-    if(TkParser->lookUp(1)[0] != ';') {
+    if(TkStream->lookUp(1) != ';') {
         returnStmt->setRetExpr(parseExpr());
     }
     NodeStack.pop_back();
@@ -889,18 +1108,18 @@ ReturnStmtAST *GrammarParser::parseReturnStmt()  {
 
 
 BreakStmtAST *GrammarParser::parseBreakStmt()   {
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     getNextToken();
     getNextToken();
-    return new BreakStmtAST(line, NodeStack.back());
+    return createNode<BreakStmtAST>(line, NodeStack.back());
 }
 
 
 ContinueStmtAST *GrammarParser::parseContinueStmt(){
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     getNextToken();
     getNextToken();
-    return new ContinueStmtAST(line, NodeStack.back());
+    return createNode<ContinueStmtAST>(line, NodeStack.back());
 }
 
 
@@ -912,16 +1131,16 @@ StatementAST *GrammarParser::parseDefault()     {assert(false && "Unsupport attr
 ExprAST *GrammarParser::parseExpr()        { return parseAssignExpr(); }
 
 ExprAST *GrammarParser::parseAssignExpr() {
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     ExprAST *lhs = parseLogicExpr();
     BinaryExprAST *binExpr = nullptr;
-    if(TkParser->lookUp(1)[0] == tok_assign) {
+    if(TkStream->lookUp(1) == tok_assign) {
         getNextToken();
         if(lhs->getClassId() != IdRefId && lhs->getClassId() != IdIndexedRefId) {
             LOG_ERROR("error of left assign expr", line)
         }
         auto rhs = parseLogicExpr();
-        binExpr = new BinaryExprAST(line, NodeStack.back(), Assign, lhs, rhs);
+        binExpr = createNode<BinaryExprAST>(line, NodeStack.back(), Assign, lhs, rhs);
         lhs->setParent(binExpr);
         rhs->setParent(binExpr);
     }
@@ -933,18 +1152,18 @@ ExprAST *GrammarParser::parseAssignExpr() {
 ExprAST *GrammarParser::parseLogicExpr()   {
     
     static std::map<Token, Operator> LogicOpSet = { {tok_add, Add}, {tok_or, Or} }; 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     ExprAST *lhs = parseBitExpr();
     BinaryExprAST *binExpr = nullptr;
-    while(LogicOpSet.find(TkParser->lookUp(1)[0]) != LogicOpSet.end()) {
+    while(LogicOpSet.find(TkStream->lookUp(1)) != LogicOpSet.end()) {
         // eat op
         getNextToken();
         Operator op = LogicOpSet[(Token)CurTok];
         ExprAST *rhs = parseBitExpr();
-        binExpr = new BinaryExprAST(line, NodeStack.back(), op, lhs, rhs);
+        binExpr = createNode<BinaryExprAST>(line, NodeStack.back(), op, lhs, rhs);
         lhs->setParent(binExpr);
         rhs->setParent(binExpr);
-        line = TkParser->getCurLineNo();
+        line = TkStream->getCurLineNo();
         lhs = binExpr;
     }
 
@@ -959,18 +1178,18 @@ ExprAST *GrammarParser::parseBitExpr()     {
 
     static std::map<Token, Operator> BitOpSet = { {tok_bitxor, BitXor}, {tok_bitor, BitOr},
         {tok_bitand, BitAnd}}; 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     ExprAST *lhs = parseCmpExpr();
     BinaryExprAST *binExpr = nullptr;
-    while(BitOpSet.find(TkParser->lookUp(1)[0]) != BitOpSet.end()) {
+    while(BitOpSet.find(TkStream->lookUp(1)) != BitOpSet.end()) {
         // eat op
         getNextToken();
         Operator op = BitOpSet[(Token)CurTok];
         ExprAST *rhs = parseCmpExpr();
-        binExpr = new BinaryExprAST(line, NodeStack.back(), op, lhs, rhs);
+        binExpr = createNode<BinaryExprAST>(line, NodeStack.back(), op, lhs, rhs);
         lhs->setParent(binExpr);
         rhs->setParent(binExpr);
-        line = TkParser->getCurLineNo();
+        line = TkStream->getCurLineNo();
         lhs = binExpr;
     }
 
@@ -985,18 +1204,18 @@ ExprAST *GrammarParser::parseCmpExpr()     {
 
     static std::map<Token, Operator> CmpOpSet = { {tok_gt, Gt}, {tok_ge, Ge},
         {tok_lt, Lt}, {tok_le, Le}, {tok_eq, Eq}, {tok_neq, Neq}}; 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     ExprAST *lhs = parseBitMoveExpr();
     BinaryExprAST *binExpr = nullptr;
-    while(CmpOpSet.find(TkParser->lookUp(1)[0]) != CmpOpSet.end()) {
+    while(CmpOpSet.find(TkStream->lookUp(1)) != CmpOpSet.end()) {
         // eat op
         getNextToken();
         Operator op = CmpOpSet[(Token)CurTok];
         ExprAST *rhs = parseBitMoveExpr();
-        binExpr = new BinaryExprAST(line, NodeStack.back(), op, lhs, rhs);
+        binExpr = createNode<BinaryExprAST>(line, NodeStack.back(), op, lhs, rhs);
         lhs->setParent(binExpr);
         rhs->setParent(binExpr);
-        line = TkParser->getCurLineNo();
+        line = TkStream->getCurLineNo();
         lhs = binExpr;
     }
 
@@ -1010,18 +1229,18 @@ ExprAST *GrammarParser::parseBitMoveExpr() {
 
     static std::map<Token, Operator> BitMoveOpSet = { {tok_lh, Lsft}, {tok_ulh, Lusft},
         {tok_rh, Rsft}, {tok_urh, Rusft}}; 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     ExprAST *lhs = parseAddExpr();
     BinaryExprAST *binExpr = nullptr;
-    while(BitMoveOpSet.find(TkParser->lookUp(1)[0]) != BitMoveOpSet.end()) {
+    while(BitMoveOpSet.find(TkStream->lookUp(1)) != BitMoveOpSet.end()) {
         // eat op
         getNextToken();
         Operator op = BitMoveOpSet[(Token)CurTok];
         ExprAST *rhs = parseAddExpr();
-        binExpr = new BinaryExprAST(line, NodeStack.back(), op, lhs, rhs);
+        binExpr = createNode<BinaryExprAST>(line, NodeStack.back(), op, lhs, rhs);
         lhs->setParent(binExpr);
         rhs->setParent(binExpr);
-        line = TkParser->getCurLineNo();
+        line = TkStream->getCurLineNo();
         lhs = binExpr;
     }
 
@@ -1035,18 +1254,18 @@ ExprAST *GrammarParser::parseBitMoveExpr() {
 ExprAST *GrammarParser::parseAddExpr()     {
 
     static std::map<Token, Operator> AddOpSet = { {tok_add, Add}, {tok_sub, Sub} }; 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     ExprAST *lhs = parseMulExpr();
     BinaryExprAST *binExpr = nullptr;
-    while(AddOpSet.find(TkParser->lookUp(1)[0]) != AddOpSet.end()) {
+    while(AddOpSet.find(TkStream->lookUp(1)) != AddOpSet.end()) {
         // eat op
         getNextToken();
         Operator op = AddOpSet[(Token)CurTok];
         ExprAST *rhs = parseMulExpr();
-        binExpr = new BinaryExprAST(line, NodeStack.back(), op, lhs, rhs);
+        binExpr = createNode<BinaryExprAST>(line, NodeStack.back(), op, lhs, rhs);
         lhs->setParent(binExpr);
         rhs->setParent(binExpr);
-        line = TkParser->getCurLineNo();
+        line = TkStream->getCurLineNo();
         lhs = binExpr;
     }
 
@@ -1060,18 +1279,18 @@ ExprAST *GrammarParser::parseAddExpr()     {
 ExprAST *GrammarParser::parseMulExpr()     {
 
     static std::map<Token, Operator> MulOpSet = { {tok_mul, Mul}, {tok_div, Div} }; 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     ExprAST *lhs = parseUnaryExpr();
     BinaryExprAST *binExpr = nullptr;
-    while(MulOpSet.find(TkParser->lookUp(1)[0]) != MulOpSet.end()) {
+    while(MulOpSet.find(TkStream->lookUp(1)) != MulOpSet.end()) {
         // eat op
         getNextToken();
         Operator op = MulOpSet[(Token)CurTok];
         ExprAST *rhs = parseUnaryExpr();
-        binExpr = new BinaryExprAST(line, NodeStack.back(), op, lhs, rhs);
+        binExpr = createNode<BinaryExprAST>(line, NodeStack.back(), op, lhs, rhs);
         lhs->setParent(binExpr);
         rhs->setParent(binExpr);
-        line = TkParser->getCurLineNo();
+        line = TkStream->getCurLineNo();
         lhs = binExpr;
     }
 
@@ -1084,11 +1303,11 @@ ExprAST *GrammarParser::parseMulExpr()     {
 
 ExprAST *GrammarParser::parseUnaryExpr()   {
     static std::map<Token, Operator> UnaryOpSet = { {tok_add, Add}, {tok_sub, Sub}, {tok_not, Not} };
-    LineNo line = TkParser->getCurLineNo();
-    if(UnaryOpSet.find(TkParser->lookUp(1)[0]) != UnaryOpSet.end()) {
+    LineNo line = TkStream->getCurLineNo();
+    if(UnaryOpSet.find(TkStream->lookUp(1)) != UnaryOpSet.end()) {
         getNextToken();
         Operator op = UnaryOpSet[(Token)CurTok];
-        UnaryExprAST *unary = new UnaryExprAST(line, NodeStack.back(), op, nullptr);
+        UnaryExprAST *unary = createNode<UnaryExprAST>(line, NodeStack.back(), op, nullptr);
         NodeStack.push_back(unary);
         unary->setUnaryExpr(parseUnaryExpr());
         NodeStack.pop_back();
@@ -1100,7 +1319,7 @@ ExprAST *GrammarParser::parseUnaryExpr()   {
 
 ExprAST *GrammarParser::parsePrimaryExpr() {
     
-    switch (TkParser->lookUp(1)[0]) {
+    switch (TkStream->lookUp(1)) {
         case '(': {
             getNextToken();
             ExprAST *expr = parseExpr();
@@ -1108,7 +1327,7 @@ ExprAST *GrammarParser::parsePrimaryExpr() {
             return expr;
         }
         case tok_id: {
-            if(TkParser->lookUp(2)[1] == '(')
+            if(TkStream->lookUp(2) == '(')
                 return parseCallExpr();
             return parseIdRef();
         }   
@@ -1121,22 +1340,22 @@ ExprAST *GrammarParser::parsePrimaryExpr() {
 
 ExprAST *GrammarParser::parseIdRef()       {
 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     getNextToken();
 
-    if(TkParser->lookUp(1)[0] == '[') {
-        auto *indexes = new IdIndexedRefAST(line, NodeStack.back(), TkParser->getIdStr());
+    if(TkStream->lookUp(1) == '[') {
+        auto *indexes = createNode<IdIndexedRefAST>(line, NodeStack.back(), TkStream->getIdSymbol());
         NodeStack.push_back(indexes);
-        while(TkParser->lookUp(1)[0] == '[') {
+        while(TkStream->lookUp(1) == '[') {
             getNextToken();
             indexes->addIndex(parseExpr());
             getNextToken();
         }
         NodeStack.pop_back();
-        if(auto var = getVariableNode(indexes->getIdName())) {
+        if(auto var = getVariableNode(indexes->getIdSymbol())) {
             indexes->setId(var);
         }
-        else if(auto var = getVariableNodeFromGlobalMap(indexes->getIdName())) {
+        else if(auto var = getVariableNodeFromGlobalMap(indexes->getIdSymbol())) {
             indexes->setId(var);
         }
         else {
@@ -1145,11 +1364,11 @@ ExprAST *GrammarParser::parseIdRef()       {
         return indexes;
     }
     else {
-        auto idref = new IdRefAST(line, NodeStack.back(), TkParser->getIdStr());
-        if(auto var = getVariableNode(idref->getIdName())) {
+        auto idref = createNode<IdRefAST>(line, NodeStack.back(), TkStream->getIdSymbol());
+        if(auto var = getVariableNode(idref->getIdSymbol())) {
             idref->setId(var);
         }
-        else if(auto var = getVariableNodeFromGlobalMap(idref->getIdName())) {
+        else if(auto var = getVariableNodeFromGlobalMap(idref->getIdSymbol())) {
             idref->setId(var);
         }
         else {
@@ -1163,15 +1382,15 @@ ExprAST *GrammarParser::parseIdRef()       {
 
 ExprAST *GrammarParser::parseCallExpr()    {
 
-    LineNo line = TkParser->getCurLineNo();
+    LineNo line = TkStream->getCurLineNo();
     getNextToken();
-    auto *callExpr = new CallExprAST(line, NodeStack.back(), TkParser->getIdStr());
-    if(FuncAST *func = getFuncASTNode(callExpr->getName())) {
+    auto *callExpr = createNode<CallExprAST>(line, NodeStack.back(), TkStream->getIdSymbol());
+    if(FuncAST *func = getFuncASTNode(callExpr->getNameSymbol())) {
         callExpr->setFunction(func);
     }
     else {
         // is call std function
-        if(StdFunctionSet.find(callExpr->getName()) != StdFunctionSet.end()) {
+        if(isStdFunction(callExpr->getNameSymbol())) {
             callExpr->setIsCallStd(true);
         }
         else {
@@ -1182,9 +1401,9 @@ ExprAST *GrammarParser::parseCallExpr()    {
     // eat '('
     getNextToken();
 
-    while(TkParser->lookUp(1)[0] != ')') {
+    while(TkStream->lookUp(1) != ')') {
         callExpr->addArg(parseExpr());
-        if(TkParser->lookUp(1)[0] == ',')
+        if(TkStream->lookUp(1) == ',')
             getNextToken();
         else
             break;
@@ -1199,34 +1418,34 @@ ExprAST *GrammarParser::parseCallExpr()    {
 
 
 ExprAST *GrammarParser::parseConstExpr()   {
-    LineNo line = TkParser->getCurLineNo();
-    switch(TkParser->lookUp(1)[0]) {
+    LineNo line = TkStream->getCurLineNo();
+    switch(TkStream->lookUp(1)) {
         case tok_literal: {
             getNextToken();
-            return new LiteralExprAST(line, NodeStack.back(), TkParser->getLiteral());
+            return createNode<LiteralExprAST>(line, NodeStack.back(), std::string(TkStream->getLiteral()));
         }
         case tok_true: {
             getNextToken();
-            return new NumberExprAST(line, NodeStack.back(), true);
+            return createNode<NumberExprAST>(line, NodeStack.back(), true);
         }
         case tok_false:
         {
             getNextToken();
-            return new NumberExprAST(line, NodeStack.back(), false);
+            return createNode<NumberExprAST>(line, NodeStack.back(), false);
         }
         case tok_inumber:{
             getNextToken();
-            NumberExprAST *number = new NumberExprAST(line, NodeStack.back(), TkParser->getIntVal());
-            number->setIsSigned(TkParser->isSigned());
+            NumberExprAST *number = createNode<NumberExprAST>(line, NodeStack.back(), TkStream->getIntVal());
+            number->setIsSigned(TkStream->isSigned());
             return number;
         }
         case tok_fnumber:{
             getNextToken();
-            return new NumberExprAST(line, NodeStack.back(), TkParser->getDoubleVal());
+            return createNode<NumberExprAST>(line, NodeStack.back(), TkStream->getDoubleVal());
         }
         case tok_charlit:{
             getNextToken();
-            return new NumberExprAST(line, NodeStack.back(), (char)TkParser->getIntVal());
+            return createNode<NumberExprAST>(line, NodeStack.back(), (char)TkStream->getIntVal());
         }
         default: {
             LOG_ERROR("error literal", line)
@@ -1239,96 +1458,149 @@ ExprAST *GrammarParser::parseConstExpr()   {
 
 
 /// -----------------------------------------------------
+std::mutex GrammarParser::ProgToGrammarParserMapLock;
 std::unordered_map<ProgramAST *, GrammarParser *> GrammarParser::ProgToGrammarParserMap = {};
 
 GrammarParser *GrammarParser::getOrCreateGrammarParserByProg(ProgramAST *prog) {
+    std::lock_guard<std::mutex> guard(ProgToGrammarParserMapLock);
     if(ProgToGrammarParserMap.find(prog) == ProgToGrammarParserMap.end()) {
         auto *parser = new GrammarParser(prog);
         ProgToGrammarParserMap.insert({prog, parser});
     }
     return ProgToGrammarParserMap[prog];
 }
-/// ------------------------------------------------------
 
-FuncAST *GrammarParser::getFuncASTNode(const std::string &name) {
-    if(FuncDefMap.find(name) != FuncDefMap.end())
-        return FuncDefMap[name];
-    for(auto *prog : ProgAst->getDependentProgs()){
-        if(FuncAST *func = getOrCreateGrammarParserByProg(prog)->getFuncASTNode(name)){
-            return func;
-        }
-    }
-    return nullptr;
+GrammarParser *GrammarParser::createGrammarParserBySource(ProgramAST *prog, std::string_view source, const std::string &fileName) {
+    std::lock_guard<std::mutex> guard(ProgToGrammarParserMapLock);
+    assert(ProgToGrammarParserMap.find(prog) == ProgToGrammarParserMap.end() && "parser of prog already created");
+    auto *parser = new GrammarParser(prog, SourceBuffer::getMemBufferCopy(source), fileName);
+    ProgToGrammarParserMap.insert({prog, parser});
+    return parser;
 }
 
-VariableAST *GrammarParser::getVariableNode(const std::string & name) {
-    auto rbegin = SymTabMap.rbegin();
-    auto rend = SymTabMap.rend();
-    while(rbegin != rend) {
-        auto& map = *rbegin;
-        if(map.find(name) != map.end()) {
-            return map[name];
-        }
-        rbegin++;
+void GrammarParser::releaseGrammarParserByProg(ProgramAST *prog) {
+    std::lock_guard<std::mutex> guard(ProgToGrammarParserMapLock);
+    auto it = ProgToGrammarParserMap.find(prog);
+    if(it != ProgToGrammarParserMap.end()) {
+        delete it->second;
+        ProgToGrammarParserMap.erase(it);
     }
+}
+/// ------------------------------------------------------
+
+FuncAST *GrammarParser::getFuncASTNode(Symbol name) {
+    SymbolLookups++;
+    auto it = FuncDefMap.find(name);
+    if(it != FuncDefMap.end())
+        return it->second;
+    if(auto *entry = findImportedFunc(name))
+        return entry->Func;
+    SymbolLookupMisses++;
     return nullptr;
 }
 
-VariableAST *GrammarParser::getVariableNodeFromGlobalMap(const std::string& name) {
-    if(GlobalVariableMap.find(name) != GlobalVariableMap.end())
-        return GlobalVariableMap[name];
-    for(auto *prog : ProgAst->getDependentProgs()){
-        auto parser = getOrCreateGrammarParserByProg(prog);
-        if(VariableAST *var = parser->getVariableNodeFromOtherGlobalMap(name))
-            return var;
-    }
+VariableAST *GrammarParser::getVariableNode(Symbol name) {
+    SymbolLookups++;
+    VariableAST *var = SymTab.lookup(name);
+    if(!var)
+        SymbolLookupMisses++;
+    return var;
+}
+
+VariableAST *GrammarParser::getVariableNodeFromGlobalMap(Symbol name) {
+    SymbolLookups++;
+    auto it = GlobalVariableMap.find(name);
+    if(it != GlobalVariableMap.end())
+        return it->second;
+    if(auto *entry = findImportedVar(name))
+        return entry->Var;
+    SymbolLookupMisses++;
     return nullptr;
 }
 
-VariableAST *GrammarParser::getVariableNodeFromOtherGlobalMap(const std::string& name) {
-    if(VariableAST *var = getVariableNodeFromGlobalMap(name)) {
-        if(var->isStatic())
-            return nullptr;
-        return var;
-    }
+ProgramAST *GrammarParser::getImportOrigin(Symbol name) {
+    if(auto *entry = findImportedFunc(name))
+        return entry->Origin;
+    if(auto *entry = findImportedVar(name))
+        return entry->Origin;
     return nullptr;
 }
 
 bool GrammarParser::insertFunctionToFuncMap(FuncAST *node) {
-    if(StdFunctionSet.find(node->getFuncName()) != StdFunctionSet.end()) return false;
-    if(FuncAST *func = getFuncASTNode(node->getFuncName())) {
+    if(isStdFunction(node->getFuncSymbol())) return false;
+    if(FuncAST *func = getFuncASTNode(node->getFuncSymbol())) {
         if(func->isFuncDeclare()) return true;
         return false;
     }
-    FuncDefMap.insert({node->getFuncName(), node});
+    FuncDefMap.insert({node->getFuncSymbol(), node});
     return true;
 }
 
 bool GrammarParser::insertVariableToVarMap(VariableAST *var) {
-    if(SymTabMap.empty()) {
-        if(VariableAST *var1 = getVariableNodeFromGlobalMap(var->getName()))
+    if(SymTab.empty()) {
+        if(VariableAST *var1 = getVariableNodeFromGlobalMap(var->getSymbol()))
             return false;
-        for(auto *prog : ProgAst->getDependentProgs()) {
-            auto parser = getOrCreateGrammarParserByProg(prog);
-            if(VariableAST *var1 = parser->getVariableNodeFromOtherGlobalMap(var->getName()))
-                return false;
-        }
-        GlobalVariableMap.insert({var->getName(), var});
+        GlobalVariableMap.insert({var->getSymbol(), var});
     }
     else {
-        if(SymTabMap.back().find(var->getName()) != SymTabMap.back().end())
+        if(!SymTab.insert(var->getSymbol(), var))
             return false;
-        SymTabMap.back().insert({var->getName(), var});
     }
     return true;
 }
 
 void GrammarParser::enterNewSymTab() {
-    SymTabMap.push_back({});
+    SymTab.enterScope();
 }
 
 void GrammarParser::leaveCurSymTab() {
-    SymTabMap.pop_back();
+    SymTab.leaveScope();
+}
+
+/// the dependent programs are parsed before this program, their export
+/// indexes are looked up in import order, so the first import define a name wins
+void GrammarParser::buildImportIndex() {
+    Imports.clear();
+    ImportedFuncs.clear();
+    ImportedVars.clear();
+    for(auto *prog : ProgAst->getDependentProgs()) {
+        Imports.Deps.push_back(&getOrCreateGrammarParserByProg(prog)->getExports());
+    }
+}
+
+/// the export index is the symbols defined in this program and the
+/// symbols imported, static variable is not exported and hide the
+/// imported variable with the same name
+void GrammarParser::buildExportIndex() {
+    Exports.clear();
+    for(auto &func : FuncDefMap) {
+        Exports.Funcs.insert({func.first, {func.second, ProgAst}});
+    }
+    for(auto &var : GlobalVariableMap) {
+        if(!var.second->isStatic())
+            Exports.Vars.insert({var.first, {var.second, ProgAst}});
+        else
+            Exports.HiddenVars.insert(var.first);
+    }
+    Exports.Deps = Imports.Deps;
+}
+
+const ExportIndex::FuncEntry *GrammarParser::findImportedFunc(Symbol name) {
+    auto it = ImportedFuncs.find(name);
+    if(it != ImportedFuncs.end())
+        return it->second;
+    auto *entry = Imports.findFunc(name);
+    ImportedFuncs.insert({name, entry});
+    return entry;
+}
+
+const ExportIndex::VarEntry *GrammarParser::findImportedVar(Symbol name) {
+    auto it = ImportedVars.find(name);
+    if(it != ImportedVars.end())
+        return it->second;
+    auto *entry = Imports.findVar(name);
+    ImportedVars.insert({name, entry});
+    return entry;
 }
 
 }
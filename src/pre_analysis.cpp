@@ -1,46 +1,35 @@
 
 
 #include <map>
+#include <unordered_map>
+#include <algorithm>
 #include <iostream>
 #include <cstring>
-#include <regex.h>
+#include <cctype>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <optional>
+#include <condition_variable>
 
 #include "pre_analysis.h"
+#include "source_buffer.h"
 #include "global_variable.h"
 
 namespace kale {
 
 /// ----------------------------------------------------------------
-/// static variable defined to help pre analysis
-static int CurrentIndex = 0;
-static FILE *Fp = nullptr;
-static ProgramAST *CurProg = nullptr;
+/// static variable defined to help pre analysis, guarded by Lock
+/// while the files are scanned
 static std::map<std::string, ProgramAST *> ProgMap;
 static std::vector<std::string> FileNameList;
-static regex_t Regex;
-static char Pattern[] = "[ ]*import[ ]*\"([a-zA-Z0-9_]+.k)\"[ ]*;";
-static std::vector<ProgramAST*> DagCheckStack; 
+static std::mutex Lock;
 /// ----------------------------------------------------------------
 
 
-/// ----------------------------------------------------------------
-/// @brief init regex expr
-static inline bool init() {
-    int ret = regcomp(&Regex, Pattern, REG_EXTENDED);
-    if(ret) {
-        std::cerr << "Can not init regex expr!" << std::endl;
-        return false;
-    }
-    return true; 
-}
-/// ----------------------------------------------------------------
-
 /// ----------------------------------------------------------------
 /// @brief free resources that open
 static inline void close() {
-    if(Fp)
-        fclose(Fp);
-    regfree(&Regex);
     InputFileList = FileNameList;
     FileNameList.clear();
     ProgMap.clear();
@@ -51,10 +40,9 @@ static inline void close() {
 /// ----------------------------------------------------------------
 static inline ProgramAST* getOrCreateProgAST(const std::string& file) {
     if(ProgMap.find(file) == ProgMap.end()) {
-        ProgramAST *prog = new ProgramAST({CurrentIndex, 0, 0});
+        ProgramAST *prog = new ProgramAST({(unsigned)FileNameList.size(), 0, 0});
         FileNameList.push_back(file);
         ProgramList.push_back(prog);
-        CurrentIndex++;
         ProgMap.insert({file, prog});
     }
     return ProgMap[file];
@@ -63,132 +51,407 @@ static inline ProgramAST* getOrCreateProgAST(const std::string& file) {
 
 
 /// ----------------------------------------------------------------
-static void getImportFileName(char *s) {
-    regmatch_t matches[2];
-    int offset = 0, start, end, length;
-    char *file = nullptr;
-    while(regexec(&Regex, s+offset, 2, matches, 0) == 0) {
-        start = matches[1].rm_so;
-        end = matches[1].rm_eo;
-
-        if(start != -1 && end != -1) {
-            length = end - start;
-            file = (char*)malloc((length + 1) * sizeof(char));
-            file[length] = '\0'; 
-            strncpy(file, s+offset+start, length);
-            CurProg->addDependentProg(getOrCreateProgAST(file));
-            free(file);
-            file = nullptr;
+/// @brief skip the spaces and the '#' comments as the lexer does
+static inline void skipSpaceAndComment(const char *&p, const char *end) {
+    while(p != end) {
+        if(isspace((unsigned char)*p)) {
+            p++;
+        }
+        else if(*p == '#') {
+            while(p != end && *p != '\n')
+                p++;
+        }
+        else {
+            break;
         }
-
-        offset += matches[0].rm_eo;
     }
 }
 /// ----------------------------------------------------------------
 
 
 /// ----------------------------------------------------------------
-static inline void anaFileDepAndCreateProgramAST() {
-    static char File[512];
-    while((fgets(File, sizeof(File), Fp)) != NULL) {
-        getImportFileName(File);
-        memset(File, 0, sizeof(File));
+/// @brief Code implication of class ImportGraph
+ImportGraph::ImportGraph(const std::vector<ProgramAST *> &progs) : Progs(progs) {
+    std::unordered_map<ProgramAST *, unsigned> indexes;
+    indexes.reserve(Progs.size());
+    for(unsigned i = 0; i < Progs.size(); i++) {
+        indexes.insert({Progs[i], i});
     }
-}
-/// ----------------------------------------------------------------
-
 
-/// ----------------------------------------------------------------
-/// @brief This two function checks if there is a circular reference
-/// because circular reference can't confirm the compile order.
-/// @example t1 import t2, t2 import t3, t3 import t1, there are error
-/// import way.
-static inline bool depCheck(ProgramAST *prog) {
-    for(auto *p : DagCheckStack) {
-        if(p == prog) {
-            DagCheckStack.push_back(prog);
-            return false;
+    EdgeStart.reserve(Progs.size() + 1);
+    for(auto *prog : Progs) {
+        EdgeStart.push_back(Edges.size());
+        for(auto *dep : prog->getDependentProgs()) {
+            auto it = indexes.find(dep);
+            if(it != indexes.end())
+                Edges.push_back(it->second);
         }
     }
+    EdgeStart.push_back(Edges.size());
+
+    computeComponents();
+}
 
-    DagCheckStack.push_back(prog);
+/// iterative Tarjan, the explicit stack hold the node and the next edge
+/// to visit, so a deep import chain can't overflow the call stack
+void ImportGraph::computeComponents() {
+    const unsigned Unvisited = ~0u;
+    unsigned count = Progs.size();
+    std::vector<unsigned> index(count, Unvisited), low(count);
+    std::vector<bool> onStack(count, false);
+    std::vector<unsigned> stack;
+    std::vector<std::pair<unsigned, unsigned>> frames;
+    unsigned nextIndex = 0;
+
+    Order.reserve(count);
+    for(unsigned root = 0; root < count; root++) {
+        if(index[root] != Unvisited)
+            continue;
+        frames.push_back({root, EdgeStart[root]});
+        index[root] = low[root] = nextIndex++;
+        stack.push_back(root);
+        onStack[root] = true;
+
+        while(!frames.empty()) {
+            unsigned node = frames.back().first;
+            unsigned &edge = frames.back().second;
+            if(edge < EdgeStart[node + 1]) {
+                unsigned dep = Edges[edge++];
+                if(index[dep] == Unvisited) {
+                    frames.push_back({dep, EdgeStart[dep]});
+                    index[dep] = low[dep] = nextIndex++;
+                    stack.push_back(dep);
+                    onStack[dep] = true;
+                }
+                else if(onStack[dep]) {
+                    low[node] = std::min(low[node], index[dep]);
+                }
+                continue;
+            }
+
+            /// all imports of node are visited, pop its component if it is the root
+            frames.pop_back();
+            if(!frames.empty()) {
+                unsigned parent = frames.back().first;
+                low[parent] = std::min(low[parent], low[node]);
+            }
+            if(low[node] != index[node])
+                continue;
+
+            ComponentStart.push_back(Order.size());
+            unsigned member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                Order.push_back(member);
+            } while(member != node);
+
+            bool cyclic = Order.size() - ComponentStart.back() > 1;
+            for(unsigned e = EdgeStart[node]; !cyclic && e < EdgeStart[node + 1]; e++) {
+                cyclic = Edges[e] == node;
+            }
+            CyclicComponent.push_back(cyclic);
+        }
+    }
+    ComponentStart.push_back(Order.size());
+}
 
-    for(auto *p : prog->getDependentProgs()) {
-        if(!depCheck(p))
+bool ImportGraph::isAcyclic() const {
+    for(bool cyclic : CyclicComponent) {
+        if(cyclic)
             return false;
     }
+    return true;
+}
 
-    DagCheckStack.pop_back();
+std::vector<ProgramAST *> ImportGraph::getCompileOrder() const {
+    std::vector<ProgramAST *> order;
+    order.reserve(Order.size());
+    for(unsigned node : Order) {
+        order.push_back(Progs[node]);
+    }
+    return order;
+}
 
-    return true;
+std::vector<std::vector<ProgramAST *>> ImportGraph::getCycles() const {
+    std::vector<std::vector<ProgramAST *>> cycles;
+    for(unsigned c = 0; c < CyclicComponent.size(); c++) {
+        if(!CyclicComponent[c])
+            continue;
+        cycles.emplace_back();
+        /// the members are popped in reverse, list them in discovery order
+        for(unsigned i = ComponentStart[c + 1]; i > ComponentStart[c]; i--) {
+            cycles.back().push_back(Progs[Order[i - 1]]);
+        }
+    }
+    return cycles;
 }
 
+/// walk from the first program along the imports staying in the cycle,
+/// every program of a component reach the others, so a program is seen
+/// again after at most size steps
+std::vector<ProgramAST *> ImportGraph::getCyclePath(const std::vector<ProgramAST *> &cycle) const {
+    std::unordered_map<ProgramAST *, unsigned> members;
+    for(auto *prog : cycle) {
+        members.insert({prog, ~0u});
+    }
+    std::unordered_map<ProgramAST *, unsigned> indexes;
+    for(unsigned i = 0; i < Progs.size(); i++) {
+        if(members.count(Progs[i]))
+            indexes.insert({Progs[i], i});
+    }
 
-static inline bool depCheck() {
-    for(const auto& prog : ProgramList) {
-        DagCheckStack.clear();
-        if(!depCheck(prog)) return false;
+    std::vector<ProgramAST *> path;
+    ProgramAST *prog = cycle.empty() ? nullptr : cycle.front();
+    while(prog && members[prog] == ~0u) {
+        members[prog] = path.size();
+        path.push_back(prog);
+        unsigned node = indexes[prog];
+        ProgramAST *next = nullptr;
+        for(unsigned e = EdgeStart[node]; !next && e < EdgeStart[node + 1]; e++) {
+            if(members.count(Progs[Edges[e]]))
+                next = Progs[Edges[e]];
+        }
+        prog = next;
     }
-    return true;
+    if(!prog)
+        return {};
+    /// drop the programs walked before entering the cycle
+    path.erase(path.begin(), path.begin() + members[prog]);
+    return path;
 }
 /// ----------------------------------------------------------------
 
 
 /// ----------------------------------------------------------------
-static inline void logRefError() {
-    auto it1 = DagCheckStack.begin();
-    auto it2 =  DagCheckStack.begin()+1;
-    auto end = DagCheckStack.end();
+static inline void logRefError(const ImportGraph &graph) {
+    auto cycles = graph.getCycles();
     std::cerr << "There are circular references in the source code and compilation order cannot be determined!" << std::endl;
-    while(it2 != end) {
-        std::cerr << InputFileList[(*it1)->getLineNo()->FileIndex] << " import " << InputFileList[(*it2)->getLineNo()->FileIndex] << std::endl;
-        it1 ++;
-        it2 ++;
+    for(auto &cycle : cycles) {
+        auto path = graph.getCyclePath(cycle);
+        std::cerr << "import cycle of " << cycle.size() << " program(s):" << std::endl;
+        for(size_t i = 0; i < path.size(); i++) {
+            ProgramAST *next = path[(i + 1) % path.size()];
+            std::cerr << "  " << InputFileList[path[i]->getLineNo()->FileIndex] << " import "
+                      << InputFileList[next->getLineNo()->FileIndex] << std::endl;
+        }
     }
 }
 /// ----------------------------------------------------------------
 
 
 /// ----------------------------------------------------------------
-bool preFileDepAnalysis() {
-    
-    if(!init()) {
-        close();
+/// @brief scan one import "file"; from the keyword at p, false if it is
+/// not a complete import, p is after the scanned chars
+static bool scanImport(const char *&p, const char *end, std::string &file) {
+    static const char Keyword[] = "import";
+    const size_t KeywordSize = sizeof(Keyword) - 1;
+    if((size_t)(end - p) <= KeywordSize || memcmp(p, Keyword, KeywordSize) != 0 ||
+       isalnum((unsigned char)p[KeywordSize]))
+        return false;
+    p += KeywordSize;
+
+    skipSpaceAndComment(p, end);
+    if(p == end || *p != '\"')
+        return false;
+    const char *name = ++p;
+    while(p != end && *p != '\"')
+        p++;
+    if(p == end)
         return false;
+    file.assign(name, p - name);
+    p++;
+
+    skipSpaceAndComment(p, end);
+    if(p == end || *p != ';')
+        return false;
+    p++;
+    return true;
+}
+
+/// @brief scan all the tokens from p like the lexer, for the imports
+/// after the declarations
+static void scanLateImports(const char *p, const char *end, std::vector<std::string> &files) {
+    std::string file;
+    while(true) {
+        skipSpaceAndComment(p, end);
+        if(p == end)
+            break;
+        if(*p == '\"') {
+            /// a literal, it has no escape
+            p++;
+            while(p != end && *p != '\"')
+                p++;
+            if(p != end)
+                p++;
+        }
+        else if(*p == '\'') {
+            /// a char literal is '' or 'c'
+            p++;
+            if(p != end && *p != '\'')
+                p++;
+            if(p != end)
+                p++;
+        }
+        else if(isalpha((unsigned char)*p)) {
+            if(scanImport(p, end, file)) {
+                files.push_back(file);
+                continue;
+            }
+            while(p != end && isalnum((unsigned char)*p))
+                p++;
+        }
+        else {
+            p++;
+        }
+    }
+}
+
+/// the imports are usually the first declarations of a file, so the scan
+/// stop at the first token which doesn't start an import. If the word
+/// import is found after it, the rest of the file is scanned token by
+/// token, so a late import is not missed
+std::vector<std::string> scanImportFileNames(std::string_view source) {
+    std::vector<std::string> files;
+    const char *p = source.data();
+    const char *end = p + source.size();
+    std::string file;
+
+    while(true) {
+        skipSpaceAndComment(p, end);
+        if(!scanImport(p, end, file))
+            break;
+        files.push_back(file);
     }
 
-    CurrentIndex = 0;
+    if(source.find("import", p - source.data()) != std::string_view::npos)
+        scanLateImports(p, end, files);
+    return files;
+}
+/// ----------------------------------------------------------------
+
 
-    Fp = nullptr;
-    CurProg = nullptr;
+/// ----------------------------------------------------------------
+/// @brief the imports of one file, Opened is false if it can't be read
+struct ScanResult {
+    bool                     Opened;
+    std::vector<std::string> Imports;
+};
+
+static ScanResult scanFile(const std::string &file) {
+    ScanResult result;
+    auto buffer = SourceBuffer::getFile(file);
+    result.Opened = buffer != nullptr;
+    if(buffer)
+        result.Imports = scanImportFileNames(std::string_view(buffer->getBufferStart(), buffer->getBufferSize()));
+    return result;
+}
+/// ----------------------------------------------------------------
 
+
+/// ----------------------------------------------------------------
+/// the files are scanned by a pool of threads while the results are
+/// consumed in the order of the file indexes, a file imported for the
+/// first time get the next index and is queued, so the indexes are the
+/// same whatever the threads do
+bool preFileDepAnalysis() {
+    unsigned threadCount = UseMultThreadCompile ? ThreadCount : 1;
+    std::deque<unsigned> pending;
+    std::vector<std::optional<ScanResult>> results;
+    std::condition_variable cond;
+    bool stop = false;
+    bool success = true;
+
+    std::unique_lock<std::mutex> guard(Lock);
     for(const auto& file : InputFileList) {
-        Fp = fopen(file.c_str(), "rt+");
-        
-        if(!Fp) {
+        getOrCreateProgAST(file);
+    }
+    for(unsigned i = 0; i < FileNameList.size(); i++) {
+        pending.push_back(i);
+    }
+    results.resize(FileNameList.size());
+
+    /// take one queued file and scan it, the lock is held on entry and exit
+    auto scanOne = [&](std::unique_lock<std::mutex> &held) {
+        unsigned index = pending.front();
+        pending.pop_front();
+        std::string file = FileNameList[index];
+        held.unlock();
+        ScanResult result = scanFile(file);
+        held.lock();
+        results[index] = std::move(result);
+        cond.notify_all();
+    };
+
+    /// the calling thread scan too, so no thread is created without -j
+    std::vector<std::thread> workers;
+    for(unsigned i = 1; i < threadCount; i++) {
+        workers.emplace_back([&]() {
+            std::unique_lock<std::mutex> held(Lock);
+            while(true) {
+                cond.wait(held, [&] { return stop || !pending.empty(); });
+                if(stop)
+                    return;
+                scanOne(held);
+            }
+        });
+    }
+
+    for(unsigned index = 0; index < FileNameList.size(); index++) {
+        while(!results[index]) {
+            if(!pending.empty())
+                scanOne(guard);
+            else
+                cond.wait(guard);
+        }
+
+        const std::string file = FileNameList[index];
+        if(!results[index]->Opened) {
             std::cerr << "Can not find this file " << file << "." << std::endl;
-            close();
-            return false;
+            success = false;
+            break;
         }
 
-        CurProg = getOrCreateProgAST(file);
-    
-        anaFileDepAndCreateProgramAST();
+        /// the imported file is relative to the directory of the importer
+        ProgramAST *prog = ProgMap[file];
+        auto slash = file.rfind('/');
+        std::string dir = slash == std::string::npos ? "" : file.substr(0, slash + 1);
+        /// results grow in the loop, so the imports are moved out first
+        std::vector<std::string> imports = std::move(results[index]->Imports);
+        for(auto &import : imports) {
+            size_t count = FileNameList.size();
+            prog->addDependentProg(getOrCreateProgAST(dir + import));
+            if(FileNameList.size() != count) {
+                pending.push_back(count);
+                results.emplace_back();
+                cond.notify_all();
+            }
+        }
+    }
 
-        fclose(Fp);
-        Fp = nullptr;
+    stop = true;
+    cond.notify_all();
+    guard.unlock();
+    for(auto &worker : workers) {
+        worker.join();
     }
 
     close();
+    if(!success)
+        return false;
 
-    if(!depCheck()) {
-        logRefError();
+    /// the graph is analysed once, the programs are then kept in its
+    /// compile order for the later phases
+    ImportGraph graph(ProgramList);
+    if(!graph.isAcyclic()) {
+        logRefError(graph);
         return false;
     }
+    ProgramList = graph.getCompileOrder();
 
     return true;
 }
 /// ----------------------------------------------------------------
 
 }
-
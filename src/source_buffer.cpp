@@ -0,0 +1,87 @@
+
+#include "source_buffer.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// @brief Code implication of class SourceBuffer
+/// -----------------------------------------------------
+SourceBuffer::~SourceBuffer() {
+    if(IsMapped) {
+        munmap((void*)BufStart, getBufferSize());
+    }
+    else {
+        delete[] BufStart;
+    }
+}
+
+/// read the whole file by read(2), used when mmap is not available
+/// for this file, such as pipe or special file.
+static char *readWholeFile(int fd, size_t &size) {
+    size_t capacity = size ? size : 4096;
+    size_t length = 0;
+    char *buf = new char[capacity];
+    while(true) {
+        if(length == capacity) {
+            char *newBuf = new char[capacity * 2];
+            std::copy(buf, buf + length, newBuf);
+            delete[] buf;
+            buf = newBuf;
+            capacity *= 2;
+        }
+        ssize_t n = read(fd, buf + length, capacity - length);
+        if(n < 0) {
+            delete[] buf;
+            return nullptr;
+        }
+        if(n == 0)
+            break;
+        length += n;
+    }
+    size = length;
+    return buf;
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::getFile(const std::string &fileName) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    size_t size = S_ISREG(st.st_mode) ? (size_t)st.st_size : 0;
+    if(size > 0) {
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr != MAP_FAILED) {
+            madvise(addr, size, MADV_SEQUENTIAL);
+            close(fd);
+            const char *start = static_cast<const char*>(addr);
+            return std::unique_ptr<SourceBuffer>(new SourceBuffer(start, start + size, true));
+        }
+    }
+
+    char *buf = readWholeFile(fd, size);
+    close(fd);
+    if(!buf)
+        return nullptr;
+    return std::unique_ptr<SourceBuffer>(new SourceBuffer(buf, buf + size, false));
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::getMemBufferCopy(std::string_view source) {
+    char *buf = new char[source.size()];
+    std::copy(source.begin(), source.end(), buf);
+    return std::unique_ptr<SourceBuffer>(new SourceBuffer(buf, buf + source.size(), false));
+}
+/// -----------------------------------------------------
+
+}
@@ -0,0 +1,234 @@
+
+#include "statistic.h"
+#include "global_variable.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// the statistics are registered by the static
+/// constructors, the registry is created on first use so
+/// it don't depend on the order of the translation units
+static std::vector<KaleStatistic *> &getRegistry() {
+    static std::vector<KaleStatistic *> Registry;
+    return Registry;
+}
+
+struct ModuleValue {
+    std::string Module;
+    const char *Name;
+    uint64_t    Value;
+};
+
+struct PhaseMemory {
+    const char *Phase;
+    uint64_t    HeapInUse;          // bytes
+    int64_t     HeapDelta;          // bytes since the previous phase
+    uint64_t    Rss;                // bytes
+    uint64_t    PeakRss;            // bytes
+};
+
+bool KaleStatistics::Enabled = false;
+
+static std::mutex Lock;
+static std::atomic<uint64_t> AstNodeCounts[KaleStatistics::AstKindCount];
+static std::vector<ModuleValue> ModuleValues;
+static std::vector<PhaseMemory> Phases;
+static uint64_t LastHeapInUse = 0;
+
+static const char *AstKindNames[KaleStatistics::AstKindCount] = {
+    "Program", "Func", "FuncParam", "DataType", "TypeRef", "IdDef", "Variable", "Stmt",
+    "ExprStmt", "DataDecl", "Switch", "IfStmt", "ForStmt", "WhileStmt", "ReturnStmt", "BreakStmt",
+    "BlockStmt", "ContinueStmt", "Expr", "Initialize", "BinExpr", "UnaryExpr", "Literal", "Number",
+    "IdRef", "IdIndexedRef", "Call", "Lambda", "Struct",
+};
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+KaleStatistic::KaleStatistic(const char *group, const char *name, const char *desc)
+    : Group(group), Name(name), Desc(desc) {
+    getRegistry().push_back(this);
+}
+
+void KaleStatistic::updateMax(uint64_t n) {
+    uint64_t cur = Value.load(std::memory_order_relaxed);
+    while(cur < n && !Value.compare_exchange_weak(cur, n, std::memory_order_relaxed)) {}
+}
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// the bytes of the heap in use by malloc, the allocator
+/// of the ast arenas, the llvm modules and the maps
+static uint64_t getHeapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+    return (unsigned)info.uordblks + (unsigned)info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static uint64_t getRss() {
+    FILE *file = fopen("/proc/self/statm", "r");
+    if(!file)
+        return 0;
+    unsigned long long size = 0, resident = 0;
+    int n = fscanf(file, "%llu %llu", &size, &resident);
+    fclose(file);
+    return n == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+static uint64_t getPeakRss() {
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage))
+        return 0;
+    return (uint64_t)usage.ru_maxrss * 1024;
+}
+
+void KaleStatistics::enable() {
+    Enabled = true;
+    LastHeapInUse = getHeapInUse();
+}
+
+void KaleStatistics::addAstNodes(const uint32_t *counts) {
+    for(unsigned i = 0; i < AstKindCount; i++) {
+        if(counts[i])
+            AstNodeCounts[i].fetch_add(counts[i], std::memory_order_relaxed);
+    }
+}
+
+void KaleStatistics::addModuleValue(ProgramAST *prog, const char *name, uint64_t value) {
+    /// the programs of a compilation session have no input file
+    unsigned index = prog->getLineNo()->FileIndex;
+    std::string module = index < InputFileList.size() ? InputFileList[index] : "module" + std::to_string(index);
+    std::lock_guard<std::mutex> guard(Lock);
+    ModuleValues.push_back({module, name, value});
+}
+
+void KaleStatistics::recordPhase(const char *phase) {
+    std::lock_guard<std::mutex> guard(Lock);
+    uint64_t heap = getHeapInUse();
+    uint64_t rss = getRss();
+    /// the peak is counted by the kernel in another way than statm
+    uint64_t peak = std::max(rss, getPeakRss());
+    Phases.push_back({phase, heap, (int64_t)heap - (int64_t)LastHeapInUse, rss, peak});
+    LastHeapInUse = heap;
+}
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+static void printJsonString(const std::string &str) {
+    fputc('"', stderr);
+    for(unsigned char c : str) {
+        if(c == '"' || c == '\\')
+            fprintf(stderr, "\\%c", c);
+        else if(c < 0x20)
+            fprintf(stderr, "\\u%04x", c);
+        else
+            fputc(c, stderr);
+    }
+    fputc('"', stderr);
+}
+
+static void printText() {
+    fprintf(stderr, "===----------------------------------------------------------===\n");
+    fprintf(stderr, "                      kalecc statistics\n");
+    fprintf(stderr, "===----------------------------------------------------------===\n");
+    for(auto *stat : getRegistry()) {
+        if(stat->getValue())
+            fprintf(stderr, "%12llu %-14s - %s\n", (unsigned long long)stat->getValue(), stat->getGroup(), stat->getDesc());
+    }
+
+    fprintf(stderr, "\n  ast nodes created per kind\n");
+    for(unsigned i = 0; i < KaleStatistics::AstKindCount; i++) {
+        if(uint64_t count = AstNodeCounts[i].load(std::memory_order_relaxed))
+            fprintf(stderr, "%12llu %s\n", (unsigned long long)count, AstKindNames[i]);
+    }
+
+    if(!ModuleValues.empty()) {
+        fprintf(stderr, "\n  values per module\n");
+        for(auto &value : ModuleValues) {
+            fprintf(stderr, "%12llu %-14s - %s\n", (unsigned long long)value.Value, value.Name, value.Module.c_str());
+        }
+    }
+
+    if(!Phases.empty()) {
+        fprintf(stderr, "\n  memory at the end of each phase (KB)\n");
+        fprintf(stderr, "  %-14s %12s %12s %12s %12s\n", "Phase", "Heap", "Heap delta", "RSS", "Peak RSS");
+        for(auto &phase : Phases) {
+            fprintf(stderr, "  %-14s %12llu %12lld %12llu %12llu\n", phase.Phase,
+                    (unsigned long long)phase.HeapInUse / 1024, (long long)phase.HeapDelta / 1024,
+                    (unsigned long long)phase.Rss / 1024, (unsigned long long)phase.PeakRss / 1024);
+        }
+    }
+}
+
+static void printJson() {
+    fprintf(stderr, "{\n  \"statistics\": {");
+    const char *sep = "\n";
+    for(auto *stat : getRegistry()) {
+        fprintf(stderr, "%s    \"%s.%s\": %llu", sep, stat->getGroup(), stat->getName(),
+                (unsigned long long)stat->getValue());
+        sep = ",\n";
+    }
+    fprintf(stderr, "\n  },\n  \"ast_nodes\": {");
+    sep = "\n";
+    for(unsigned i = 0; i < KaleStatistics::AstKindCount; i++) {
+        if(uint64_t count = AstNodeCounts[i].load(std::memory_order_relaxed)) {
+            fprintf(stderr, "%s    \"%s\": %llu", sep, AstKindNames[i], (unsigned long long)count);
+            sep = ",\n";
+        }
+    }
+    fprintf(stderr, "\n  },\n  \"modules\": [");
+    sep = "\n";
+    for(auto &value : ModuleValues) {
+        fprintf(stderr, "%s    {\"module\": ", sep);
+        printJsonString(value.Module);
+        fprintf(stderr, ", \"name\": \"%s\", \"value\": %llu}", value.Name, (unsigned long long)value.Value);
+        sep = ",\n";
+    }
+    fprintf(stderr, "\n  ],\n  \"phases\": [");
+    sep = "\n";
+    for(auto &phase : Phases) {
+        fprintf(stderr, "%s    {\"phase\": \"%s\", \"heap_bytes\": %llu, \"heap_delta_bytes\": %lld, "
+                        "\"rss_bytes\": %llu, \"peak_rss_bytes\": %llu}", sep, phase.Phase,
+                (unsigned long long)phase.HeapInUse, (long long)phase.HeapDelta,
+                (unsigned long long)phase.Rss, (unsigned long long)phase.PeakRss);
+        sep = ",\n";
+    }
+    fprintf(stderr, "\n  ]\n}\n");
+}
+
+bool KaleStatistics::print(const std::string &format) {
+    std::lock_guard<std::mutex> guard(Lock);
+    /// the statistics are registered in the order of the static
+    /// constructors, print them sorted
+    std::stable_sort(getRegistry().begin(), getRegistry().end(), [](KaleStatistic *l, KaleStatistic *r) {
+        int cmp = strcmp(l->getGroup(), r->getGroup());
+        return cmp ? cmp < 0 : strcmp(l->getName(), r->getName()) < 0;
+    });
+    if(format == "text")
+        printText();
+    else if(format == "json")
+        printJson();
+    else
+        return false;
+    return true;
+}
+/// -----------------------------------------------------
+
+}
@@ -0,0 +1,106 @@
+
+#include "symbol.h"
+
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// @brief Storage of the interned strings, the id of a symbol
+/// is split into chunk index and index in the chunk. Chunks are
+/// allocated on demand and never released or moved.
+/// -----------------------------------------------------
+namespace {
+
+constexpr unsigned ChunkBits = 12;
+constexpr unsigned ChunkSize = 1u << ChunkBits;
+constexpr unsigned MaxChunks = 1u << 12;
+
+struct InternPool {
+    std::shared_mutex                               Lock;
+    std::unordered_map<std::string_view, unsigned>  Ids;
+    std::atomic<std::string *>                      Chunks[MaxChunks];
+    unsigned                                        Count = 0;
+
+    InternPool() {
+        for(auto &chunk : Chunks)
+            chunk.store(nullptr, std::memory_order_relaxed);
+        /// id 0 is the empty name
+        insert(std::string_view());
+    }
+
+    ~InternPool() {
+        for(auto &chunk : Chunks)
+            delete[] chunk.load(std::memory_order_relaxed);
+    }
+
+    std::string &slot(unsigned id) {
+        return Chunks[id >> ChunkBits].load(std::memory_order_acquire)[id & (ChunkSize - 1)];
+    }
+
+    /// must be called with the unique lock held
+    unsigned insert(std::string_view str) {
+        unsigned id = Count;
+        unsigned chunkIdx = id >> ChunkBits;
+        assert(chunkIdx < MaxChunks && "too many symbols");
+        if(!Chunks[chunkIdx].load(std::memory_order_relaxed))
+            Chunks[chunkIdx].store(new std::string[ChunkSize], std::memory_order_release);
+        std::string &s = slot(id);
+        s.assign(str.data(), str.size());
+        Ids.insert({std::string_view(s), id});
+        Count++;
+        return id;
+    }
+};
+
+InternPool &getPool() {
+    static InternPool Pool;
+    return Pool;
+}
+
+}
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// @brief Code implication of class SymbolTable and Symbol
+/// -----------------------------------------------------
+Symbol SymbolTable::intern(std::string_view str) {
+    InternPool &pool = getPool();
+    {
+        std::shared_lock<std::shared_mutex> lock(pool.Lock);
+        auto it = pool.Ids.find(str);
+        if(it != pool.Ids.end())
+            return Symbol(it->second);
+    }
+    std::unique_lock<std::shared_mutex> lock(pool.Lock);
+    auto it = pool.Ids.find(str);
+    if(it != pool.Ids.end())
+        return Symbol(it->second);
+    return Symbol(pool.insert(str));
+}
+
+const std::string &SymbolTable::getString(Symbol sym) {
+    return getPool().slot(sym.getId());
+}
+
+unsigned SymbolTable::getSymbolCount() {
+    InternPool &pool = getPool();
+    std::shared_lock<std::shared_mutex> lock(pool.Lock);
+    return pool.Count;
+}
+
+Symbol Symbol::intern(std::string_view str) {
+    return SymbolTable::intern(str);
+}
+
+const std::string &Symbol::str() const {
+    return SymbolTable::getString(*this);
+}
+/// -----------------------------------------------------
+
+}
@@ -0,0 +1,302 @@
+
+#include "tiered_jit.h"
+#include "jit_runner.h"
+#include "ir_optimizer.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include <unordered_map>
+
+namespace kale {
+
+/// the optimized copy of a function is compiled in a module of this suffix
+static const char *OptimizedSuffix = "$tier1";
+static const char *BaselineSuffix = "$tier0";
+static const char *TierUpFuncName = "__kale_tier_up";
+
+/// ------------------------------------------------------------------------
+/// @brief the compiler of the tiered jit, the baseline modules are compiled
+/// fast without codegen optimization and the optimized ones with the
+/// codegen of the opt level
+/// ------------------------------------------------------------------------
+class KaleTieredCompiler : public llvm::orc::IRCompileLayer::IRCompiler {
+private:
+    llvm::orc::SimpleCompiler BaselineCompiler;
+    llvm::orc::SimpleCompiler OptimizedCompiler;
+
+public:
+    KaleTieredCompiler(llvm::TargetMachine &baselineTM, llvm::TargetMachine &optimizedTM)
+        : IRCompiler(llvm::orc::irManglingOptionsFromTargetOptions(baselineTM.Options)),
+          BaselineCompiler(baselineTM), OptimizedCompiler(optimizedTM) {}
+
+    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(llvm::Module &M) override {
+        if(llvm::StringRef(M.getModuleIdentifier()).endswith(OptimizedSuffix))
+            return OptimizedCompiler(M);
+        return BaselineCompiler(M);
+    }
+};
+/// ------------------------------------------------------------------------
+
+/// -----------------------------------------------------
+/// @brief Code implication of class KaleTieredJIT
+/// -----------------------------------------------------
+KaleTieredJIT::KaleTieredJIT(KaleOptLevel level, unsigned threshold)
+    : Level(level), Threshold(threshold ? threshold : 1) {}
+
+KaleTieredJIT::~KaleTieredJIT() {
+    {
+        std::lock_guard<std::mutex> guard(QueueLock);
+        Stopping = true;
+    }
+    QueueCond.notify_all();
+    if(Worker.joinable())
+        Worker.join();
+
+    /// the baseline copies live in the contexts owned by the jit
+    for(auto &baseline : Baselines) {
+        auto lock = baseline.second.getLock();
+        baseline.first.reset();
+    }
+    Functions.clear();
+    J.reset();
+}
+
+llvm::Expected<std::unique_ptr<KaleTieredJIT>> KaleTieredJIT::create(KaleOptLevel level, unsigned threshold) {
+    std::unique_ptr<KaleTieredJIT> tiered(new KaleTieredJIT(level, threshold));
+
+    auto baselineJTMB = KaleJITRunner::detectHost(O0);
+    if(!baselineJTMB)
+        return baselineJTMB.takeError();
+    auto optimizedJTMB = KaleJITRunner::detectHost(level);
+    if(!optimizedJTMB)
+        return optimizedJTMB.takeError();
+    auto baselineTM = baselineJTMB->createTargetMachine();
+    if(!baselineTM)
+        return baselineTM.takeError();
+    auto optimizedTM = optimizedJTMB->createTargetMachine();
+    if(!optimizedTM)
+        return optimizedTM.takeError();
+    auto optimizerTM = optimizedJTMB->createTargetMachine();
+    if(!optimizerTM)
+        return optimizerTM.takeError();
+    tiered->BaselineTM = std::move(*baselineTM);
+    tiered->OptimizedTM = std::move(*optimizedTM);
+    tiered->OptimizerTM = std::move(*optimizerTM);
+
+    llvm::orc::LLJITBuilder builder;
+    builder.setJITTargetMachineBuilder(std::move(*baselineJTMB));
+    auto *self = tiered.get();
+    builder.setCompileFunctionCreator([self](llvm::orc::JITTargetMachineBuilder)
+            -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+        return std::make_unique<KaleTieredCompiler>(*self->BaselineTM, *self->OptimizedTM);
+    });
+    auto J = builder.create();
+    if(!J)
+        return J.takeError();
+    tiered->J = std::move(*J);
+    if(auto err = KaleJITRunner::defineStdSymbols(*tiered->J))
+        return std::move(err);
+
+    tiered->Stubs = llvm::orc::createLocalIndirectStubsManagerBuilder(tiered->J->getTargetTriple())();
+    if(!tiered->Stubs)
+        return llvm::make_error<llvm::StringError>("no indirect stubs for the target " + tiered->J->getTargetTriple().str(),
+                                                   llvm::inconvertibleErrorCode());
+
+    llvm::orc::SymbolMap symbols;
+    symbols[tiered->J->mangleAndIntern(TierUpFuncName)] =
+        llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&KaleTieredJIT::requestTierUp),
+                                 llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+    if(auto err = tiered->J->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols))))
+        return std::move(err);
+
+    tiered->Worker = std::thread(&KaleTieredJIT::runWorker, tiered.get());
+    return std::move(tiered);
+}
+
+void KaleTieredJIT::instrumentFunction(llvm::Function &F, unsigned id) {
+    llvm::Module &M = *F.getParent();
+    llvm::LLVMContext &ctx = M.getContext();
+    auto *int32Ty = llvm::Type::getInt32Ty(ctx);
+    auto *int8PtrTy = llvm::Type::getInt8PtrTy(ctx);
+
+    auto *counter = new llvm::GlobalVariable(M, int32Ty, false, llvm::GlobalValue::InternalLinkage,
+                                             llvm::ConstantInt::get(int32Ty, 0), F.getName() + ".count");
+    auto tierUp = M.getOrInsertFunction(TierUpFuncName, llvm::Type::getVoidTy(ctx), int8PtrTy, int32Ty);
+    auto *self = llvm::ConstantExpr::getIntToPtr(
+        llvm::ConstantInt::get(llvm::Type::getInt64Ty(ctx), reinterpret_cast<uint64_t>(this)), int8PtrTy);
+
+    /// the entry is counted before the terminator of the entry block, so the
+    /// allocas stay in it. A back edge is a branch to a block laid before,
+    /// the loops of the ir builder always have their header first
+    std::vector<llvm::Instruction *> points;
+    std::unordered_map<llvm::BasicBlock *, unsigned> order;
+    unsigned index = 0;
+    for(auto &bblk : F) {
+        order[&bblk] = index++;
+    }
+    for(auto &bblk : F) {
+        auto *term = bblk.getTerminator();
+        if(!term)
+            continue;
+        bool counted = &bblk == &F.getEntryBlock();
+        for(unsigned i = 0; i < term->getNumSuccessors() && !counted; i++) {
+            counted = order[term->getSuccessor(i)] <= order[&bblk];
+        }
+        if(counted)
+            points.push_back(term);
+    }
+
+    /// the counter is not atomic, a lost count only delay the tier up
+    for(auto *point : points) {
+        llvm::IRBuilder<> builder(point);
+        auto *count = builder.CreateAdd(builder.CreateLoad(int32Ty, counter), llvm::ConstantInt::get(int32Ty, 1));
+        builder.CreateStore(count, counter);
+        auto *hot = builder.CreateICmpEQ(count, llvm::ConstantInt::get(int32Ty, Threshold));
+        auto *then = llvm::SplitBlockAndInsertIfThen(hot, point, false);
+        builder.SetInsertPoint(then);
+        builder.CreateCall(tierUp, {self, llvm::ConstantInt::get(int32Ty, id)});
+    }
+}
+
+llvm::Error KaleTieredJIT::addModule(llvm::orc::ThreadSafeModule TSM) {
+    llvm::orc::ThreadSafeContext context = TSM.getContext();
+    llvm::orc::SymbolMap stubSymbols;
+
+    auto err = TSM.withModuleDo([&](llvm::Module &M) -> llvm::Error {
+        M.setDataLayout(J->getDataLayout());
+        M.setTargetTriple(J->getTargetTriple().str());
+
+        /// the body of a function is renamed, the calls to it, from this
+        /// module or others, are made to the stub of its name. main is
+        /// called once, it is never tiered up
+        std::vector<llvm::Function *> bodies;
+        for(auto &F : M) {
+            if(!F.isDeclaration() && F.getName() != "main")
+                bodies.push_back(&F);
+        }
+        std::vector<unsigned> ids;
+        for(auto *F : bodies) {
+            std::string name = F->getName().str();
+            F->setName(name + BaselineSuffix);
+            auto *decl = llvm::Function::Create(F->getFunctionType(), llvm::GlobalValue::ExternalLinkage, name, M);
+            F->replaceAllUsesWith(decl);
+
+            ids.push_back(Functions.size());
+            Functions.push_back({name, nullptr, context, false});
+            if(auto err = Stubs->createStub(name, 0, llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable))
+                return err;
+            auto stub = Stubs->findStub(name, false);
+            stubSymbols[J->mangleAndIntern(name)] = stub;
+        }
+
+        /// the optimized code is cloned from the module without counters
+        Baselines.emplace_back(llvm::CloneModule(M), context);
+        for(unsigned i = 0; i < bodies.size(); i++) {
+            Functions[ids[i]].Baseline = Baselines.back().first.get();
+            instrumentFunction(*bodies[i], ids[i]);
+        }
+        return llvm::Error::success();
+    });
+    if(err)
+        return err;
+
+    if(!stubSymbols.empty()) {
+        if(auto err = J->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(stubSymbols))))
+            return err;
+    }
+    return J->addIRModule(std::move(TSM));
+}
+
+llvm::Error KaleTieredJIT::compileBaseline() {
+    for(; BaselineCount < Functions.size(); BaselineCount++) {
+        auto &func = Functions[BaselineCount];
+        auto sym = J->lookup(func.Name + BaselineSuffix);
+        if(!sym)
+            return sym.takeError();
+#if LLVM_VERSION_MAJOR >= 15
+        llvm::JITTargetAddress addr = sym->getValue();
+#else
+        llvm::JITTargetAddress addr = sym->getAddress();
+#endif
+        if(auto err = Stubs->updatePointer(func.Name, addr))
+            return err;
+    }
+    return llvm::Error::success();
+}
+
+void KaleTieredJIT::requestTierUp(KaleTieredJIT *self, int id) {
+    {
+        std::lock_guard<std::mutex> guard(self->QueueLock);
+        auto &func = self->Functions[id];
+        if(func.Requested)
+            return;
+        func.Requested = true;
+        self->Queue.push_back(id);
+    }
+    self->QueueCond.notify_one();
+}
+
+void KaleTieredJIT::runWorker() {
+    while(true) {
+        unsigned id;
+        {
+            std::unique_lock<std::mutex> lock(QueueLock);
+            QueueCond.wait(lock, [this] { return Stopping || !Queue.empty(); });
+            if(Stopping)
+                return;
+            id = Queue.front();
+            Queue.pop_front();
+        }
+        /// the function keep running its baseline code if it fail
+        if(auto err = compileOptimized(id))
+            llvm::logAllUnhandledErrors(std::move(err), llvm::errs(), "kalecc jit: tier up failed: ");
+    }
+}
+
+llvm::Error KaleTieredJIT::compileOptimized(unsigned id) {
+    auto &func = Functions[id];
+    std::string bodyName = func.Name + BaselineSuffix;
+    std::string optimizedName = func.Name + OptimizedSuffix;
+
+    std::unique_ptr<llvm::Module> optimized;
+    {
+        auto lock = func.Context.getLock();
+        /// only the function and the private constants it may use are
+        /// defined, the others are declared and resolved to the baseline
+        /// module or the stubs
+        llvm::ValueToValueMapTy VMap;
+        optimized = llvm::CloneModule(*func.Baseline, VMap, [&bodyName](const llvm::GlobalValue *GV) {
+            auto *var = llvm::dyn_cast<llvm::GlobalVariable>(GV);
+            return GV->getName() == bodyName || (var && var->hasLocalLinkage() && var->isConstant());
+        });
+        optimized->setModuleIdentifier(func.Name + OptimizedSuffix);
+        optimized->getFunction(bodyName)->setName(optimizedName);
+        KaleIROptimizer::optimizeModule(*optimized, OptimizerTM.get(), Level);
+    }
+
+    if(auto err = J->addIRModule(llvm::orc::ThreadSafeModule(std::move(optimized), func.Context)))
+        return err;
+    auto sym = J->lookup(optimizedName);
+    if(!sym)
+        return sym.takeError();
+#if LLVM_VERSION_MAJOR >= 15
+    llvm::JITTargetAddress addr = sym->getValue();
+#else
+    llvm::JITTargetAddress addr = sym->getAddress();
+#endif
+    /// the pointer of the stub is a machine word, the calls running see
+    /// either the baseline or the optimized code
+    if(auto err = Stubs->updatePointer(func.Name, addr))
+        return err;
+    TieredUpCount++;
+    return llvm::Error::success();
+}
+/// -----------------------------------------------------
+
+}
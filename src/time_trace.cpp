@@ -0,0 +1,209 @@
+
+#include "time_trace.h"
+#include "global_variable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// the events of all the threads, a scope end in any
+/// thread so they are pushed under the lock
+struct TraceEvent {
+    const char *Name;
+    std::string Detail;
+    uint64_t    Start;
+    uint64_t    Duration;
+    uint64_t    CpuDuration;
+    unsigned    Tid;
+};
+
+bool KaleTimeTrace::Enabled = false;
+
+static std::mutex Lock;
+static std::vector<TraceEvent> Events;
+static std::chrono::steady_clock::time_point BeginTime;
+static uint64_t BeginCpuTime = 0;
+static std::atomic<unsigned> NextThreadId{0};
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+static uint64_t getProcessCpuTime() {
+    struct timespec ts;
+    if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts))
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void KaleTimeTrace::begin() {
+    BeginTime = std::chrono::steady_clock::now();
+    Enabled = true;
+    BeginCpuTime = getProcessCpuTime();
+    Events.clear();
+    /// the driver thread is the thread 0
+    getThreadId();
+}
+
+uint64_t KaleTimeTrace::getWallTime() {
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now - BeginTime).count();
+}
+
+uint64_t KaleTimeTrace::getCpuTime() {
+    struct timespec ts;
+    if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+unsigned KaleTimeTrace::getThreadId() {
+    static thread_local unsigned Tid = NextThreadId++;
+    return Tid;
+}
+
+void KaleTimeTrace::record(const char *name, const std::string &detail, uint64_t start, uint64_t cpuStart, unsigned tid) {
+    uint64_t end = getWallTime();
+    uint64_t cpuEnd = getCpuTime();
+    std::lock_guard<std::mutex> guard(Lock);
+    Events.push_back({name, detail, start, end - start, cpuEnd - cpuStart, tid});
+}
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+void KaleTimeTraceScope::start() {
+    Tid = KaleTimeTrace::getThreadId();
+    CpuStart = KaleTimeTrace::getCpuTime();
+    Start = KaleTimeTrace::getWallTime();
+}
+
+KaleTimeTraceScope::KaleTimeTraceScope(const char *name, ProgramAST *prog) : Name(name), Active(KaleTimeTrace::isEnabled()) {
+    if(!Active)
+        return;
+    /// the programs of a compilation session have no input file
+    unsigned index = prog->getLineNo()->FileIndex;
+    if(index < InputFileList.size())
+        Detail = InputFileList[index];
+    start();
+}
+/// -----------------------------------------------------
+
+
+/// -----------------------------------------------------
+static void writeJsonString(FILE *out, const std::string &str) {
+    fputc('"', out);
+    for(unsigned char c : str) {
+        switch(c) {
+            case '"':  fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '\n': fputs("\\n", out); break;
+            case '\t': fputs("\\t", out); break;
+            default: {
+                if(c < 0x20)
+                    fprintf(out, "\\u%04x", c);
+                else
+                    fputc(c, out);
+            }
+        }
+    }
+    fputc('"', out);
+}
+
+/// the events are complete events, ph X, the times are in micro seconds
+static bool writeTraceFile(const std::string &file) {
+    FILE *out = fopen(file.c_str(), "w");
+    if(!out) {
+        fprintf(stderr, "kalecc: could not open the time trace file %s\n", file.c_str());
+        return false;
+    }
+    int pid = 1;
+    fprintf(out, "{\"traceEvents\":[\n");
+    for(size_t i = 0; i < Events.size(); i++) {
+        const TraceEvent &event = Events[i];
+        fprintf(out, "{\"name\":");
+        writeJsonString(out, event.Name);
+        fprintf(out, ",\"cat\":\"kalecc\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%u,\"args\":{",
+                (unsigned long long)event.Start, (unsigned long long)event.Duration, pid, event.Tid);
+        if(!event.Detail.empty()) {
+            fprintf(out, "\"detail\":");
+            writeJsonString(out, event.Detail);
+            fprintf(out, ",");
+        }
+        fprintf(out, "\"cpu_us\":%llu}},\n", (unsigned long long)event.CpuDuration);
+    }
+    /// name the threads, the one run the driver is the first
+    unsigned threads = NextThreadId.load();
+    for(unsigned tid = 0; tid < threads; tid++) {
+        fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s%u\"}}%s\n",
+                pid, tid, tid ? "kalecc worker " : "kalecc main ", tid, tid + 1 < threads ? "," : "");
+    }
+    fprintf(out, "],\"displayTimeUnit\":\"ms\"}\n");
+    bool success = !ferror(out);
+    fclose(out);
+    return success;
+}
+
+/// the events of a name are summed, the nested scopes are also counted in
+/// the scopes they are in, so the percents don't add up to 100
+static void printReport() {
+    struct Entry {
+        const char *Name;
+        unsigned    Count;
+        uint64_t    Wall;
+        uint64_t    Cpu;
+    };
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, size_t> index;
+    uint64_t total = 1;
+    for(auto &event : Events) {
+        auto found = index.insert({event.Name, entries.size()});
+        if(found.second)
+            entries.push_back({event.Name, 0, 0, 0});
+        Entry &entry = entries[found.first->second];
+        entry.Count++;
+        entry.Wall += event.Duration;
+        entry.Cpu += event.CpuDuration;
+        if(std::string(event.Name) == "Total")
+            total = std::max<uint64_t>(event.Duration, 1);
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &l, const Entry &r) {
+        return l.Wall > r.Wall;
+    });
+
+    fprintf(stderr, "===----------------------------------------------------------===\n");
+    fprintf(stderr, "                      kalecc time report\n");
+    fprintf(stderr, "===----------------------------------------------------------===\n");
+    fprintf(stderr, "  %8s  %12s  %12s  %7s  %s\n", "Count", "Wall (ms)", "CPU (ms)", "Wall %", "Name");
+    for(auto &entry : entries) {
+        fprintf(stderr, "  %8u  %12.3f  %12.3f  %6.1f%%  %s\n", entry.Count, entry.Wall / 1000.0,
+                entry.Cpu / 1000.0, entry.Wall * 100.0 / total, entry.Name);
+    }
+}
+
+void KaleTimeTrace::finish(const std::string &traceFile, bool report) {
+    if(!Enabled)
+        return;
+    Enabled = false;
+    std::lock_guard<std::mutex> guard(Lock);
+    /// the cpu time of the Total is of all the threads
+    Events.push_back({"Total", std::string(), 0, getWallTime(), getProcessCpuTime() - BeginCpuTime, getThreadId()});
+    std::stable_sort(Events.begin(), Events.end(), [](const TraceEvent &l, const TraceEvent &r) {
+        return l.Start < r.Start;
+    });
+    if(!traceFile.empty())
+        writeTraceFile(traceFile);
+    if(report)
+        printReport();
+    Events.clear();
+}
+/// -----------------------------------------------------
+
+}
@@ -5,9 +5,25 @@
 #include "type_checker.h"
 #include "ast.h"
 #include "cast.h"
+#include "time_trace.h"
+#include "statistic.h"
 
 namespace kale {
 
+    KALE_STATISTIC(FunctionsChecked,      "typecheck", "Number of functions type checked");
+    KALE_STATISTIC(ConstOperandsRetyped,  "typecheck", "Number of constant operands given the type of the other operand");
+
+    void TypeChecker::setError(const std::string &msg, ExprAST *node) {
+        if(ErrorMsg.empty())
+            ErrorMsg = std::to_string(node->getLineNo()->Row) + "-" + std::to_string(node->getLineNo()->Col) + " " + msg;
+    }
+
+    void TypeChecker::visit(FuncAST *node) {
+        KaleTimeTraceScope scope("TypeCheckFunction", node->getFuncName());
+        ++FunctionsChecked;
+        StaticAstVisitor::visit(node);
+    }
+
     bool TypeChecker::matchType(ExprAST *l, ExprAST *r) {
         if(l->getExprType() == r->getExprType()) {
             return true;
@@ -24,6 +40,7 @@ namespace kale {
             if(lsize == rsize) {
                 if(l->isSign()) {r->setIsSigned(l->isSign()); r->setExprType(l->getExprType()); return true;}
                 else if(r->isSign()) {l->setIsSigned(r->isSign());l->setExprType(r->getExprType()); return false;}
+                else {r->setExprType(l->getExprType()); return true;}
             }
             else if(lsize > rsize) {
                 r->setIsSigned(l->isSign()); r->setExprType(l->getExprType()); return true;
@@ -47,8 +64,7 @@ namespace kale {
             case ULong: return 64;
             case Float: return 32;
             case Double: return 64;
-            default:
-                assert(false && "un support type");
+            default: return 0;
         }
     }
 
@@ -119,7 +135,7 @@ namespace kale {
     void TypeChecker::visit(kale::IdIndexedRefAST *node) {
         node->setExprType(node->getId()->getDataType()->getDataType());
         node->setIsSigned(isSigned(node->getExprType()));
-        AstVisitor::visit(node);
+        StaticAstVisitor::visit(node);
     }
 
     void TypeChecker::visit(kale::CallExprAST *node) {
@@ -145,18 +161,24 @@ namespace kale {
             node->setExprType(node->getFuncDef()->getRetType()->getDataType());
             node->setIsSigned(isSigned(node->getExprType()));
         }
-        AstVisitor::visit(node);
+        StaticAstVisitor::visit(node);
     }
 
     void TypeChecker::visit(kale::UnaryExprAST *node) {
-        node->getUnaryExpr()->accept(*this);
+        traverse(node->getUnaryExpr());
         node->setExprType(node->getUnaryExpr()->getExprType());
         node->setIsSigned(node->getUnaryExpr()->isSign());
     }
 
     void TypeChecker::visit(kale::BinaryExprAST *node) {
-        node->getLhs()->accept(*this);
-        node->getRhs()->accept(*this);
+        traverse(node->getLhs());
+        traverse(node->getRhs());
+        /// a void call or a string has no size, it can't be matched
+        if(!getTypeSize(node->getLhs()->getExprType()) || !getTypeSize(node->getRhs()->getExprType())) {
+            setError("a string or void value can't be an operand", node);
+            node->setExprType(Void);
+            return;
+        }
         if(isConstant(node)) {
             if(matchType(node->getLhs(), node->getRhs())) {
                 node->setExprType(node->getLhs()->getExprType());
@@ -168,12 +190,14 @@ namespace kale {
             }
         }
         else if(isConstant(node->getLhs())) {
+            ++ConstOperandsRetyped;
             node->getLhs()->setExprType(node->getRhs()->getExprType());
             node->getLhs()->setIsSigned(node->getRhs()->isSign());
             node->setExprType(node->getRhs()->getExprType());
             node->setIsSigned(node->getRhs()->isSign());
         }
         else if(isConstant(node->getRhs())) {
+            ++ConstOperandsRetyped;
             node->getRhs()->setExprType(node->getLhs()->getExprType());
             node->getRhs()->setIsSigned(node->getLhs()->isSign());
             node->setExprType(node->getLhs()->getExprType());
@@ -192,8 +216,9 @@ namespace kale {
     }
 
     void TypeChecker::visit(kale::NumberExprAST *node) {
-        // do nothing
-        node->setIsSigned(node->isSigned());
+        /// the sign of the literal is the sign of the expr, NumberExprAST
+        /// hide the setter of ExprAST
+        static_cast<ExprAST *>(node)->setIsSigned(node->isSigned());
         if(node->isBoolLiteral()) node->setExprType(Bool);
         else if(node->isChar()) {
             if(node->isSigned()) node->setExprType(Char);
@@ -0,0 +1,408 @@
+#include "vm.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+/// the labels as values extension of gcc and clang make each instruction
+/// jump to the next one itself, the branch of each op is predicted alone
+#if defined(__GNUC__)
+#define KALE_VM_COMPUTED_GOTO
+#endif
+
+namespace kale {
+
+/// ----------------------------------------------------------
+/// @brief the formatter of Print and PrintLn, the args are in registers
+/// so each conversion of format is printed alone with an arg of the type
+/// it expects
+static void printFormat(const char *format, VMValue *args, unsigned count) {
+    unsigned next = 0;
+    const char *p = format;
+    while(*p) {
+        if(*p != '%') {
+            const char *end = std::strchr(p, '%');
+            size_t len = end ? (size_t)(end - p) : std::strlen(p);
+            std::fwrite(p, 1, len, stdout);
+            p += len;
+            continue;
+        }
+        if(p[1] == '%') {
+            std::fputc('%', stdout);
+            p += 2;
+            continue;
+        }
+
+        /// %[flags][width][.precision][length]conversion
+        std::string spec = "%";
+        const char *q = p + 1;
+        while(*q && std::strchr("-+ #0", *q)) spec += *q++;
+        while(*q >= '0' && *q <= '9') spec += *q++;
+        if(*q == '.') {
+            spec += *q++;
+            while(*q >= '0' && *q <= '9') spec += *q++;
+        }
+        std::string length;
+        while(*q && std::strchr("hlLqjzt", *q)) length += *q++;
+        char conv = *q;
+        if(!conv) {
+            std::fputs(p, stdout);
+            return;
+        }
+        p = q + 1;
+
+        VMValue arg;
+        arg.U = 0;
+        if(next < count)
+            arg = args[next++];
+        switch (conv) {
+            case 'd':
+            case 'i': {
+                long long v = arg.I;
+                if(length == "hh") v = (signed char)v;
+                else if(length == "h") v = (short)v;
+                else if(length.empty()) v = (int)v;
+                std::printf((spec + "ll" + conv).c_str(), v);
+                break;
+            }
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X': {
+                unsigned long long v = arg.U;
+                if(length == "hh") v = (unsigned char)v;
+                else if(length == "h") v = (unsigned short)v;
+                else if(length.empty()) v = (unsigned)v;
+                std::printf((spec + "ll" + conv).c_str(), v);
+                break;
+            }
+            case 'c':
+                std::printf((spec + conv).c_str(), (int)arg.I);
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                std::printf((spec + conv).c_str(), arg.F);
+                break;
+            case 's':
+                std::printf((spec + conv).c_str(), arg.S ? arg.S : "(null)");
+                break;
+            case 'p':
+                std::printf((spec + conv).c_str(), (void *)arg.S);
+                break;
+            default:
+                /// an unknown conversion is printed as it is
+                std::fwrite(spec.c_str(), 1, spec.size(), stdout);
+                std::fwrite(length.c_str(), 1, length.size(), stdout);
+                std::fputc(conv, stdout);
+                break;
+        }
+    }
+}
+/// ----------------------------------------------------------
+
+
+/// -----------------------------------------------------
+/// @brief Code implication of class KaleVM
+/// -----------------------------------------------------
+KaleVM::KaleVM(VMModule &module) : Module(module) {}
+
+bool KaleVM::link() {
+    FunctionTable.clear();
+    for(auto &func : Module.Functions) {
+        if(!func.Defined) {
+            ErrorMsg = "undefined reference to function '" + func.Name + "'";
+            return false;
+        }
+        FunctionTable.push_back(&func);
+    }
+    auto it = Module.FunctionSlots.find("main");
+    if(it == Module.FunctionSlots.end()) {
+        ErrorMsg = "undefined reference to function 'main'";
+        return false;
+    }
+    MainSlot = it->second;
+    Linked = true;
+    return true;
+}
+
+bool KaleVM::runtimeError(const VMFunction *func, const VMInst *pc, const std::string &msg) {
+    ErrorMsg = msg + " in function '" + func->Name + "' at " +
+               std::to_string(pc - func->Code.data());
+    return false;
+}
+
+void KaleVM::callStd(uint8_t func, VMValue *args, unsigned count, VMValue &result) {
+    result.U = 0;
+    switch (func) {
+        case StdPrint:
+        case StdPrintLn: {
+            if(count)
+                printFormat(args[0].S, args + 1, count - 1);
+            if(func == StdPrintLn)
+                std::fputc('\n', stdout);
+            break;
+        }
+        case StdGetInt: {
+            int value = 0;
+            if(std::scanf("%d", &value) != 1)
+                value = 0;
+            result.I = value;
+            break;
+        }
+        case StdGetDouble: {
+            double value = 0;
+            if(std::scanf("%lf", &value) != 1)
+                value = 0;
+            result.F = value;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool KaleVM::execute(unsigned slot, VMValue &result) {
+    const VMFunction *func = FunctionTable[slot];
+    VMValue *stackEnd = Stack.get() + StackSize;
+    VMValue *R = Stack.get();
+    if(func->FrameSize > StackSize)
+        return runtimeError(func, func->Code.data(), "stack overflow");
+    std::memset((void *)R, 0, sizeof(VMValue) * func->FrameSize);
+    const VMValue *K = Module.Constants.data();
+    VMValue *G = Globals.data();
+    const VMInst *code = func->Code.data();
+    const VMInst *pc = code;
+    Frames.clear();
+
+#ifdef KALE_VM_COMPUTED_GOTO
+    static void *Labels[] = {
+#define KALE_VM_OPCODE_LABEL(op) &&L_##op,
+        KALE_VM_OPCODES(KALE_VM_OPCODE_LABEL)
+#undef KALE_VM_OPCODE_LABEL
+    };
+#define VM_CASE(op)     L_##op:
+#define VM_DISPATCH()   goto *Labels[pc->Op]
+#else
+#define VM_CASE(op)     case Op##op:
+#define VM_DISPATCH()   continue
+#endif
+#define VM_NEXT()       { ++pc; VM_DISPATCH(); }
+#define VM_JUMP(target) { pc = code + (target); VM_DISPATCH(); }
+#define VM_JUMP_IF(c)   { if(c) { VM_JUMP(pc->Imm) } VM_NEXT() }
+#define RA              R[pc->A]
+#define RB              R[pc->B]
+#define RC              R[pc->C]
+
+#ifdef KALE_VM_COMPUTED_GOTO
+    VM_DISPATCH();
+#else
+    for(;;) switch (pc->Op) {
+#endif
+    VM_CASE(Mov)    RA = RB; VM_NEXT()
+    VM_CASE(LoadK)  RA = K[pc->Imm]; VM_NEXT()
+    VM_CASE(LoadI)  RA.I = (int32_t)pc->Imm; VM_NEXT()
+    VM_CASE(Add)    RA.U = normalizeValue(RB.U + RC.U, pc->Aux); VM_NEXT()
+    VM_CASE(AddI)   RA.U = normalizeValue(RB.U + (uint64_t)(int64_t)(int32_t)pc->Imm, pc->Aux); VM_NEXT()
+    VM_CASE(Sub)    RA.U = normalizeValue(RB.U - RC.U, pc->Aux); VM_NEXT()
+    VM_CASE(Mul)    RA.U = normalizeValue(RB.U * RC.U, pc->Aux); VM_NEXT()
+    VM_CASE(MulI)   RA.U = normalizeValue(RB.U * (uint64_t)(int64_t)(int32_t)pc->Imm, pc->Aux); VM_NEXT()
+    VM_CASE(SDiv) {
+        if(!RC.I)
+            return runtimeError(func, pc, "division by zero");
+        /// INT64_MIN / -1 overflow, it wrap like the other ops
+        RA.U = RC.I == -1 ? normalizeValue(0 - RB.U, pc->Aux) : normalizeValue(RB.I / RC.I, pc->Aux);
+        VM_NEXT()
+    }
+    VM_CASE(UDiv) {
+        if(!RC.U)
+            return runtimeError(func, pc, "division by zero");
+        RA.U = normalizeValue(RB.U / RC.U, pc->Aux);
+        VM_NEXT()
+    }
+    VM_CASE(And)    RA.U = normalizeValue(RB.U & RC.U, pc->Aux); VM_NEXT()
+    VM_CASE(Or)     RA.U = normalizeValue(RB.U | RC.U, pc->Aux); VM_NEXT()
+    VM_CASE(Xor)    RA.U = normalizeValue(RB.U ^ RC.U, pc->Aux); VM_NEXT()
+    VM_CASE(Shl)    RA.U = normalizeValue(RB.U << (RC.U & 63), pc->Aux); VM_NEXT()
+    VM_CASE(LShr)   RA.U = normalizeValue(RB.U >> (RC.U & 63), pc->Aux); VM_NEXT()
+    VM_CASE(Neg)    RA.U = normalizeValue(0 - RB.U, pc->Aux); VM_NEXT()
+    VM_CASE(Not)    RA.I = RB.U == 0; VM_NEXT()
+    VM_CASE(LAnd)   RA.I = RB.U != 0 && RC.U != 0; VM_NEXT()
+    VM_CASE(LOr)    RA.I = RB.U != 0 || RC.U != 0; VM_NEXT()
+    VM_CASE(Norm)   RA.U = normalizeValue(RB.U, pc->Aux); VM_NEXT()
+    VM_CASE(FAdd)   RA.F = pc->Aux ? (double)(float)(RB.F + RC.F) : RB.F + RC.F; VM_NEXT()
+    VM_CASE(FSub)   RA.F = pc->Aux ? (double)(float)(RB.F - RC.F) : RB.F - RC.F; VM_NEXT()
+    VM_CASE(FMul)   RA.F = pc->Aux ? (double)(float)(RB.F * RC.F) : RB.F * RC.F; VM_NEXT()
+    VM_CASE(FDiv)   RA.F = pc->Aux ? (double)(float)(RB.F / RC.F) : RB.F / RC.F; VM_NEXT()
+    VM_CASE(FNeg)   RA.F = -RB.F; VM_NEXT()
+    VM_CASE(FRound) RA.F = (double)(float)RB.F; VM_NEXT()
+    VM_CASE(U2F)    RA.F = pc->Aux ? (double)(float)RB.U : (double)RB.U; VM_NEXT()
+    VM_CASE(F2I) {
+        double v = RB.F;
+        uint64_t bits = v >= 9223372036854775808.0 ? (uint64_t)v : (uint64_t)(int64_t)v;
+        RA.U = normalizeValue(bits, pc->Aux);
+        VM_NEXT()
+    }
+    VM_CASE(Eq)     RA.I = RB.U == RC.U; VM_NEXT()
+    VM_CASE(Ne)     RA.I = RB.U != RC.U; VM_NEXT()
+    VM_CASE(SLt)    RA.I = RB.I <  RC.I; VM_NEXT()
+    VM_CASE(SLe)    RA.I = RB.I <= RC.I; VM_NEXT()
+    VM_CASE(SGt)    RA.I = RB.I >  RC.I; VM_NEXT()
+    VM_CASE(SGe)    RA.I = RB.I >= RC.I; VM_NEXT()
+    VM_CASE(ULt)    RA.I = RB.U <  RC.U; VM_NEXT()
+    VM_CASE(ULe)    RA.I = RB.U <= RC.U; VM_NEXT()
+    VM_CASE(UGt)    RA.I = RB.U >  RC.U; VM_NEXT()
+    VM_CASE(UGe)    RA.I = RB.U >= RC.U; VM_NEXT()
+    VM_CASE(FEq)    RA.I = RB.F == RC.F; VM_NEXT()
+    VM_CASE(FNe)    RA.I = RB.F != RC.F; VM_NEXT()
+    VM_CASE(FLt)    RA.I = RB.F <  RC.F; VM_NEXT()
+    VM_CASE(FLe)    RA.I = RB.F <= RC.F; VM_NEXT()
+    VM_CASE(FGt)    RA.I = RB.F >  RC.F; VM_NEXT()
+    VM_CASE(FGe)    RA.I = RB.F >= RC.F; VM_NEXT()
+    VM_CASE(Jmp)    VM_JUMP(pc->Imm)
+    VM_CASE(Jz)     VM_JUMP_IF(RB.U == 0)
+    VM_CASE(Jnz)    VM_JUMP_IF(RB.U != 0)
+    VM_CASE(JEq)    VM_JUMP_IF(RB.U == RC.U)
+    VM_CASE(JNe)    VM_JUMP_IF(RB.U != RC.U)
+    VM_CASE(JSLt)   VM_JUMP_IF(RB.I <  RC.I)
+    VM_CASE(JSLe)   VM_JUMP_IF(RB.I <= RC.I)
+    VM_CASE(JSGt)   VM_JUMP_IF(RB.I >  RC.I)
+    VM_CASE(JSGe)   VM_JUMP_IF(RB.I >= RC.I)
+    VM_CASE(JULt)   VM_JUMP_IF(RB.U <  RC.U)
+    VM_CASE(JULe)   VM_JUMP_IF(RB.U <= RC.U)
+    VM_CASE(JUGt)   VM_JUMP_IF(RB.U >  RC.U)
+    VM_CASE(JUGe)   VM_JUMP_IF(RB.U >= RC.U)
+    VM_CASE(LdG)    RA = G[pc->Imm]; VM_NEXT()
+    VM_CASE(StG)    G[pc->Imm] = RA; VM_NEXT()
+    VM_CASE(LdGX) {
+        const VMArray &array = Module.GlobalVars[pc->Imm];
+        if(RB.U >= array.Size)
+            return runtimeError(func, pc, "array index out of range");
+        RA = G[array.Base + RB.U];
+        VM_NEXT()
+    }
+    VM_CASE(StGX) {
+        const VMArray &array = Module.GlobalVars[pc->Imm];
+        if(RB.U >= array.Size)
+            return runtimeError(func, pc, "array index out of range");
+        G[array.Base + RB.U] = RA;
+        VM_NEXT()
+    }
+    VM_CASE(LdLX) {
+        const VMArray &array = func->Arrays[pc->Imm];
+        if(RB.U >= array.Size)
+            return runtimeError(func, pc, "array index out of range");
+        RA = R[array.Base + RB.U];
+        VM_NEXT()
+    }
+    VM_CASE(StLX) {
+        const VMArray &array = func->Arrays[pc->Imm];
+        if(RB.U >= array.Size)
+            return runtimeError(func, pc, "array index out of range");
+        R[array.Base + RB.U] = RA;
+        VM_NEXT()
+    }
+    VM_CASE(Call) {
+        const VMFunction *callee = FunctionTable[pc->Imm];
+        VMValue *base = R + func->FrameSize;
+        if(callee->FrameSize > (size_t)(stackEnd - base))
+            return runtimeError(func, pc, "stack overflow");
+        std::memcpy((void *)base, (void *)(R + pc->B), sizeof(VMValue) * callee->ParamCount);
+        std::memset((void *)(base + callee->ParamCount), 0,
+                    sizeof(VMValue) * (callee->FrameSize - callee->ParamCount));
+        Frames.push_back({func, pc + 1, R, pc->A});
+        func = callee;
+        code = callee->Code.data();
+        R = base;
+        pc = code;
+        VM_DISPATCH();
+    }
+    VM_CASE(CallStd) {
+        VMValue value;
+        callStd(pc->Aux, R + pc->B, pc->C, value);
+        RA = value;
+        VM_NEXT()
+    }
+    VM_CASE(Ret)
+    VM_CASE(RetV) {
+        VMValue value;
+        value.U = 0;
+        if(pc->Op == OpRet)
+            value = RA;
+        if(Frames.empty()) {
+            result = value;
+            return true;
+        }
+        Frame &frame = Frames.back();
+        func = frame.Func;
+        code = func->Code.data();
+        R = frame.Base;
+        pc = frame.RetPc;
+        R[frame.Dest] = value;
+        Frames.pop_back();
+        VM_DISPATCH();
+    }
+#ifndef KALE_VM_COMPUTED_GOTO
+    default:
+        return runtimeError(func, pc, "bad opcode");
+    }
+#endif
+
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_JUMP
+#undef VM_JUMP_IF
+#undef RA
+#undef RB
+#undef RC
+}
+
+bool KaleVM::runMain(int &ret, const std::string &stdoutFile) {
+    if(!Linked && !link())
+        return false;
+    Globals.assign(Module.GlobalCount, VMValue{0});
+    if(!Stack)
+        Stack.reset(new VMValue[StackSize]);
+    Frames.reserve(256);
+
+    /// redirect the output of the program to the file
+    int savedStdout = -1;
+    if(!stdoutFile.empty()) {
+        int fd = open(stdoutFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) {
+            ErrorMsg = "could not open file " + stdoutFile;
+            return false;
+        }
+        fflush(stdout);
+        savedStdout = dup(STDOUT_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    }
+
+    VMValue result;
+    bool success = true;
+    for(unsigned slot : Module.Initializers) {
+        if(!(success = execute(slot, result)))
+            break;
+    }
+    if(success)
+        success = execute(MainSlot, result);
+    fflush(stdout);
+
+    if(savedStdout >= 0) {
+        dup2(savedStdout, STDOUT_FILENO);
+        close(savedStdout);
+    }
+    ret = success ? (int)result.I : 0;
+    return success;
+}
+/// -----------------------------------------------------
+
+}
@@ -0,0 +1,963 @@
+
+#include "vm_builder.h"
+#include "ast.h"
+#include "cast.h"
+
+namespace kale {
+
+/// -----------------------------------------------------
+/// @brief Code implication of class KaleVMBuilder
+/// -----------------------------------------------------
+KaleVMBuilder::KaleVMBuilder(VMModule &module) : Module(module) {}
+
+void KaleVMBuilder::setError(const std::string &msg) {
+    if(ErrorMsg.empty())
+        ErrorMsg = msg;
+}
+
+unsigned KaleVMBuilder::getTypeBits(KType ty) {
+    switch (ty) {
+        case Bool: return 1;
+        case Char:
+        case UChar: return 8;
+        case Short:
+        case UShort: return 16;
+        case Int:
+        case Uint:
+        case Float: return 32;
+        default: return 64;
+    }
+}
+
+uint8_t KaleVMBuilder::getNormalizeAux(KType ty) {
+    switch (ty) {
+        case Bool:
+        case Char:
+        case UChar:
+        case Short:
+        case UShort:
+        case Int:
+        case Uint:
+            return makeNormalizeAux(getTypeBits(ty), ty == Char || ty == Short || ty == Int);
+        default:
+            return 0;
+    }
+}
+
+/// the integer type of bits wide and of the sign, the type of the result
+/// of a binary expr whose operands are bits wide
+static KType getIntType(unsigned bits, bool isSigned) {
+    switch (bits) {
+        case 1:  return Bool;
+        case 8:  return isSigned ? Char : UChar;
+        case 16: return isSigned ? Short : UShort;
+        case 32: return isSigned ? Int : Uint;
+        default: return isSigned ? Long : ULong;
+    }
+}
+
+static bool isSignedType(KType ty) {
+    return ty == Char || ty == Short || ty == Int || ty == Long;
+}
+
+static bool isIntType(KType ty) {
+    return ty == Bool || ty == Char || ty == UChar || ty == Short || ty == UShort ||
+           ty == Int || ty == Uint || ty == Long || ty == ULong;
+}
+
+unsigned KaleVMBuilder::allocReg() {
+    unsigned reg = NextReg++;
+    if(NextReg > 0xFFFF) {
+        setError("function '" + CurFunc->Name + "' use too many registers");
+        NextReg = 0xFFFF;
+    }
+    if(NextReg > CurFunc->RegisterCount)
+        CurFunc->RegisterCount = NextReg;
+    return reg;
+}
+
+unsigned KaleVMBuilder::emit(VMOpcode op, unsigned a, unsigned b, unsigned c, uint32_t imm, uint8_t aux) {
+    CurFunc->Code.push_back({(uint8_t)op, aux, (uint16_t)a, (uint16_t)b, (uint16_t)c, imm});
+    return CurFunc->Code.size() - 1;
+}
+
+void KaleVMBuilder::patchJump(unsigned at) {
+    CurFunc->Code[at].Imm = CurFunc->Code.size();
+}
+
+unsigned KaleVMBuilder::takeDest() {
+    int hint = DestHint;
+    DestHint = -1;
+    return hint >= 0 ? (unsigned)hint : allocReg();
+}
+
+unsigned KaleVMBuilder::compileExpr(ExprAST *expr, int dest) {
+    DestHint = dest;
+    LastIsStr = false;
+    expr->accept(*this);
+    DestHint = -1;
+    if(dest >= 0 && LastReg != (unsigned)dest) {
+        emit(OpMov, dest, LastReg);
+        LastReg = dest;
+    }
+    return LastReg;
+}
+
+unsigned KaleVMBuilder::loadConstInt(int64_t v) {
+    unsigned reg = allocReg();
+    if(v == (int64_t)(int32_t)v) {
+        emit(OpLoadI, reg, 0, 0, (uint32_t)(int32_t)v);
+    }
+    else {
+        VMValue value;
+        value.I = v;
+        emit(OpLoadK, reg, 0, 0, Module.addConstant(value));
+    }
+    return reg;
+}
+
+unsigned KaleVMBuilder::convertTo(unsigned reg, KType from, KType to, int dest) {
+    auto target = [&]() { return dest >= 0 ? (unsigned)dest : allocReg(); };
+    auto keep = [&]() {
+        if(dest >= 0 && (unsigned)dest != reg) {
+            emit(OpMov, dest, reg);
+            return (unsigned)dest;
+        }
+        return reg;
+    };
+
+    if(from == to || to == Void)
+        return keep();
+    if(from == Pointer || to == Pointer || from == Void) {
+        setError("a string or void value can't be converted");
+        return keep();
+    }
+
+    if(isFPType(to)) {
+        if(isFPType(from)) {
+            if(to == Double)
+                return keep();
+            unsigned dst = target();
+            emit(OpFRound, dst, reg);
+            return dst;
+        }
+        /// int to fp is unsigned like the ir builder, a signed value is
+        /// taken as its bits
+        unsigned src = reg;
+        if(isSignedType(from) && getTypeBits(from) < 64) {
+            src = allocReg();
+            emit(OpNorm, src, reg, 0, 0, makeNormalizeAux(getTypeBits(from), false));
+        }
+        unsigned dst = target();
+        emit(OpU2F, dst, src, 0, 0, to == Float);
+        return dst;
+    }
+
+    if(isFPType(from)) {
+        unsigned dst = target();
+        emit(OpF2I, dst, reg, 0, 0, getNormalizeAux(to));
+        return dst;
+    }
+
+    /// int to int, a wider type is zero extended like the ir builder do,
+    /// a narrower one is truncated
+    unsigned fromBits = getTypeBits(from);
+    unsigned toBits = getTypeBits(to);
+    uint8_t aux = 0;
+    if(fromBits < toBits) {
+        if(isSignedType(from))
+            aux = makeNormalizeAux(fromBits, false);
+    }
+    else {
+        aux = getNormalizeAux(to);
+        if(fromBits == toBits && isSignedType(from) == isSignedType(to))
+            aux = 0;
+    }
+    if(!aux)
+        return keep();
+    unsigned dst = target();
+    emit(OpNorm, dst, reg, 0, 0, aux);
+    return dst;
+}
+
+KType KaleVMBuilder::unifyOperands(unsigned &lhs, KType lk, unsigned &rhs, KType rk) {
+    if(lk == rk)
+        return lk;
+    if(lk == Pointer || rk == Pointer || lk == Void || rk == Void) {
+        setError("a string or void value can't be an operand");
+        return lk;
+    }
+    if(lk == Double) {
+        rhs = convertTo(rhs, rk, Double);
+        return Double;
+    }
+    if(lk == Float) {
+        if(rk == Double) {
+            lhs = convertTo(lhs, lk, Double);
+            return Double;
+        }
+        rhs = convertTo(rhs, rk, Float);
+        return Float;
+    }
+    if(isFPType(rk)) {
+        lhs = convertTo(lhs, lk, rk);
+        return rk;
+    }
+    if(getTypeBits(lk) > getTypeBits(rk)) {
+        rhs = convertTo(rhs, rk, lk);
+        return lk;
+    }
+    if(getTypeBits(lk) < getTypeBits(rk)) {
+        lhs = convertTo(lhs, lk, rk);
+        return rk;
+    }
+    return lk;
+}
+
+long KaleVMBuilder::getConstInt(ExprAST *expr) {
+    switch (expr->getClassId()) {
+        case NumberId: {
+            auto *number = kale_cast<NumberExprAST>(expr);
+            return number->isDouble() ? (long)number->getFValue() : number->getIValue();
+        }
+        case UnaryExprId: {
+            auto *unary = kale_cast<UnaryExprAST>(expr);
+            long res = getConstInt(unary->getUnaryExpr());
+            switch (unary->getExprOp()) {
+                case Sub: return -res;
+                case Not: return !res;
+                default: return res;
+            }
+        }
+        case BinExprId: {
+            auto *bin = kale_cast<BinaryExprAST>(expr);
+            long lres = getConstInt(bin->getLhs());
+            long rres = getConstInt(bin->getRhs());
+            switch (bin->getExprOp()) {
+                case Add:    return lres + rres;
+                case Sub:    return lres - rres;
+                case Mul:    return lres * rres;
+                case Div:    return rres ? lres / rres : 0;
+                case Lsft:   return lres << rres;
+                case Rsft:   return lres >> rres;
+                case BitOr:  return lres | rres;
+                case BitAnd: return lres & rres;
+                case BitXor: return lres ^ rres;
+                case Eq:     return lres == rres;
+                case Neq:    return lres != rres;
+                case Gt:     return lres > rres;
+                case Ge:     return lres >= rres;
+                case Lt:     return lres < rres;
+                case Le:     return lres <= rres;
+                case Or:     return lres || rres;
+                case And:    return lres && rres;
+                default: break;
+            }
+            setError("array dimension must be a constant");
+            return 0;
+        }
+        default:
+            setError("array dimension must be a constant");
+            return 0;
+    }
+}
+
+unsigned KaleVMBuilder::getArraySize(VariableAST *var) {
+    long size = 1;
+    for(auto *dim : var->getDims()) {
+        size *= getConstInt(dim);
+    }
+    if(size <= 0 || size > 0x7FFFFFFF) {
+        setError(std::string("array '") + var->getName() + "' has a bad size");
+        return 1;
+    }
+    return size;
+}
+
+bool KaleVMBuilder::isGlobal(VariableAST *var) {
+    if(var->isExtern())
+        return true;
+    auto *parent = var->getParent();
+    return parent && parent->getClassId() == DataDeclId && parent->getParent() &&
+           parent->getParent()->getClassId() == ProgramId;
+}
+
+bool KaleVMBuilder::buildProgram(ProgramAST *prog) {
+    prog->accept(*this);
+    return ErrorMsg.empty();
+}
+
+void KaleVMBuilder::finishFunction() {
+    /// a function falling off its end return 0, it may be reached by a
+    /// jump even if the last instruction is a return
+    auto &code = CurFunc->Code;
+    bool fallOff = code.empty() || (code.back().Op != OpRet && code.back().Op != OpRetV);
+    for(auto &inst : code) {
+        if(inst.Op >= OpJmp && inst.Op <= OpJUGe && inst.Imm == code.size())
+            fallOff = true;
+    }
+    if(fallOff) {
+        if(CurRetType == Void) {
+            emit(OpRetV);
+        }
+        else {
+            unsigned reg = loadConstInt(0);
+            emit(OpRet, reg);
+        }
+    }
+    for(auto &array : CurFunc->Arrays) {
+        array.Base += CurFunc->RegisterCount;
+    }
+    CurFunc->FrameSize = CurFunc->RegisterCount + LocalArraySize;
+    CurFunc->Defined = true;
+}
+
+void KaleVMBuilder::visit(ProgramAST *node) {
+    /// the globals of the program are initialized by a function run
+    /// before main
+    unsigned initSlot = Module.getFunctionSlot("$init" + std::to_string(node->getLineNo()->FileIndex) +
+                                               "." + std::to_string(Module.Functions.size()));
+    for(auto *elem : node->getCompElems()) {
+        CurFunc = &Module.Functions[initSlot];
+        CurRetType = Void;
+        NextReg = 0;
+        LocalArraySize = 0;
+        elem->accept(*this);
+    }
+    CurFunc = &Module.Functions[initSlot];
+    CurRetType = Void;
+    LocalArraySize = 0;
+    if(!CurFunc->Code.empty())
+        Module.Initializers.push_back(initSlot);
+    finishFunction();
+    CurFunc = nullptr;
+}
+
+void KaleVMBuilder::visit(FuncAST *node) {
+    if(node->isFuncDeclare())
+        return;
+    unsigned slot = Module.getFunctionSlot(node->getFuncName());
+    CurFunc = &Module.Functions[slot];
+    if(CurFunc->Defined) {
+        setError("function '" + node->getFuncName() + "' is defined more than once");
+        return;
+    }
+    CurRetType = node->getRetType()->getDataType();
+    NextReg = 0;
+    LocalArraySize = 0;
+    LocalRegs.clear();
+    LocalArrays.clear();
+
+    for(auto *param : node->getParams()) {
+        if(param->getId()->isArrray()) {
+            setError("function '" + node->getFuncName() + "' has an array param, it is not supported by the vm");
+            return;
+        }
+        LocalRegs[param->getId()] = allocReg();
+    }
+    CurFunc->ParamCount = node->getParams().size();
+    node->getBlockStmt()->accept(*this);
+    finishFunction();
+}
+
+void KaleVMBuilder::visit(VariableAST *node) {
+    KType ty = node->getDataType()->getDataType();
+    if(node->hasInitExpr() && node->getInitExpr()->getClassId() == InitializeId) {
+        setError(std::string("the initializer list of '") + node->getName() + "' is not supported by the vm");
+        return;
+    }
+    if(isGlobal(node)) {
+        unsigned slot = Module.getGlobalSlot(node->getName(), node->isArrray() ? getArraySize(node) : 1);
+        if(node->hasInitExpr() && !node->isExtern()) {
+            unsigned value = compileExpr(node->getInitExpr());
+            value = convertTo(value, LastKind, ty);
+            emit(OpStG, value, 0, 0, Module.GlobalVars[slot].Base);
+        }
+        return;
+    }
+
+    if(node->isArrray()) {
+        unsigned size = getArraySize(node);
+        LocalArrays[node] = CurFunc->Arrays.size();
+        CurFunc->Arrays.push_back({LocalArraySize, size});
+        LocalArraySize += size;
+        return;
+    }
+
+    unsigned reg = allocReg();
+    LocalRegs[node] = reg;
+    if(node->hasInitExpr()) {
+        unsigned save = NextReg;
+        unsigned value = compileExpr(node->getInitExpr(), reg);
+        convertTo(value, LastKind, ty, reg);
+        NextReg = save;
+    }
+}
+
+void KaleVMBuilder::visit(DataDeclAST *node) {
+    for(auto *var : node->getVarDecls()) {
+        var->accept(*this);
+    }
+}
+
+void KaleVMBuilder::visit(BlockStmtAST *node) {
+    /// the registers of the locals of the block are reused after it
+    unsigned save = NextReg;
+    for(auto *stmt : node->getStmts()) {
+        stmt->accept(*this);
+    }
+    NextReg = save;
+}
+
+void KaleVMBuilder::visit(ExprStmtAST *node) {
+    unsigned save = NextReg;
+    compileExpr(node->getExpr());
+    NextReg = save;
+}
+
+void KaleVMBuilder::visit(ReturnStmtAST *node) {
+    unsigned save = NextReg;
+    if(node->getRetExpr() && CurRetType != Void) {
+        unsigned value = compileExpr(node->getRetExpr());
+        value = convertTo(value, LastKind, CurRetType);
+        emit(OpRet, value);
+    }
+    else {
+        emit(OpRetV);
+    }
+    NextReg = save;
+}
+
+void KaleVMBuilder::visit(BreakStmtAST *) {
+    if(Loops.empty()) {
+        setError("break is not in a loop");
+        return;
+    }
+    Loops.back().Breaks.push_back(emit(OpJmp));
+}
+
+void KaleVMBuilder::visit(ContinueStmtAST *) {
+    if(Loops.empty()) {
+        setError("continue is not in a loop");
+        return;
+    }
+    Loops.back().Continues.push_back(emit(OpJmp));
+}
+
+/// the loops are laid out with the condition after the body, so an
+/// iteration run one jump:
+///         init
+///         jmp cond
+///   body: stmt
+///   next: step
+///   cond: if cond goto body
+void KaleVMBuilder::visit(ForStmtAST *node) {
+    unsigned save = NextReg;
+    if(node->getExpr1())
+        compileExpr(node->getExpr1());
+    NextReg = save;
+
+    unsigned toCond = emit(OpJmp);
+    unsigned body = CurFunc->Code.size();
+    Loops.emplace_back();
+    node->getStatement()->accept(*this);
+    for(unsigned at : Loops.back().Continues) {
+        patchJump(at);
+    }
+    if(node->getExpr3())
+        compileExpr(node->getExpr3());
+    NextReg = save;
+
+    patchJump(toCond);
+    std::vector<unsigned> jumps;
+    if(node->getExpr2())
+        compileCond(node->getExpr2(), true, jumps);
+    else
+        jumps.push_back(emit(OpJmp));
+    NextReg = save;
+    for(unsigned at : jumps) {
+        CurFunc->Code[at].Imm = body;
+    }
+    for(unsigned at : Loops.back().Breaks) {
+        patchJump(at);
+    }
+    Loops.pop_back();
+}
+
+void KaleVMBuilder::visit(WhileStmtAST *node) {
+    unsigned save = NextReg;
+    unsigned toCond = emit(OpJmp);
+    unsigned body = CurFunc->Code.size();
+    Loops.emplace_back();
+    node->getStatement()->accept(*this);
+    NextReg = save;
+
+    patchJump(toCond);
+    for(unsigned at : Loops.back().Continues) {
+        patchJump(at);
+    }
+    std::vector<unsigned> jumps;
+    compileCond(node->getCond(), true, jumps);
+    NextReg = save;
+    for(unsigned at : jumps) {
+        CurFunc->Code[at].Imm = body;
+    }
+    for(unsigned at : Loops.back().Breaks) {
+        patchJump(at);
+    }
+    Loops.pop_back();
+}
+
+void KaleVMBuilder::visit(IfStmtAST *node) {
+    unsigned save = NextReg;
+    std::vector<unsigned> toElse;
+    compileCond(node->getCond(), false, toElse);
+    NextReg = save;
+    node->getStatement()->accept(*this);
+    if(node->getElse()) {
+        unsigned toEnd = emit(OpJmp);
+        for(unsigned at : toElse) {
+            patchJump(at);
+        }
+        node->getElse()->accept(*this);
+        patchJump(toEnd);
+    }
+    else {
+        for(unsigned at : toElse) {
+            patchJump(at);
+        }
+    }
+    NextReg = save;
+}
+
+/// the opcodes of a compare, set the result or jump if it is true
+struct CompareOps {
+    VMOpcode Signed, Unsigned, FP;
+    VMOpcode JumpSigned, JumpUnsigned;
+};
+
+static const CompareOps *getCompareOps(Operator op) {
+    static const CompareOps Eqs = {OpEq,  OpEq,  OpFEq, OpJEq,  OpJEq};
+    static const CompareOps Nes = {OpNe,  OpNe,  OpFNe, OpJNe,  OpJNe};
+    static const CompareOps Lts = {OpSLt, OpULt, OpFLt, OpJSLt, OpJULt};
+    static const CompareOps Les = {OpSLe, OpULe, OpFLe, OpJSLe, OpJULe};
+    static const CompareOps Gts = {OpSGt, OpUGt, OpFGt, OpJSGt, OpJUGt};
+    static const CompareOps Ges = {OpSGe, OpUGe, OpFGe, OpJSGe, OpJUGe};
+    switch (op) {
+        case Eq: return &Eqs;
+        case Neq: return &Nes;
+        case Lt: return &Lts;
+        case Le: return &Les;
+        case Gt: return &Gts;
+        case Ge: return &Ges;
+        default: return nullptr;
+    }
+}
+
+static Operator getInverseCompare(Operator op) {
+    switch (op) {
+        case Eq: return Neq;
+        case Neq: return Eq;
+        case Lt: return Ge;
+        case Le: return Gt;
+        case Gt: return Le;
+        default: return Lt;
+    }
+}
+
+/// the operands of an integer compare, division or right shift are put
+/// in the form of the sign of the expr, a value of the other sign is
+/// extended again from its bits
+unsigned KaleVMBuilder::convertSign(unsigned reg, KType ty, bool isSigned) {
+    unsigned bits = getTypeBits(ty);
+    if(bits >= 64 || isSignedType(ty) == isSigned)
+        return reg;
+    unsigned dst = allocReg();
+    emit(OpNorm, dst, reg, 0, 0, makeNormalizeAux(bits, isSigned));
+    return dst;
+}
+
+void KaleVMBuilder::compileCond(ExprAST *cond, bool jumpIfTrue, std::vector<unsigned> &jumps) {
+    auto *bin = kale_cast<BinaryExprAST>(cond);
+    if(bin && getCompareOps(bin->getExprOp())) {
+        unsigned lhs = compileExpr(bin->getLhs());
+        KType lk = LastKind;
+        unsigned rhs = compileExpr(bin->getRhs());
+        KType rk = LastKind;
+        KType ty = unifyOperands(lhs, lk, rhs, rk);
+        if(isIntType(ty)) {
+            bool isSigned = bin->isSign();
+            lhs = convertSign(lhs, ty, isSigned);
+            rhs = convertSign(rhs, ty, isSigned);
+            Operator op = jumpIfTrue ? bin->getExprOp() : getInverseCompare(bin->getExprOp());
+            const CompareOps *ops = getCompareOps(op);
+            jumps.push_back(emit(isSigned ? ops->JumpSigned : ops->JumpUnsigned, 0, lhs, rhs));
+            return;
+        }
+        unsigned dst = allocReg();
+        emit(getCompareOps(bin->getExprOp())->FP, dst, lhs, rhs);
+        jumps.push_back(emit(jumpIfTrue ? OpJnz : OpJz, 0, dst));
+        return;
+    }
+    unsigned value = compileExpr(cond);
+    jumps.push_back(emit(jumpIfTrue ? OpJnz : OpJz, 0, value));
+}
+
+void KaleVMBuilder::compileIndex(IdIndexedRefAST *node, unsigned &indexReg) {
+    auto *var = kale_cast<VariableAST>(node->getId());
+    const auto &dims = var->getDims();
+    const auto &indexes = node->getIndexes();
+    if(indexes.size() > dims.size()) {
+        setError(std::string("array '") + var->getName() + "' has too many indexes");
+        indexReg = loadConstInt(0);
+        return;
+    }
+
+    /// the indexes are linearized like the ir builder, the last index is
+    /// the innermost dimension
+    long scale = 1;
+    for(unsigned i = 0; i < dims.size() - indexes.size(); i++) {
+        scale *= getConstInt(dims[dims.size() - 1 - i]);
+    }
+    int result = -1;
+    for(unsigned i = 0; i < indexes.size(); i++) {
+        unsigned reg = compileExpr(indexes[indexes.size() - 1 - i]);
+        reg = convertTo(reg, LastKind, Int);
+        if(scale != 1) {
+            unsigned scaled = allocReg();
+            emit(OpMulI, scaled, reg, 0, (uint32_t)(int32_t)scale, getNormalizeAux(Int));
+            reg = scaled;
+        }
+        if(result >= 0) {
+            unsigned sum = allocReg();
+            emit(OpAdd, sum, reg, result, 0, getNormalizeAux(Int));
+            reg = sum;
+        }
+        result = reg;
+        scale *= getConstInt(dims[indexes.size() - 1 - i]);
+    }
+    indexReg = result;
+}
+
+void KaleVMBuilder::visit(BinaryExprAST *node) {
+    int hint = DestHint;
+    DestHint = -1;
+
+    if(node->getExprOp() == Assign) {
+        if(auto *ref = kale_cast<IdRefAST>(node->getLhs())) {
+            auto *var = kale_cast<VariableAST>(ref->getId());
+            KType ty = var->getDataType()->getDataType();
+            if(var->isArrray()) {
+                setError(std::string("array '") + var->getName() + "' can't be assigned");
+                return;
+            }
+            if(!isGlobal(var)) {
+                /// the value is computed into the register of the variable
+                unsigned reg = LocalRegs[var];
+                unsigned value = compileExpr(node->getRhs(), reg);
+                convertTo(value, LastKind, ty, reg);
+                LastReg = reg;
+                LastKind = ty;
+            }
+            else {
+                unsigned slot = Module.getGlobalSlot(var->getName(), 1);
+                unsigned value = compileExpr(node->getRhs());
+                value = convertTo(value, LastKind, ty);
+                emit(OpStG, value, 0, 0, Module.GlobalVars[slot].Base);
+                LastReg = value;
+                LastKind = ty;
+            }
+        }
+        else if(auto *indexed = kale_cast<IdIndexedRefAST>(node->getLhs())) {
+            auto *var = kale_cast<VariableAST>(indexed->getId());
+            KType ty = var->getDataType()->getDataType();
+            unsigned index;
+            compileIndex(indexed, index);
+            unsigned value = compileExpr(node->getRhs());
+            value = convertTo(value, LastKind, ty);
+            if(isGlobal(var))
+                emit(OpStGX, value, index, 0, Module.getGlobalSlot(var->getName(), getArraySize(var)));
+            else
+                emit(OpStLX, value, index, 0, LocalArrays[var]);
+            LastReg = value;
+            LastKind = ty;
+        }
+        else {
+            setError("the left of an assignment must be a variable");
+        }
+        if(hint >= 0 && LastReg != (unsigned)hint) {
+            emit(OpMov, hint, LastReg);
+            LastReg = hint;
+        }
+        return;
+    }
+
+    unsigned lhs = compileExpr(node->getLhs());
+    KType lk = LastKind;
+    unsigned rhsStart = CurFunc->Code.size();
+    unsigned rhs = compileExpr(node->getRhs());
+    KType rk = LastKind;
+    KType ty = unifyOperands(lhs, lk, rhs, rk);
+    bool isSigned = node->isSign();
+    bool fp = isFPType(ty);
+
+    /// the integer result has the width of the operands and the sign of the expr
+    KType resultTy = fp ? ty : getIntType(getTypeBits(ty), isSigned);
+    uint8_t aux = fp ? (ty == Float) : getNormalizeAux(resultTy);
+
+    if(auto *ops = getCompareOps(node->getExprOp())) {
+        if(!fp) {
+            lhs = convertSign(lhs, ty, isSigned);
+            rhs = convertSign(rhs, ty, isSigned);
+        }
+        unsigned dst = hint >= 0 ? hint : allocReg();
+        emit(fp ? ops->FP : (isSigned ? ops->Signed : ops->Unsigned), dst, lhs, rhs);
+        LastReg = dst;
+        LastKind = Bool;
+        return;
+    }
+
+    VMOpcode op = OpCount;
+    switch (node->getExprOp()) {
+        case Add: op = fp ? OpFAdd : OpAdd; break;
+        case Sub: op = fp ? OpFSub : OpSub; break;
+        case Mul: op = fp ? OpFMul : OpMul; break;
+        case Div: {
+            if(fp) {
+                op = OpFDiv;
+                break;
+            }
+            lhs = convertSign(lhs, ty, isSigned);
+            rhs = convertSign(rhs, ty, isSigned);
+            op = isSigned ? OpSDiv : OpUDiv;
+            break;
+        }
+        case Lsft: op = OpShl; break;
+        case Rsft: {
+            lhs = convertSign(lhs, ty, false);
+            op = OpLShr;
+            break;
+        }
+        case BitOr: op = OpOr; break;
+        case BitAnd: op = OpAnd; break;
+        case BitXor: op = OpXor; break;
+        case Or: op = OpLOr; resultTy = Bool; aux = 0; break;
+        case And: op = OpLAnd; resultTy = Bool; aux = 0; break;
+        default: break;
+    }
+    if(op == OpCount || (fp && (op == OpShl || op == OpLShr || op == OpOr || op == OpAnd || op == OpXor))) {
+        setError("unsupported operator in binary expr");
+        op = OpMov;
+    }
+    unsigned dst = hint >= 0 ? hint : allocReg();
+    /// a small constant added or subtracted is folded into AddI, like the
+    /// step of most loops
+    VMInst &last = CurFunc->Code.back();
+    if((op == OpAdd || op == OpSub) && CurFunc->Code.size() == rhsStart + 1 && last.Op == OpLoadI &&
+       (op == OpAdd || last.Imm != 0x80000000u)) {
+        uint32_t imm = op == OpAdd ? last.Imm : (uint32_t)-(int32_t)last.Imm;
+        CurFunc->Code.pop_back();
+        emit(OpAddI, dst, lhs, 0, imm, aux);
+    }
+    else {
+        emit(op, dst, lhs, rhs, 0, aux);
+    }
+    LastReg = dst;
+    LastKind = resultTy;
+}
+
+void KaleVMBuilder::visit(UnaryExprAST *node) {
+    int hint = DestHint;
+    DestHint = -1;
+    unsigned value = compileExpr(node->getUnaryExpr());
+    KType ty = LastKind;
+    switch (node->getExprOp()) {
+        case Not: {
+            unsigned dst = hint >= 0 ? hint : allocReg();
+            emit(OpNot, dst, value);
+            LastReg = dst;
+            LastKind = Bool;
+            break;
+        }
+        case Sub: {
+            unsigned dst = hint >= 0 ? hint : allocReg();
+            if(isFPType(ty))
+                emit(OpFNeg, dst, value);
+            else
+                emit(OpNeg, dst, value, 0, 0, getNormalizeAux(ty));
+            LastReg = dst;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void KaleVMBuilder::visit(LiteralExprAST *node) {
+    unsigned dst = takeDest();
+    VMValue value;
+    value.S = Module.addString(node->getStr());
+    emit(OpLoadK, dst, 0, 0, Module.addConstant(value));
+    LastReg = dst;
+    LastKind = Pointer;
+    LastIsStr = true;
+}
+
+void KaleVMBuilder::visit(NumberExprAST *node) {
+    KType ty = node->getExprType();
+    unsigned dst = takeDest();
+    LastReg = dst;
+    LastKind = ty;
+
+    /// the value of the literal converted to the type given by the type
+    /// checker, like the ir builder
+    bool isSigned = node->isSigned();
+    uint64_t bits;
+    double fpValue;
+    if(node->isLong()) {
+        bits = node->getUIValue();
+        fpValue = isSigned ? (double)(long long)bits : (double)bits;
+    }
+    else if(node->isChar()) {
+        bits = isSigned ? (uint64_t)(int64_t)node->getCValue() : (uint64_t)(unsigned char)node->getCValue();
+        fpValue = (double)node->getCValue();
+    }
+    else if(node->isBoolLiteral()) {
+        bits = node->getBoolValue();
+        fpValue = node->getBoolValue();
+    }
+    else {
+        fpValue = node->getFValue();
+        bits = isSigned ? (uint64_t)(long long)fpValue : (uint64_t)fpValue;
+    }
+
+    VMValue value;
+    if(isFPType(ty)) {
+        value.F = ty == Float ? (double)(float)fpValue : fpValue;
+        emit(OpLoadK, dst, 0, 0, Module.addConstant(value));
+        return;
+    }
+    value.U = normalizeValue(bits, getNormalizeAux(ty));
+    if(value.I == (int64_t)(int32_t)value.I)
+        emit(OpLoadI, dst, 0, 0, (uint32_t)(int32_t)value.I);
+    else
+        emit(OpLoadK, dst, 0, 0, Module.addConstant(value));
+}
+
+void KaleVMBuilder::visit(IdRefAST *node) {
+    auto *var = kale_cast<VariableAST>(node->getId());
+    KType ty = var->getDataType()->getDataType();
+    LastKind = ty;
+    if(var->isArrray()) {
+        setError(std::string("array '") + var->getName() + "' can't be used as a value");
+        LastReg = takeDest();
+        return;
+    }
+    if(isGlobal(var)) {
+        unsigned dst = takeDest();
+        emit(OpLdG, dst, 0, 0, Module.GlobalVars[Module.getGlobalSlot(var->getName(), 1)].Base);
+        LastReg = dst;
+        return;
+    }
+    DestHint = -1;
+    auto found = LocalRegs.find(var);
+    if(found == LocalRegs.end()) {
+        setError(std::string("variable '") + var->getName() + "' is used before its declaration");
+        LastReg = allocReg();
+        return;
+    }
+    LastReg = found->second;
+}
+
+void KaleVMBuilder::visit(IdIndexedRefAST *node) {
+    int hint = DestHint;
+    DestHint = -1;
+    auto *var = kale_cast<VariableAST>(node->getId());
+    unsigned index;
+    compileIndex(node, index);
+    unsigned dst = hint >= 0 ? hint : allocReg();
+    if(isGlobal(var))
+        emit(OpLdGX, dst, index, 0, Module.getGlobalSlot(var->getName(), getArraySize(var)));
+    else
+        emit(OpLdLX, dst, index, 0, LocalArrays[var]);
+    LastReg = dst;
+    LastKind = var->getDataType()->getDataType();
+}
+
+void KaleVMBuilder::compileStdCall(CallExprAST *node) {
+    int hint = DestHint;
+    DestHint = -1;
+    unsigned dst = hint >= 0 ? hint : allocReg();
+    const std::string &name = node->getName();
+
+    if(name == "GetInt" || name == "GetDouble") {
+        bool isInt = name == "GetInt";
+        emit(OpCallStd, dst, 0, 0, 0, isInt ? StdGetInt : StdGetDouble);
+        LastReg = dst;
+        LastKind = isInt ? Int : Double;
+        return;
+    }
+    if(name != "Print" && name != "PrintLn") {
+        setError("unknown std function '" + name + "'");
+        LastReg = dst;
+        return;
+    }
+
+    /// the args are passed as the jitted code pass them to printf, a narrow
+    /// integer is zero extended in its register
+    unsigned argBase = NextReg;
+    const auto &args = node->getArgs();
+    for(unsigned i = 0; i < args.size(); i++) {
+        allocReg();
+    }
+    for(unsigned i = 0; i < args.size(); i++) {
+        unsigned reg = compileExpr(args[i], argBase + i);
+        KType ty = LastKind;
+        if(i == 0 && !LastIsStr) {
+            setError("the format of '" + name + "' must be a string literal");
+            return;
+        }
+        if(isSignedType(ty) && getTypeBits(ty) < 64)
+            emit(OpNorm, reg, reg, 0, 0, makeNormalizeAux(getTypeBits(ty), false));
+    }
+    emit(OpCallStd, dst, argBase, args.size(), 0, name == "Print" ? StdPrint : StdPrintLn);
+    NextReg = argBase;
+    LastReg = dst;
+    LastKind = Void;
+}
+
+void KaleVMBuilder::visit(CallExprAST *node) {
+    if(node->isCallStd()) {
+        compileStdCall(node);
+        return;
+    }
+    int hint = DestHint;
+    DestHint = -1;
+    unsigned dst = hint >= 0 ? hint : allocReg();
+
+    /// the args are put in the registers following the ones in use, they
+    /// become the first registers of the frame of the callee
+    FuncAST *func = node->getFuncDef();
+    const auto &params = func->getParams();
+    const auto &args = node->getArgs();
+    if(args.size() < params.size()) {
+        setError("too few args to call '" + func->getFuncName() + "'");
+        LastReg = dst;
+        return;
+    }
+    unsigned argBase = NextReg;
+    for(unsigned i = 0; i < params.size(); i++) {
+        allocReg();
+    }
+    for(unsigned i = 0; i < params.size(); i++) {
+        unsigned reg = compileExpr(args[i], argBase + i);
+        convertTo(reg, LastKind, params[i]->getId()->getDataType()->getDataType(), argBase + i);
+    }
+    emit(OpCall, dst, argBase, 0, Module.getFunctionSlot(func->getFuncName()));
+    NextReg = argBase;
+    LastReg = dst;
+    LastKind = func->getRetType()->getDataType();
+}
+/// -----------------------------------------------------
+
+}